@@ -0,0 +1,783 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <bigboy/AOT.h>
+#include <bigboy/CPU.h>
+
+// Translates the code reachable in a ROM ahead of time into a shared object
+// that Bigboy loads alongside it (see AOT.h), so that titles run many times
+// skip decoding and dispatching most of their instructions. Code that cannot
+// be found by following jumps from the entry points, and code in RAM, is
+// left to the interpreter.
+// - usage: bigboy-aot [rom_path] [output_path] [--source]
+// The output defaults to rom_path.aot.so. The generated C++ is kept next to
+// it; with --source it is written to output_path and not compiled.
+
+namespace {
+    struct Rom {
+        std::vector<uint8_t> data;
+        uint16_t bankCount = 0;
+
+        // The byte at `address` with `bank` switched into 4000-7FFF
+        uint8_t byte(uint16_t bank, uint16_t address) const {
+            return (address <= 0x3FFF) ? data[address] : data[bank * 0x4000u + (address - 0x4000u)];
+        }
+    };
+
+    // A block to translate: (bank, pc), with bank 0 outside 4000-7FFF
+    using Key = std::pair<uint16_t, uint16_t>;
+
+    std::string format(const char* pattern, ...) {
+        char buffer[256];
+        va_list arguments;
+        va_start(arguments, pattern);
+        std::vsnprintf(buffer, sizeof(buffer), pattern, arguments);
+        va_end(arguments);
+        return buffer;
+    }
+
+    // Indexed by the 3-bit register operand (see Registers.h); 110 is (HL)
+    const char* const REGISTERS[] = {"b", "c", "d", "e", "h", "l", nullptr, "a"};
+
+    // Indexed by the register pair operand (BC, DE, HL, SP)
+    const char* const PAIR_HIGH[] = {"b", "d", "h"};
+    const char* const PAIR_LOW[] = {"c", "e", "l"};
+
+    // NZ, Z, NC, C
+    const char* const CONDITIONS[] = {"!(f & 0x80)", "(f & 0x80)", "!(f & 0x10)", "(f & 0x10)"};
+
+    // Helpers for the generated blocks
+    const char* const PRELUDE = R"(namespace {
+    inline uint8_t zero(uint8_t value) { return value == 0 ? 0x80 : 0x00; }
+
+    // ADD, ADC, SUB, SBC, AND, XOR, OR, CP
+    inline void alu(int operation, uint8_t& a, uint8_t& f, uint8_t value) {
+        const unsigned carry = (operation == 1 || operation == 3) ? (f >> 4u) & 1u : 0u;
+        switch (operation) {
+            case 0:
+            case 1: {
+                const unsigned result = a + value + carry;
+                f = zero(result & 0xFFu) | (((a & 0xFu) + (value & 0xFu) + carry > 0xFu) ? 0x20 : 0x00) |
+                    ((result > 0xFFu) ? 0x10 : 0x00);
+                a = static_cast<uint8_t>(result);
+                break;
+            }
+            case 2:
+            case 3:
+            case 7: {
+                const unsigned result = static_cast<unsigned>(a - value - carry) & 0xFFu;
+                f = zero(result) | 0x40 | (((a & 0xFu) < (value & 0xFu) + carry) ? 0x20 : 0x00) |
+                    ((a < value + carry) ? 0x10 : 0x00);
+                if (operation != 7) a = static_cast<uint8_t>(result);
+                break;
+            }
+            case 4: a &= value; f = zero(a) | 0x20; break;
+            case 5: a ^= value; f = zero(a); break;
+            default: a |= value; f = zero(a); break;
+        }
+    }
+
+    inline uint8_t increment(uint8_t& f, uint8_t value) {
+        const uint8_t result = value + 1;
+        f = (f & 0x10) | zero(result) | (((value & 0xFu) == 0xFu) ? 0x20 : 0x00);
+        return result;
+    }
+
+    inline uint8_t decrement(uint8_t& f, uint8_t value) {
+        const uint8_t result = value - 1;
+        f = (f & 0x10) | 0x40 | zero(result) | (((value & 0xFu) == 0x0u) ? 0x20 : 0x00);
+        return result;
+    }
+
+    inline uint16_t addHL(uint8_t& f, uint16_t hl, uint16_t value) {
+        const unsigned result = hl + value;
+        f = (f & 0x80) | (((hl ^ value ^ result) & 0x1000u) ? 0x20 : 0x00) | ((result > 0xFFFFu) ? 0x10 : 0x00);
+        return static_cast<uint16_t>(result);
+    }
+
+    // RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+    inline uint8_t rotate(int operation, uint8_t& f, uint8_t value) {
+        const unsigned carry = (f >> 4u) & 1u;
+        unsigned result;
+        unsigned carryOut;
+        switch (operation) {
+            case 0: result = (value << 1u) | (value >> 7u); carryOut = value >> 7u; break;
+            case 1: result = (value >> 1u) | (value << 7u); carryOut = value & 1u; break;
+            case 2: result = (value << 1u) | carry; carryOut = value >> 7u; break;
+            case 3: result = (value >> 1u) | (carry << 7u); carryOut = value & 1u; break;
+            case 4: result = value << 1u; carryOut = value >> 7u; break;
+            case 5: result = (value >> 1u) | (value & 0x80u); carryOut = value & 1u; break;
+            case 6: result = (value << 4u) | (value >> 4u); carryOut = 0; break;
+            default: result = value >> 1u; carryOut = value & 1u; break;
+        }
+        result &= 0xFFu;
+        f = zero(result) | (carryOut ? 0x10 : 0x00);
+        return static_cast<uint8_t>(result);
+    }
+}
+)";
+
+    // Block limits, as for the JIT: the cycles of the whole block must fit in
+    // the 8 bits returned by CPU::step()
+    constexpr uint32_t MAX_BLOCK_CYCLES = 255 - 24;
+    constexpr uint32_t MAX_BLOCK_LENGTH = 64;
+
+    // Stop discovering blocks after this many, which only a ROM whose data
+    // is mistaken for code in every bank should reach
+    constexpr size_t MAX_BLOCKS = 1u << 18u;
+
+    // Translates one block into the body of a C++ function. Code is generated
+    // for one instruction at a time, and leaves the guest registers as the
+    // interpreter expects them at every instruction boundary, so the block
+    // can be left between any two instructions.
+    class BlockTranslator {
+    public:
+        BlockTranslator(const Rom& rom, Key key) : m_rom{rom}, m_bank{key.first}, m_address{key.second} {}
+
+        // Returns an empty string if not even the first instruction can be
+        // translated. Either way, `successors` is given the addresses where
+        // execution may continue after the block.
+        std::string translate(std::vector<uint16_t>& successors);
+
+    private:
+        bool instruction(uint8_t opcode, uint8_t length);
+        bool prefixInstruction(uint8_t opcode);
+
+        void line(const std::string& code) { m_code += "        " + code + "\n"; }
+
+        // Leaves the block, continuing at `pc` with `cycles` cycles taken
+        std::string exit(const std::string& pc, uint32_t cycles) const;
+        std::string exit(uint16_t pc, uint32_t cycles) const { return exit(format("0x%04X", pc), cycles); }
+
+        // Leaves the block before the current instruction, for the
+        // interpreter to execute it once the devices have caught up
+        std::string exitBefore() const { return exit(m_address, m_cycles); }
+
+        // Reads `address` into `value`, and the reverse
+        void load(const std::string& address, const std::string& value);
+        void store(const std::string& address, const std::string& value);
+
+        void jumpIf(uint8_t condition, const std::string& takenCode, uint32_t cycles);
+
+        std::string pair(uint8_t pair) const;
+        void setPair(uint8_t pair, const std::string& value);
+
+        const Rom& m_rom;
+        const uint16_t m_bank;
+
+        std::string m_code;
+        std::vector<uint16_t>* m_successors = nullptr;
+
+        // The instruction being translated, the bytes following its opcode,
+        // and the cycles taken by the block before it
+        uint16_t m_address;
+        std::array<uint8_t, 2> m_operands{};
+        uint32_t m_cycles = 0;
+        bool m_first = true;
+
+        // Set when the instruction may write through the MMU
+        bool m_mayWriteThrough = false;
+    };
+
+    std::string BlockTranslator::translate(std::vector<uint16_t>& successors) {
+        m_successors = &successors;
+
+        const uint16_t last = (m_address <= 0x3FFF) ? 0x3FFF : 0x7FFF;
+        uint32_t count = 0;
+
+        while (true) {
+            const uint8_t opcode = m_rom.byte(m_bank, m_address);
+            const uint8_t length = CPU::lengthOf(opcode);
+
+            if (count == MAX_BLOCK_LENGTH || m_cycles > MAX_BLOCK_CYCLES ||
+                    length == 0 || static_cast<uint32_t>(m_address) + length - 1 > last) {
+                if (m_first) {
+                    return {};
+                }
+                line(exitBefore());
+                successors.push_back(m_address);
+                break;
+            }
+
+            for (uint8_t i = 1; i < length; ++i) {
+                m_operands[i - 1] = m_rom.byte(m_bank, m_address + i);
+            }
+
+            const uint16_t next = m_address + length;
+            uint32_t cycles = m_cycles + CPU::cyclesOf(opcode);
+            if (opcode == 0xCB) {
+                // Only register operands are translated, which take 8 cycles
+                cycles += 8;
+            }
+
+            const size_t start = m_code.size();
+            m_code += "    {\n";
+            m_mayWriteThrough = false;
+            if (!instruction(opcode, length)) {
+                m_code.resize(start);
+                if (m_first) {
+                    // Let the interpreter run it, and carry on after it
+                    if (!CPU::endsBlock(opcode)) {
+                        successors.push_back(next);
+                    }
+                    return {};
+                }
+                line(exitBefore());
+                successors.push_back(m_address);
+                break;
+            }
+
+            if (CPU::endsBlock(opcode)) {
+                m_code += "    }\n";
+                break;
+            }
+
+            if (m_mayWriteThrough) {
+                // The write may have requested an interrupt or switched banks,
+                // neither of which the rest of the block expects
+                line("if (wroteThrough) " + exit(next, cycles));
+            }
+            m_code += "    }\n";
+
+            m_address = next;
+            m_cycles = cycles;
+            m_first = false;
+            ++count;
+        }
+
+        return m_code;
+    }
+
+    bool BlockTranslator::instruction(uint8_t opcode, uint8_t length) {
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 7u;
+        const uint8_t z = opcode & 7u;
+        const uint8_t p = y >> 1u;
+        const bool q = y & 1u;
+
+        const uint8_t n = m_operands[0];
+        const uint16_t nn = m_operands[0] | (m_operands[1] << 8u);
+        const uint16_t next = m_address + length;
+        const uint32_t cycles = m_cycles + CPU::cyclesOf(opcode);
+
+        if (x == 0) {
+            switch (z) {
+                case 0:
+                    if (y == 0) {
+                        // NOP
+                        return true;
+                    }
+                    if (y >= 3) {
+                        // JR e / JR f, e
+                        const uint16_t target = next + static_cast<int8_t>(n);
+                        m_successors->push_back(target);
+                        if (y == 3) {
+                            line(exit(target, m_cycles + 12));
+                        } else {
+                            m_successors->push_back(next);
+                            jumpIf(y - 4, exit(target, m_cycles + 12), cycles);
+                        }
+                        return true;
+                    }
+                    return false;
+                case 1:
+                    if (!q) {
+                        // LD rr, nn
+                        setPair(p, format("0x%04X", nn));
+                    } else {
+                        // ADD HL, rr
+                        setPair(2, "addHL(f, " + pair(2) + ", " + pair(p) + ")");
+                    }
+                    return true;
+                case 2: {
+                    // LD (BC), A / LD (DE), A / LDI (HL), A / LDD (HL), A, and the reverse
+                    const std::string address = pair(p == 3 ? 2 : p);
+                    if (q) {
+                        load(address, "a");
+                    } else {
+                        store(address, "a");
+                    }
+                    if (p >= 2) {
+                        setPair(2, pair(2) + (p == 2 ? " + 1" : " - 1"));
+                    }
+                    return true;
+                }
+                case 3:
+                    // INC rr / DEC rr
+                    setPair(p, pair(p) + (q ? " - 1" : " + 1"));
+                    return true;
+                case 4:
+                case 5: {
+                    // INC r / DEC r / INC (HL) / DEC (HL)
+                    const char* operation = (z == 4) ? "increment" : "decrement";
+                    if (y == 6) {
+                        // Nothing is changed until the write has gone through
+                        line("uint8_t flags = f;");
+                        load(pair(2), "value");
+                        line(format("value = %s(flags, value);", operation));
+                        store(pair(2), "value");
+                        line("f = flags;");
+                    } else {
+                        line(format("%s = %s(f, %s);", REGISTERS[y], operation, REGISTERS[y]));
+                    }
+                    return true;
+                }
+                case 6:
+                    // LD r, n / LD (HL), n
+                    if (y == 6) {
+                        store(pair(2), format("0x%02X", n));
+                    } else {
+                        line(format("%s = 0x%02X;", REGISTERS[y], n));
+                    }
+                    return true;
+                default:
+                    switch (y) {
+                        case 0:
+                        case 1:
+                        case 2:
+                        case 3:
+                            // RLCA / RRCA / RLA / RRA, which always reset Z
+                            line(format("a = rotate(%u, f, a);", y));
+                            line("f &= 0x10;");
+                            return true;
+                        case 5:
+                            // CPL
+                            line("a = ~a;");
+                            line("f |= 0x60;");
+                            return true;
+                        case 6:
+                            // SCF
+                            line("f = (f & 0x80) | 0x10;");
+                            return true;
+                        case 7:
+                            // CCF
+                            line("f = (f ^ 0x10) & 0x90;");
+                            return true;
+                        default:
+                            return false;
+                    }
+            }
+        }
+
+        if (x == 1) {
+            // LD r, r' / LD r, (HL) / LD (HL), r
+            if (y == 6 && z == 6) {
+                // HALT
+                return false;
+            }
+            if (z == 6) {
+                load(pair(2), REGISTERS[y]);
+            } else if (y == 6) {
+                store(pair(2), REGISTERS[z]);
+            } else if (y != z) {
+                line(format("%s = %s;", REGISTERS[y], REGISTERS[z]));
+            }
+            return true;
+        }
+
+        if (x == 2) {
+            // ALU A, r / ALU A, (HL)
+            if (z == 6) {
+                load(pair(2), "value");
+                line(format("alu(%u, a, f, value);", y));
+            } else {
+                line(format("alu(%u, a, f, %s);", y, REGISTERS[z]));
+            }
+            return true;
+        }
+
+        switch (z) {
+            case 0:
+                if (y < 4) {
+                    // RET f
+                    m_successors->push_back(next);
+                    line(format("if (!(%s)) ", CONDITIONS[y]) + exit(next, cycles));
+                    load("sp", "low");
+                    load("static_cast<uint16_t>(sp + 1)", "high");
+                    line("sp += 2;");
+                    line(exit("static_cast<uint16_t>(high << 8u | low)", m_cycles + 20));
+                    return true;
+                }
+                if (y == 4 || y == 6) {
+                    // LD (FF00+n), A / LD A, (FF00+n)
+                    const std::string address = format("0x%04X", 0xFF00u + n);
+                    (y == 4) ? store(address, "a") : load(address, "a");
+                    return true;
+                }
+                return false;
+            case 1:
+                if (!q) {
+                    // POP rr
+                    load("sp", "low");
+                    load("static_cast<uint16_t>(sp + 1)", "high");
+                    line("sp += 2;");
+                    if (p == 3) {
+                        line("a = high;");
+                        line("f = low & 0xF0;");
+                    } else {
+                        line(format("%s = high;", PAIR_HIGH[p]));
+                        line(format("%s = low;", PAIR_LOW[p]));
+                    }
+                    return true;
+                }
+                switch (p) {
+                    case 0:
+                        // RET
+                        load("sp", "low");
+                        load("static_cast<uint16_t>(sp + 1)", "high");
+                        line("sp += 2;");
+                        line(exit("static_cast<uint16_t>(high << 8u | low)", cycles));
+                        return true;
+                    case 2:
+                        // JP HL
+                        line(exit(pair(2), cycles));
+                        return true;
+                    case 3:
+                        // LD SP, HL
+                        line("sp = " + pair(2) + ";");
+                        return true;
+                    default:
+                        // RETI
+                        return false;
+                }
+            case 2:
+                if (y < 4) {
+                    // JP f, nn
+                    m_successors->push_back(nn);
+                    m_successors->push_back(next);
+                    jumpIf(y, exit(nn, m_cycles + 16), cycles);
+                    return true;
+                }
+                if (y == 4 || y == 6) {
+                    // LD (FF00+C), A / LD A, (FF00+C)
+                    (y == 4) ? store("static_cast<uint16_t>(0xFF00 | c)", "a")
+                             : load("static_cast<uint16_t>(0xFF00 | c)", "a");
+                    return true;
+                }
+                // LD (nn), A / LD A, (nn)
+                (y == 5) ? store(format("0x%04X", nn), "a") : load(format("0x%04X", nn), "a");
+                return true;
+            case 3:
+                if (y == 0) {
+                    // JP nn
+                    m_successors->push_back(nn);
+                    line(exit(nn, m_cycles + 16));
+                    return true;
+                }
+                if (y == 1) {
+                    return prefixInstruction(n);
+                }
+                // DI, EI and invalid opcodes
+                return false;
+            case 4:
+                if (y < 4) {
+                    // CALL f, nn
+                    m_successors->push_back(nn);
+                    m_successors->push_back(next);
+                    line(format("if (!(%s)) ", CONDITIONS[y]) + exit(next, cycles));
+                    store("static_cast<uint16_t>(sp - 1)", format("0x%02X", next >> 8u));
+                    store("static_cast<uint16_t>(sp - 2)", format("0x%02X", next & 0xFFu));
+                    line("sp -= 2;");
+                    line(exit(nn, m_cycles + 24));
+                    return true;
+                }
+                return false;
+            case 5:
+                if (!q) {
+                    // PUSH rr
+                    const std::string high = (p == 3) ? "a" : PAIR_HIGH[p];
+                    const std::string low = (p == 3) ? "f" : PAIR_LOW[p];
+                    store("static_cast<uint16_t>(sp - 1)", high);
+                    store("static_cast<uint16_t>(sp - 2)", low);
+                    line("sp -= 2;");
+                    return true;
+                }
+                if (y == 1) {
+                    // CALL nn
+                    m_successors->push_back(nn);
+                    m_successors->push_back(next);
+                    store("static_cast<uint16_t>(sp - 1)", format("0x%02X", next >> 8u));
+                    store("static_cast<uint16_t>(sp - 2)", format("0x%02X", next & 0xFFu));
+                    line("sp -= 2;");
+                    line(exit(nn, cycles));
+                    return true;
+                }
+                return false;
+            case 6:
+                // ALU A, n
+                line(format("alu(%u, a, f, 0x%02X);", y, n));
+                return true;
+            default:
+                // RST
+                m_successors->push_back(y * 8u);
+                m_successors->push_back(next);
+                store("static_cast<uint16_t>(sp - 1)", format("0x%02X", next >> 8u));
+                store("static_cast<uint16_t>(sp - 2)", format("0x%02X", next & 0xFFu));
+                line("sp -= 2;");
+                line(exit(y * 8u, cycles));
+                return true;
+        }
+    }
+
+    bool BlockTranslator::prefixInstruction(uint8_t opcode) {
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 7u;
+        const uint8_t z = opcode & 7u;
+        if (z == 6) {
+            // (HL)
+            return false;
+        }
+
+        const char* target = REGISTERS[z];
+        switch (x) {
+            case 0:
+                // RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+                line(format("%s = rotate(%u, f, %s);", target, y, target));
+                break;
+            case 1:
+                // BIT
+                line(format("f = (f & 0x10) | 0x20 | ((%s & 0x%02X) ? 0x00 : 0x80);", target, 1u << y));
+                break;
+            case 2:
+                // RES
+                line(format("%s &= 0x%02X;", target, ~(1u << y) & 0xFFu));
+                break;
+            default:
+                // SET
+                line(format("%s |= 0x%02X;", target, 1u << y));
+                break;
+        }
+        return true;
+    }
+
+    std::string BlockTranslator::exit(const std::string& pc, uint32_t cycles) const {
+        return format("{ context->pc = %s; cycles = %u; goto done; }", pc.c_str(), cycles);
+    }
+
+    void BlockTranslator::load(const std::string& address, const std::string& value) {
+        line("address = " + address + ";");
+        if (m_first) {
+            // The devices are up to date at the start of the block
+            line("if (!aotRead(context, address, byte)) byte = context->readThrough(context->mmu, address);");
+        } else {
+            // Let the interpreter do it once the devices have caught up
+            line("if (!aotRead(context, address, byte)) " + exitBefore());
+        }
+        line(value + " = byte;");
+    }
+
+    void BlockTranslator::store(const std::string& address, const std::string& value) {
+        line("address = " + address + ";");
+        if (m_first) {
+            line("if (!aotWrite(context, address, " + value + ")) {");
+            line("    context->writeThrough(context->mmu, address, " + value + ");");
+            line("    wroteThrough = true;");
+            line("}");
+            m_mayWriteThrough = true;
+        } else {
+            line("if (!aotWrite(context, address, " + value + ")) " + exitBefore());
+        }
+    }
+
+    void BlockTranslator::jumpIf(uint8_t condition, const std::string& takenCode, uint32_t cycles) {
+        line(format("if (%s) ", CONDITIONS[condition]) + takenCode);
+        line(exit(m_address + CPU::lengthOf(m_rom.byte(m_bank, m_address)), cycles));
+    }
+
+    std::string BlockTranslator::pair(uint8_t pair) const {
+        if (pair == 3) {
+            return "sp";
+        }
+        return format("static_cast<uint16_t>(%s << 8u | %s)", PAIR_HIGH[pair], PAIR_LOW[pair]);
+    }
+
+    void BlockTranslator::setPair(uint8_t pair, const std::string& value) {
+        if (pair == 3) {
+            line("sp = static_cast<uint16_t>(" + value + ");");
+            return;
+        }
+        line("word = static_cast<uint16_t>(" + value + ");");
+        line(format("%s = word >> 8u;", PAIR_HIGH[pair]));
+        line(format("%s = word & 0xFFu;", PAIR_LOW[pair]));
+    }
+
+    // Finds every block reachable from the entry points, and translates it
+    class Translator {
+    public:
+        explicit Translator(const Rom& rom) : m_rom{rom} {}
+
+        std::string translate(const std::string& romName);
+
+    private:
+        // Queues a block at `pc`, reached from code in `bank`
+        void reach(uint16_t bank, uint16_t pc);
+
+        const Rom& m_rom;
+
+        std::deque<Key> m_queue;
+        std::set<Key> m_seen;
+
+        // Translated blocks, ordered by key
+        std::map<Key, std::string> m_blocks;
+    };
+
+    void Translator::reach(uint16_t bank, uint16_t pc) {
+        if (pc >= 0x8000) {
+            // Code in RAM is left to the interpreter
+            return;
+        }
+
+        auto queue = [this](Key key) {
+            if (m_seen.size() < MAX_BLOCKS && m_seen.insert(key).second) {
+                m_queue.push_back(key);
+            }
+        };
+
+        if (pc <= 0x3FFF) {
+            queue({0, pc});
+        } else if (bank != 0) {
+            queue({bank, pc});
+        } else {
+            // Whichever bank is switched in when bank 0 jumps here isn't known
+            for (uint16_t switched = 1; switched < m_rom.bankCount; ++switched) {
+                queue({switched, pc});
+            }
+        }
+    }
+
+    std::string Translator::translate(const std::string& romName) {
+        // The entry point, restart vectors and interrupt vectors
+        reach(0, 0x0100);
+        for (uint16_t vector = 0x00; vector <= 0x60; vector += 0x08) {
+            reach(0, vector);
+        }
+
+        while (!m_queue.empty()) {
+            const Key key = m_queue.front();
+            m_queue.pop_front();
+
+            std::vector<uint16_t> successors;
+            std::string code = BlockTranslator{m_rom, key}.translate(successors);
+            if (!code.empty()) {
+                m_blocks.emplace(key, std::move(code));
+            }
+            for (uint16_t successor : successors) {
+                reach(key.second >= 0x4000 ? key.first : 0, successor);
+            }
+        }
+
+        if (m_seen.size() >= MAX_BLOCKS) {
+            std::cerr << "warning: stopped after " << MAX_BLOCKS << " blocks\n";
+        }
+
+        uint64_t romHash = aotHash(nullptr, 0);
+        for (uint16_t bank = 0; bank < m_rom.bankCount; ++bank) {
+            romHash = aotHash(m_rom.data.data() + bank * 0x4000u, 0x4000, romHash);
+        }
+
+        std::string source = "// Generated by bigboy-aot from " + romName + "; do not edit\n\n";
+        source += "#include <bigboy/AOT.h>\n\n";
+        source += PRELUDE;
+
+        auto name = [](const Key& key) { return format("block_%u_%04X", key.first, key.second); };
+
+        for (const auto& [key, code] : m_blocks) {
+            source += "\nstatic uint8_t " + name(key) + "(AotContext* context) {\n";
+            source += "    uint8_t a = context->a, f = context->f, b = context->b, c = context->c;\n";
+            source += "    uint8_t d = context->d, e = context->e, h = context->h, l = context->l;\n";
+            source += "    uint16_t sp = context->sp;\n";
+            source += "    uint8_t cycles, byte, value, low, high;\n";
+            source += "    uint16_t address, word;\n";
+            source += "    bool wroteThrough = false;\n";
+            source += "    (void) byte; (void) value; (void) low; (void) high; (void) address; (void) word;\n";
+            source += "    (void) wroteThrough;\n";
+            source += code;
+            source += "done:\n";
+            source += "    context->a = a; context->f = f; context->b = b; context->c = c;\n";
+            source += "    context->d = d; context->e = e; context->h = h; context->l = l;\n";
+            source += "    context->sp = sp;\n";
+            source += "    return cycles;\n";
+            source += "}\n";
+        }
+
+        source += "\nstatic const AotBlock BLOCKS[] = {\n";
+        for (const auto& entry : m_blocks) {
+            const Key& key = entry.first;
+            source += format("    {%u, 0x%04X, &", key.first, key.second) + name(key) + "},\n";
+        }
+        source += "};\n\n";
+        source += format("static const AotModule MODULE{AOT_ABI_VERSION, 0x%016llXull, BLOCKS, %zu};\n\n",
+                         static_cast<unsigned long long>(romHash), m_blocks.size());
+        source += "extern \"C\" const AotModule* " BIGBOY_AOT_MODULE_SYMBOL "() {\n    return &MODULE;\n}\n";
+
+        std::cerr << "translated " << m_blocks.size() << " blocks\n";
+        return source;
+    }
+
+    bool readRom(const std::string& path, Rom& rom) {
+        std::ifstream file{path, std::ios::binary};
+        if (!file.is_open()) {
+            return false;
+        }
+        rom.data.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+
+        // Whole banks only, as the core sees them
+        rom.bankCount = static_cast<uint16_t>(rom.data.size() / 0x4000);
+        return rom.bankCount > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    const bool sourceOnly = argc > 1 && std::string{argv[argc - 1]} == "--source";
+    const int paths = sourceOnly ? argc - 2 : argc - 1;
+    if (paths < 1 || paths > 2) {
+        std::cerr << "fatal: invalid command line arguments\n"
+                     "- usage: bigboy-aot [rom_path] [output_path] [--source]\n";
+        return -1;
+    }
+
+    const std::string romPath = argv[1];
+    const std::string outputPath = (paths == 2) ? argv[2] : romPath + ".aot.so";
+    const std::string sourcePath = sourceOnly ? outputPath : outputPath + ".cpp";
+
+    Rom rom;
+    if (!readRom(romPath, rom)) {
+        std::cerr << "fatal: could not read a ROM from the path " << romPath << '\n';
+        return 1;
+    }
+
+    {
+        std::ofstream source{sourcePath};
+        source << Translator{rom}.translate(romPath);
+        if (!source.good()) {
+            std::cerr << "fatal: could not write " << sourcePath << '\n';
+            return 1;
+        }
+    }
+    if (sourceOnly) {
+        return 0;
+    }
+
+    // The compiler and include directory Bigboy was built with, unless
+    // overridden
+    const char* compiler = std::getenv("CXX");
+    const char* includeDirectory = std::getenv("BIGBOY_INCLUDE_DIR");
+    const std::string command = std::string{compiler ? compiler : BIGBOY_AOT_CXX} +
+            " -std=c++17 -O2 -shared -fPIC -I\"" + (includeDirectory ? includeDirectory : BIGBOY_AOT_INCLUDE_DIR) +
+            "\" -o \"" + outputPath + "\" \"" + sourcePath + "\"";
+    std::cerr << command << '\n';
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "fatal: could not compile " << sourcePath << '\n';
+        return 1;
+    }
+
+    return 0;
+}
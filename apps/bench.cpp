@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <bigboy/Emulator.h>
+#include <bigboy/Lockstep.h>
+
+// Runs a ROM headlessly for a fixed number of frames and reports how long it
+// took under each CPU dispatch mode (and the JIT and AOT modules, when they
+// are built), and for many copies of it run side by side in lockstep. Compile
+// time options such as BIGBOY_THREADED_INTERPRETER are compared by
+// running it from builds with and without them.
+// - usage: bigboy-bench [rom_path] [frames]
+
+struct BenchMode {
+    const char* name;
+    DispatchMode dispatchMode;
+    bool jit;
+    bool aot;
+};
+
+struct BenchResult {
+    double seconds;
+    uint32_t frameHash;
+};
+
+static uint32_t hashFrame(const std::array<Colour, 160*144>& frame) {
+    uint32_t frameHash = 2166136261u;
+    for (const Colour& colour : frame) {
+        frameHash = (frameHash ^ colour.r ^ (colour.g << 8u) ^ (colour.b << 16u)) * 16777619u;
+    }
+    return frameHash;
+}
+
+static BenchResult run(const std::string& romPath, int frames, const BenchMode& mode) {
+    Emulator emulator;
+    if (!emulator.loadRomFile(romPath)) {
+        throw std::runtime_error{"Bigboy could not load a ROM from the path " + romPath};
+    }
+    emulator.setDispatchMode(mode.dispatchMode);
+#ifdef BIGBOY_JIT
+    if (mode.jit && !emulator.setJITEnabled(true)) {
+        throw std::runtime_error{"Bigboy could not enable the JIT"};
+    }
+#endif
+#ifdef BIGBOY_AOT
+    if (mode.aot && !emulator.loadAotModule(romPath + ".aot.so")) {
+        throw std::runtime_error{"Bigboy could not load the AOT module " + romPath + ".aot.so"};
+    }
+#endif
+
+    // Hash the final frame so that we notice if the modes disagree
+    uint32_t frameHash = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        const std::array<Colour, 160*144>& frame = emulator.update();
+        if (i == frames - 1) {
+            frameHash = hashFrame(frame);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    return BenchResult{std::chrono::duration<double>(end - start).count(), frameHash};
+}
+
+static BenchResult runLockstep(const std::string& romPath, int frames, Lockstep& lockstep) {
+    if (!lockstep.loadRomFile(romPath)) {
+        throw std::runtime_error{"Bigboy could not load a ROM from the path " + romPath};
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        lockstep.update();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // Every lane has the same input, so should end up on the same frame
+    uint32_t frameHash = hashFrame(lockstep.frame(0));
+    for (size_t lane = 1; lane < lockstep.laneCount(); ++lane) {
+        if (hashFrame(lockstep.frame(lane)) != frameHash) {
+            frameHash = 0;
+        }
+    }
+
+    return BenchResult{std::chrono::duration<double>(end - start).count(), frameHash};
+}
+
+#ifdef BIGBOY_STATS
+// What the ROM spends its time on, with the block cache, so that runs of
+// different ROMs can be compared
+static void printStats(const std::string& romPath, int frames) {
+    Emulator emulator;
+    if (!emulator.loadRomFile(romPath)) {
+        throw std::runtime_error{"Bigboy could not load a ROM from the path " + romPath};
+    }
+    emulator.setDispatchMode(DispatchMode::BLOCK_CACHE);
+    emulator.setStatsEnabled(true);
+    for (int i = 0; i < frames; ++i) {
+        emulator.update();
+    }
+
+    const ExecutionStats& stats = *emulator.stats();
+    std::cout << "\nstats: " << stats.instructions << " instructions, " << stats.cycles() << " cycles ("
+              << stats.haltedCycles << " halted, " << stats.idleSkippedCycles << " skipped in "
+              << stats.idleSkips << " idle loops), " << stats.bulkIterations << " copy loop iterations in bulk\n";
+
+    // The five most executed opcodes
+    std::array<uint16_t, 512> order{};
+    for (uint16_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::partial_sort(order.begin(), order.begin() + 5, order.end(), [&stats](uint16_t a, uint16_t b) {
+        return stats.opcodes[a] > stats.opcodes[b];
+    });
+    for (size_t i = 0; i < 5; ++i) {
+        std::cout << "  " << ((order[i] >= 256) ? "CB " : "") << std::hex << (order[i] & 0xFFu) << std::dec << ": "
+                  << stats.opcodes[order[i]] << '\n';
+    }
+}
+#endif
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "fatal: invalid command line arguments\n- usage: bigboy-bench [rom_path] [frames]\n";
+        return -1;
+    }
+
+    const std::string romPath = argv[1];
+    const int frames = (argc == 3) ? std::stoi(argv[2]) : 3600;
+
+    std::cout << "threaded interpreter: " <<
+#ifdef BIGBOY_THREADED_INTERPRETER
+            "on"
+#else
+            "off"
+#endif
+            << '\n';
+
+    const BenchMode modes[] = {
+            {"switch", DispatchMode::SWITCH, false, false},
+            {"table", DispatchMode::TABLE, false, false},
+            {"block cache", DispatchMode::BLOCK_CACHE, false, false},
+#ifdef BIGBOY_JIT
+            {"jit", DispatchMode::TABLE, true, false},
+#endif
+#ifdef BIGBOY_AOT
+            // Translated by bigboy-aot to rom_path.aot.so beforehand
+            {"aot", DispatchMode::TABLE, false, true},
+#endif
+    };
+
+    // The switch is the baseline everything else is compared against
+    const BenchResult baseline = run(romPath, frames, modes[0]);
+
+    std::cout << '\n';
+    bool mismatch = false;
+    for (const BenchMode& mode : modes) {
+        const BenchResult result = (&mode == &modes[0]) ? baseline : run(romPath, frames, mode);
+        std::cout << mode.name << ": " << result.seconds << "s (" << frames / result.seconds << " frames/s, "
+                  << baseline.seconds / result.seconds << "x)\n";
+
+        if (result.frameHash != baseline.frameHash) {
+            std::cerr << "error: dispatch mode '" << mode.name << "' produced different frames\n";
+            mismatch = true;
+        }
+    }
+
+    // Per lane, so that it compares with the single emulator above
+    constexpr size_t LANES = 16;
+    Lockstep lockstep{LANES};
+    const BenchResult result = runLockstep(romPath, frames, lockstep);
+    const LockstepStats& stats = lockstep.stats();
+    const double laneSeconds = result.seconds / LANES;
+    std::cout << "lockstep (" << LANES << " lanes): " << laneSeconds << "s per lane (" << frames / laneSeconds
+              << " frames/s, " << baseline.seconds / laneSeconds << "x), " << 100 * stats.lockstepFraction()
+              << "% of instructions in lockstep at " << 100 * stats.laneUtilization(LANES) << "% lane utilization\n";
+
+    if (result.frameHash != baseline.frameHash) {
+        std::cerr << "error: lockstep lanes produced different frames\n";
+        mismatch = true;
+    }
+
+#ifdef BIGBOY_STATS
+    printStats(romPath, frames);
+#endif
+
+    return mismatch ? 1 : 0;
+}
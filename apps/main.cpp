@@ -1,19 +1,40 @@
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <unordered_map>
 
 #include <SDL.h>
 
+#include <bigboy/Diagnostics.h>
 #include <bigboy/Emulator.h>
 
 class App {
 public:
-    App(const std::string& romPath) {
+    App(const std::string& romPath, const std::string& profilePath) : m_profilePath{profilePath} {
         // Initialise Bigboy
         if (!m_emulator.loadRomFile(romPath)) {
             throw std::runtime_error{"Bigboy could not load a ROM from the path " + romPath};
         }
 
+#ifdef BIGBOY_AOT
+        // Run code translated by bigboy-aot, if it has been
+        const std::string aotPath = romPath + ".aot.so";
+        if (std::ifstream{aotPath}.good()) {
+            m_emulator.loadAotModule(aotPath);
+        }
+#endif
+
+#ifdef BIGBOY_PROFILER
+        m_emulator.setProfilingEnabled(!m_profilePath.empty());
+#endif
+
+#ifdef BIGBOY_TRACE
+        // Keep the last million steps, which are written out if Bigboy
+        // crashes, or whenever T is pressed
+        m_emulator.setTraceCapacity(1u << 20u);
+        m_emulator.tracer()->dumpOnCrash(tracePath);
+#endif
+
         const std::string savePath = "./saves/" + m_emulator.getGameTitle() + ".sav";
         m_emulator.loadRamFileIfSupported(savePath);
 
@@ -49,6 +70,11 @@ public:
     }
 
     ~App() {
+        writeProfile();
+
+        // Sum up the bad accesses the warnings were rate limited for
+        Diagnostics::get().writeSummary(std::cerr);
+
         // Destroy screen texture
         SDL_DestroyTexture(m_screen);
 
@@ -90,6 +116,22 @@ public:
     }
 
 private:
+    void writeProfile() {
+#ifdef BIGBOY_PROFILER
+        if (!m_profilePath.empty() && !m_emulator.writeProfile(m_profilePath)) {
+            std::cerr << "warning: could not write the profile to " << m_profilePath << '\n';
+        }
+#endif
+    }
+
+    void writeTrace() {
+#ifdef BIGBOY_TRACE
+        if (!m_emulator.tracer()->dump(tracePath)) {
+            std::cerr << "warning: could not write the trace to " << tracePath << '\n';
+        }
+#endif
+    }
+
     void handleEvents() {
         SDL_Event event;
         while (SDL_PollEvent(&event) != 0) {
@@ -98,6 +140,12 @@ private:
                     SDL_Keycode key = event.key.keysym.sym;
                     if (pressEvents.count(key) > 0) {
                         m_emulator.handleInput(pressEvents.at(key));
+                    } else if (key == SDLK_p) {
+                        // Write the profile so far
+                        writeProfile();
+                    } else if (key == SDLK_t) {
+                        // Write the most recent steps
+                        writeTrace();
                     }
                     break;
                 }
@@ -123,6 +171,11 @@ private:
 
     bool m_running = false;
 
+    // Where the profile is written, if profiling
+    std::string m_profilePath;
+
+    static constexpr const char* tracePath = "./bigboy-trace.txt";
+
     static constexpr unsigned int screenScale = 4;
     static constexpr unsigned int screenWidth = 160 * screenScale;
     static constexpr unsigned int screenHeight = 144 * screenScale;
@@ -148,12 +201,21 @@ private:
 };
 
 int main(int argc, char** argv) {
+#ifdef BIGBOY_PROFILER
+    // With a profile path the guest code is profiled, and the profile written
+    // there on exit, or whenever P is pressed
+    if (argc != 2 && argc != 3) {
+        std::cerr << "fatal: invalid command line arguments\n- usage: bigboy [rom_path] [profile_path]\n";
+        return -1;
+    }
+#else
     if (argc != 2) {
         std::cerr << "fatal: invalid command line arguments\n- usage: bigboy [rom_path]\n";
         return -1;
     }
+#endif
 
-    App app{argv[1]};
+    App app{argv[1], (argc == 3) ? argv[2] : ""};
     app.run();
 
     return 0;
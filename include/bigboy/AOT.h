@@ -0,0 +1,154 @@
+#ifndef BIGBOY_AOT_H
+#define BIGBOY_AOT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Ahead-of-time translated ROM code. bigboy-aot (apps/aot.cpp) walks the code
+// reachable in a ROM, translates each block into a C++ function and compiles
+// them into a shared object, which the core loads alongside the ROM. Blocks
+// follow the same rules as the JIT's (see JIT.h): they run straight through
+// to the first jump, memory accesses beyond ROM, work RAM and high RAM go
+// through the MMU only in the first instruction of a block, and the cycles of
+// the whole block are charged when it returns.
+//
+// The generated code depends on nothing but the declarations below, which
+// make up the interface between it and the core. Changing any of them means
+// bumping AOT_ABI_VERSION, so that stale modules are refused.
+
+constexpr uint32_t AOT_ABI_VERSION = 1;
+
+// State shared with a translated block
+struct AotContext {
+    // Host memory backing each 4KB region of the address space, or nullptr
+    // where accesses have to go through the MMU
+    std::array<const uint8_t*, 16> read;
+    std::array<uint8_t*, 16> write;
+
+    // High RAM (FF80-FFFE), and where to write to it (nullptr if writes have
+    // to go through the MMU)
+    const uint8_t* highRam;
+    uint8_t* highRamWrite;
+
+    uint8_t (*readThrough)(void* mmu, uint16_t address);
+    void (*writeThrough)(void* mmu, uint16_t address, uint8_t value);
+    void* mmu;
+
+    // The guest registers, loaded and stored around every block
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t sp;
+
+    // Where execution continues after the block
+    uint16_t pc;
+};
+
+// Runs a block, and returns the cycles it took. 0 means that it did nothing,
+// and the interpreter should execute the instruction at its start instead.
+using AotFunction = uint8_t (*)(AotContext*);
+
+struct AotBlock {
+    // ROM bank, for 4000-7FFF; 0 for bank 0
+    uint16_t bank;
+    uint16_t pc;
+    AotFunction code;
+};
+
+struct AotModule {
+    uint32_t abiVersion;
+
+    // aotHash() of the whole ROM the module was translated from
+    uint64_t romHash;
+
+    const AotBlock* blocks;
+    size_t blockCount;
+};
+
+// Every module exports this, returning its description
+#define BIGBOY_AOT_MODULE_SYMBOL "bigboyAotModule"
+using AotModuleFunction = const AotModule* (*)();
+
+// FNV-1a, chained across calls through `hash`
+inline uint64_t aotHash(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Memory accesses from generated code; false if the access has to go through
+// the MMU
+inline bool aotRead(const AotContext* context, uint16_t address, uint8_t& value) {
+    if (const uint8_t* memory = context->read[address >> 12u]) {
+        value = memory[address & 0xFFFu];
+        return true;
+    }
+    if (address >= 0xFF80 && address != 0xFFFF) {
+        value = context->highRam[address - 0xFF80];
+        return true;
+    }
+    return false;
+}
+
+inline bool aotWrite(AotContext* context, uint16_t address, uint8_t value) {
+    if (uint8_t* memory = context->write[address >> 12u]) {
+        memory[address & 0xFFFu] = value;
+        return true;
+    }
+    if (address >= 0xFF80 && address != 0xFFFF && context->highRamWrite) {
+        context->highRamWrite[address - 0xFF80] = value;
+        return true;
+    }
+    return false;
+}
+
+class CPU;
+
+// Runs the blocks of a module loaded for the current ROM
+class AOT {
+public:
+    explicit AOT(CPU& cpu);
+    ~AOT();
+
+    AOT(const AOT&) = delete;
+    AOT& operator=(const AOT&) = delete;
+
+    // Loads the module at `path`; false if it cannot be loaded, or was built
+    // for another ROM or version of the ABI
+    bool load(const std::string& path);
+
+    // Runs the translated block at the CPU's program counter. Returns the
+    // number of cycles it took, or 0 if there is none and the interpreter
+    // should execute the next instruction instead.
+    uint8_t execute();
+
+    size_t blockCount() const { return m_blockCount; }
+
+private:
+    using BankBlocks = std::array<AotFunction, 0x4000>;
+
+    // Points the context at the ROM bank switched in, and at work RAM
+    void map();
+
+    CPU& m_cpu;
+
+    void* m_library = nullptr;
+    size_t m_blockCount = 0;
+
+    // Blocks in bank 0 by address, and in each switchable bank by address
+    // less 4000
+    std::unique_ptr<BankBlocks> m_rom0;
+    std::vector<std::unique_ptr<BankBlocks>> m_banks;
+
+    AotContext m_context{};
+
+    // The ROM bank mapped into m_context.read, and whether writes to work RAM
+    // have to go through the MMU, as of the last map()
+    uint16_t m_mappedBank = 0xFFFF;
+    bool m_writeThrough = true;
+};
+
+#endif //BIGBOY_AOT_H
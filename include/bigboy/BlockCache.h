@@ -0,0 +1,115 @@
+#ifndef BIGBOY_BLOCKCACHE_H
+#define BIGBOY_BLOCKCACHE_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class CPU;
+class InternalMemory;
+
+// A single pre-decoded instruction
+struct MicroOp {
+    // Handler from the CPU's dispatch tables, specialised for the operands
+    // encoded in the opcode
+    uint8_t (*handler)(CPU&);
+
+    // Address of the instruction
+    uint16_t pc;
+
+    // Immediate operand bytes following the opcode, if any
+    std::array<uint8_t, 2> operands;
+
+    // Length of the opcode: 1, or 2 for CB-prefixed instructions
+    uint8_t opcodeLength;
+
+    // Cycle cost (the not-taken cost for conditional control flow)
+    uint8_t cycles;
+};
+
+// A straight-line run of instructions, ending with the first one that may
+// transfer control elsewhere
+struct Block {
+    std::vector<MicroOp> ops;
+
+    // Address of the last byte decoded
+    uint16_t last = 0;
+};
+
+// Blocks of decoded instructions, keyed by (bank, address). ROM at 4000-7FFF
+// is keyed by the bank switched in when the block was entered; everything
+// else is keyed by bank 0. Only ROM, work RAM (and its echo) and high RAM
+// are cached.
+class BlockCache {
+public:
+    // Returns the next micro-op of the block being executed, if execution is
+    // still following it, otherwise nullptr
+    const MicroOp* next(uint16_t pc) {
+        if (m_cursor != m_end && m_cursor->pc == pc) {
+            return m_cursor++;
+        }
+        return nullptr;
+    }
+
+    const Block* find(uint16_t bank, uint16_t pc) {
+        LookupEntry& entry = m_lookup[pc & (m_lookup.size() - 1)];
+        const uint32_t key = makeKey(bank, pc);
+        if (entry.block && entry.key == key) {
+            return entry.block;
+        }
+
+        entry.block = findSlow(key);
+        entry.key = key;
+        return entry.block;
+    }
+
+    const Block& insert(uint16_t bank, uint16_t pc, Block block);
+
+    // Start following `block`; returns its first micro-op
+    const MicroOp* enter(const Block& block);
+
+    // Must be told about every write to ROM, which are MBC register writes
+    // that may switch banks
+    void onRomWrite() { leave(); }
+
+    // Decoded code in work RAM and high RAM is marked in `memory`, which calls
+    // onCodeWrite() when any of it is written to. That drops every block
+    // decoded from the same 256-byte page.
+    void setMemory(InternalMemory* memory) { m_memory = memory; }
+    void onCodeWrite(uint16_t address);
+
+    void clear();
+
+private:
+    void leave() { m_cursor = m_end = nullptr; }
+
+    const Block* findSlow(uint32_t key) const;
+
+    void invalidatePage(uint8_t page);
+
+    static uint32_t makeKey(uint16_t bank, uint16_t pc) { return (static_cast<uint32_t>(bank) << 16u) | pc; }
+
+    std::unordered_map<uint32_t, Block> m_blocks;
+
+    // Blocks recently found, indexed by the low bits of their address, so
+    // that the blocks of a loop are usually found without hashing. A block
+    // keeps its address in m_blocks until it is erased, which clears the
+    // entries here.
+    struct LookupEntry {
+        uint32_t key = 0;
+        const Block* block = nullptr;
+    };
+    std::array<LookupEntry, 1024> m_lookup{};
+
+    // The block currently being executed
+    const MicroOp* m_cursor = nullptr;
+    const MicroOp* m_end = nullptr;
+
+    InternalMemory* m_memory = nullptr;
+
+    // The blocks decoded from each 256-byte page of RAM
+    std::array<std::vector<uint32_t>, 256> m_pageBlocks{};
+};
+
+#endif //BIGBOY_BLOCKCACHE_H
@@ -1,10 +1,31 @@
 #ifndef BIGBOY_CPU_H
 #define BIGBOY_CPU_H
 
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <bigboy/BlockCache.h>
+#ifdef BIGBOY_STATS
+#include <bigboy/ExecutionStats.h>
+#endif
+#include <bigboy/InterruptController.h>
 #include <bigboy/MMU.h>
 #include <bigboy/OpCode.h>
 #include <bigboy/PrefixOpCode.h>
+#ifdef BIGBOY_PROFILER
+#include <bigboy/Profiler.h>
+#endif
 #include <bigboy/Registers.h>
+#include <bigboy/Timing.h>
+#ifdef BIGBOY_TRACE
+#include <bigboy/Tracer.h>
+#endif
+
+#if defined(BIGBOY_PROFILER) || defined(BIGBOY_TRACE) || defined(BIGBOY_STATS)
+#define BIGBOY_INSTRUMENTED
+#endif
 
 enum class BitOperand : uint8_t {
     BIT0 = 0, // 000
@@ -28,52 +49,325 @@ enum class ResetOperand : uint16_t {
     x38 = 0x38
 };
 
-enum class Interrupt : uint8_t {
-    VBLANK = 0,
-    LCD_STAT = 1,
-    TIMER = 2,
-    SERIAL = 3,
-    JOYPAD = 4
+class AOT;
+class Cartridge;
+class IdleLoopDetector;
+class JIT;
+
+// How CPU::step() gets from an opcode byte to the code that executes it.
+enum class DispatchMode {
+    // The switch statements in CPU::dispatch() and CPU::stepPrefix()
+    SWITCH,
+    // 256-entry tables of handlers, one per opcode, each specialised for the
+    // operands encoded in its opcode. Generated at compile time.
+    TABLE,
+    // Straight-line runs of code are decoded once into blocks of table
+    // handlers and their operands (see BlockCache.h), which are then
+    // executed without fetching or decoding them again. This only saves the
+    // fetch and decode of each instruction, so it is little faster than
+    // TABLE, other than in the copy loops it runs in bulk.
+    BLOCK_CACHE
 };
 
-constexpr uint8_t INTERRUPT_COUNT = 5;
-
 class CPU {
 public:
     explicit CPU(MMU& mmu);
+    ~CPU();
     void reset();
 
-    uint8_t step();
+    uint8_t step() {
+#ifdef BIGBOY_PROFILER
+        if (m_profiler) {
+            return profiledStep();
+        }
+#endif
+        return unprofiledStep();
+    }
+
+    // Brings the devices up to date with the `cycles` cycles the CPU has run
+    // ahead of them (see runUntil())
+    using SyncCallback = void (*)(void* context, uint32_t cycles);
+    void setDeviceSync(SyncCallback sync, void* context);
+
+    // Executes instructions back to back until at least `deadline` cycles have
+    // passed, and returns how many did. The caller promises that no device
+    // does anything the CPU could notice before the deadline, so the devices
+    // are only brought up to date when the CPU accesses an I/O register
+    // (FF00-FF7F), just before the access, and once the batch is over. It
+    // ends early:
+    //  - after an instruction that wrote to an I/O register, as that may have
+    //    moved the next device event
+    //  - once an interrupt can be serviced, which is left to the caller to do
+    //    after the devices are up to date, just as with step()
+    //  - when the CPU halts or stops
+    //  - at the start of an idle loop, if there is an idle loop detector (see
+    //    idleIteration())
+    // As a result every interrupt is requested and serviced at the same
+    // instruction boundary as it would be if the CPU were stepped, and the
+    // devices were updated after every instruction.
+    uint32_t runUntil(uint32_t deadline);
+
+    // Watch for idle loops during runUntil(). Nothing by default.
+    void setIdleLoopDetector(IdleLoopDetector* detector) { m_idleLoops = detector; }
+
+    // The cycles one iteration of the idle loop takes, if that is what ended
+    // the last runUntil(), otherwise 0
+    uint8_t idleIteration() const { return m_idleIteration; }
+
+    // The MMU calls this before every access to an I/O register
+    void onIoAccess(bool write);
+
+    // The cycles of the last step that the devices have been brought up to
+    // date with during the step, and so should not be given again. Always 0
+    // unless the CPU is built with M-cycle timing (see Timing.h).
+    uint8_t syncedInStep() const { return CPUTiming::M_CYCLE_ACCURATE ? m_stepSynced : 0; }
+
+    void setDispatchMode(DispatchMode mode);
+
+    // The block cache needs to know which ROM bank is switched in
+    void setCartridge(const Cartridge* cartridge);
+
+    // The MMU calls this when the memory mapped in from the cartridge may
+    // have changed
+    void invalidateFetchWindow() {
+        m_fetchSize = 0;
+#ifdef BIGBOY_PROFILER
+        m_romBankChanged = true;
+#endif
+    }
+
+#ifdef BIGBOY_THREADED_INTERPRETER
+    // Called after every instruction with the number of cycles it took, so that
+    // the caller can bring the rest of the system up to date. Returns false to
+    // make CPU::run() return.
+    using StepCallback = bool (*)(void* context, uint8_t cycles);
+
+    // Executes instructions back to back, jumping straight from each opcode's
+    // handler to the next opcode's handler (labels-as-values), rather than
+    // returning to the caller after every instruction like step() does.
+    void run(StepCallback afterStep, void* context);
+#endif
+
+#ifdef BIGBOY_JIT
+    // Compile hot blocks to native code (see JIT.h). Off by default; turning
+    // it off again drops everything compiled. Returns whether the JIT is
+    // enabled, which it cannot be if executable memory is unavailable.
+    bool setJITEnabled(bool enabled);
+    bool jitEnabled() const { return m_jit != nullptr; }
+#endif
+
+#ifdef BIGBOY_AOT
+    // Run the blocks bigboy-aot translated ahead of time from the cartridge's
+    // ROM (see AOT.h). False if the module at `path` could not be loaded, or
+    // was not built from this ROM. Dropped when the cartridge changes.
+    bool loadAotModule(const std::string& path);
+    bool aotLoaded() const { return m_aot != nullptr; }
+#endif
+
+#ifdef BIGBOY_PROFILER
+    // Count what every step executes (see Profiler.h). Off by default;
+    // turning it on again starts a new profile.
+    void setProfilerEnabled(bool enabled);
+    Profiler* profiler() { return m_profiler.get(); }
+#endif
+
+#ifdef BIGBOY_TRACE
+    // Record every step in a ring buffer of `capacity` records (see
+    // Tracer.h), or stop tracing if it is 0. Off by default.
+    void setTraceCapacity(size_t capacity);
+    Tracer* tracer() { return m_tracer.get(); }
+#endif
+
+#ifdef BIGBOY_STATS
+    // Count instructions, cycles and opcodes (see ExecutionStats.h). Off by
+    // default; turning it on again starts from zero.
+    void setStatsEnabled(bool enabled);
+    ExecutionStats* stats() { return m_stats.get(); }
+    const ExecutionStats* stats() const { return m_stats.get(); }
+#endif
+
+#ifdef BIGBOY_INSTRUMENTED
+    // Is the profiler, the tracer or the stats counter watching every step?
+    bool instrumented() const {
+#ifdef BIGBOY_PROFILER
+        if (m_profiler) return true;
+#endif
+#ifdef BIGBOY_TRACE
+        if (m_tracer) return true;
+#endif
+#ifdef BIGBOY_STATS
+        if (m_stats) return true;
+#endif
+        return false;
+    }
+
+    // Tells the profiler, tracer and stats counter about `cycles` the
+    // emulator skipped through without stepping (a halt or idle loop), which
+    // count against the current instruction
+    void onSkipped(uint32_t cycles);
+#endif
 
     void requestInterrupt(Interrupt interrupt);
     void handleInterrupts();
 
+    // IE and IF, which must be registered with the MMU
+    InterruptController& interruptController() { return m_interrupts; }
+
+    // A halted CPU does nothing but wait for an interrupt to be requested,
+    // costing HALTED_CYCLES a step while it does
+    bool isHalted() const { return m_halted && !m_stopped; }
+    static constexpr uint8_t HALTED_CYCLES = 4;
+
+    // Static properties of an opcode: its length in bytes including operands
+    // (0 if it is not a valid opcode), its cost in cycles (the not-taken cost
+    // for conditional control flow; 0 for the CB prefix), and whether it may
+    // transfer control elsewhere.
+    static uint8_t lengthOf(uint8_t opcode);
+    static uint8_t cyclesOf(uint8_t opcode);
+    static bool endsBlock(uint8_t opcode);
+
 private:
+    friend class AOT;
+    friend class IdleLoopDetector;
+    friend class JIT;
+    friend class Lockstep;
+    friend struct MCycleTiming;
+
+    // Executes the next instruction according to the dispatch mode
+    uint8_t dispatch();
     uint8_t stepPrefix();
 
+    uint8_t unprofiledStep() {
+#ifdef BIGBOY_TRACE
+        if (m_tracer) {
+            return instrumentedStep();
+        }
+#endif
+#ifdef BIGBOY_STATS
+        if (m_stats) {
+            return instrumentedStep();
+        }
+#endif
+        return dispatch();
+    }
+
+#ifdef BIGBOY_PROFILER
+    // Counted here rather than in instrumentedStep(), so that profiling costs
+    // no more calls per step than the step itself
+    uint8_t profiledStep() {
+        // Time spent halted counts against the HALT
+        const uint16_t address = m_halted ? m_pc - 1 : m_pc;
+        uint32_t total;
+        if (address >= 0x8000) {
+            Profiler::Counts& opcodeCounts = m_profiler->opcodeCounts(peekOpcode(address));
+            const uint8_t cycles = countedStep(m_profiler->ramCounts(address), total);
+            ++opcodeCounts.instructions;
+            opcodeCounts.cycles += total;
+            return cycles;
+        }
+
+        updateProfilerBank();
+        return countedStep(m_profiler->romCounts(address, [this, address] { return peekOpcode(address); }), total);
+    }
+
+    // Steps and counts the step against `counts`. Returns the cycles the step
+    // took, and sets `total` to those plus any charged straight to the batch
+    // by copy loops run in bulk.
+    uint8_t countedStep(Profiler::Counts& counts, uint32_t& total) {
+        const uint32_t batchCycles = m_batchCycles;
+        const uint8_t cycles = unprofiledStep();
+        total = cycles + (m_batchCycles - batchCycles);
+        m_profiler->onStep(counts, total, m_registers.sp);
+        return cycles;
+    }
+
+    void updateProfilerBank() {
+        if (m_romBankChanged) {
+            m_profiler->setRomBank(bankOf(0x4000));
+            m_romBankChanged = false;
+        }
+    }
+
+    // The opcode at `address`, plus 0x100 for CB-prefixed opcodes
+    uint16_t peekOpcode(uint16_t address) {
+        const uint8_t opcode = peek(address);
+        return (opcode == static_cast<uint8_t>(OpCode::CB)) ? 0x100u | peek(address + 1) : opcode;
+    }
+#endif
+
+#ifdef BIGBOY_INSTRUMENTED
+    // Feeds the tracer and stats counter
+    uint8_t instrumentedStep();
+
+    // The ROM bank `pc` is in, or 0 outside 4000-7FFF
+    uint16_t bankOf(uint16_t pc) const;
+
+    // The byte at `address`, as the CPU would fetch it
+    uint8_t peek(uint16_t address) {
+        if (static_cast<uint16_t>(address - m_fetchStart) >= m_fetchSize && !mapFetchWindow(address)) {
+            return m_mmu.readByte(address);
+        }
+        return m_fetchWindow[address - m_fetchStart];
+    }
+#endif
+
+    using Handler = uint8_t (*)(CPU&);
+
+    // Executes the (prefix) opcode `opcode`. Its operands are decoded from the
+    // opcode's bit pattern (see OpCode.h and PrefixOpCode.h) at compile time.
+    template <uint8_t opcode>
+    static uint8_t execute(CPU& cpu);
+    template <uint8_t opcode>
+    static uint8_t executePrefix(CPU& cpu);
+
+    static uint8_t executeUnknown(CPU& cpu);
+
+    template <size_t... opcodes>
+    static constexpr std::array<Handler, 256> makeHandlers(std::index_sequence<opcodes...>);
+    template <size_t... opcodes>
+    static constexpr std::array<Handler, 256> makePrefixHandlers(std::index_sequence<opcodes...>);
+
+    static const std::array<Handler, 256> s_handlers;
+    static const std::array<Handler, 256> s_prefixHandlers;
+
+    uint8_t stepBlock();
+    const MicroOp* enterBlock();
+    Block decodeBlock(uint16_t pc);
+
+    // Runs whole iterations of a memory copy or fill loop in one go, as many
+    // as fit before the batch's deadline, then its first instruction as usual
+    static uint8_t executeMemoryLoop(CPU& cpu);
+
     uint8_t nextByte();
     uint16_t nextWord();
 
-    std::string disassembleCurrent();
-
-    void serviceInterrupt(Interrupt interrupt);
+    // Memory accesses made by instructions, timed according to CPUTiming
+    uint8_t readBus(uint16_t address);
+    void writeBus(uint16_t address, uint8_t value);
 
-    bool isInterruptServicable(Interrupt interrupt) const;
-    bool isInterruptEnabled(Interrupt interrupt) const;
-    bool isInterruptRequested(Interrupt interrupt) const;
+    // Points the fetch window at the memory around `address`; false if it is
+    // not somewhere the window can map
+    bool mapFetchWindow(uint16_t address);
 
-    void enableInterrupt(Interrupt interrupt);
-    void disableInterrupt(Interrupt interrupt);
+    // Exits on an instruction that cannot be executed
+    [[noreturn]] void fatal(const char* what, uint8_t opcode);
 
-    void unrequestInterrupt(Interrupt interrupt);
+    void serviceInterrupt(Interrupt interrupt);
 
+    // Instruction handlers. Operands encoded in the opcode itself (registers,
+    // bits, conditions, reset vectors) are template parameters, so that each
+    // encoding gets its own copy with the operand selection folded away.
     void load(uint8_t& target, uint8_t value);
 
-    uint8_t LD_r_r(RegisterOperand target, RegisterOperand value);
-    uint8_t LD_r_n(RegisterOperand target);
-    uint8_t LD_r_HL(RegisterOperand target);
+    template <RegisterOperand target, RegisterOperand value>
+    uint8_t LD_r_r();
+    template <RegisterOperand target>
+    uint8_t LD_r_n();
+    template <RegisterOperand target>
+    uint8_t LD_r_HL();
 
-    uint8_t LD_HL_r(RegisterOperand value);
+    template <RegisterOperand value>
+    uint8_t LD_HL_r();
     uint8_t LD_HL_n();
 
     uint8_t LD_A_BC();
@@ -98,74 +392,87 @@ private:
 
     void load(uint16_t& target, uint16_t value);
 
-    uint8_t LD_dd_nn(RegisterPairOperand target);
+    template <RegisterPairOperand target>
+    uint8_t LD_dd_nn();
     uint8_t LD_nn_SP();
     uint8_t LD_SP_HL();
 
     void push(uint16_t value);
 
-    uint8_t PUSH_qq(RegisterPairStackOperand value);
+    template <RegisterPairStackOperand value>
+    uint8_t PUSH_qq();
 
     void pop(uint16_t& target);
 
-    uint8_t POP_qq(RegisterPairStackOperand target);
+    template <RegisterPairStackOperand target>
+    uint8_t POP_qq();
 
     void add(uint8_t value);
 
-    uint8_t ADDA_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t ADDA_r();
     uint8_t ADDA_n();
     uint8_t ADDA_HL();
 
     void addWithCarry(uint8_t value);
 
-    uint8_t ADCA_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t ADCA_r();
     uint8_t ADCA_n();
     uint8_t ADCA_HL();
 
     void subtract(uint8_t value);
 
-    uint8_t SUB_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SUB_r();
     uint8_t SUB_n();
     uint8_t SUB_HL();
 
     void subtractWithCarry(uint8_t value);
 
-    uint8_t SBCA_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SBCA_r();
     uint8_t SBCA_n();
     uint8_t SBCA_HL();
 
     void bitwiseAnd(uint8_t value);
 
-    uint8_t AND_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t AND_r();
     uint8_t AND_n();
     uint8_t AND_HL();
 
     void bitwiseXor(uint8_t value);
 
-    uint8_t XOR_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t XOR_r();
     uint8_t XOR_n();
     uint8_t XOR_HL();
 
     void bitwiseOr(uint8_t value);
 
-    uint8_t OR_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t OR_r();
     uint8_t OR_n();
     uint8_t OR_HL();
 
     void compare(uint8_t value);
 
-    uint8_t CP_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t CP_r();
     uint8_t CP_n();
     uint8_t CP_HL();
 
     void increment(uint8_t &target);
 
-    uint8_t INC_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t INC_r();
     uint8_t INC_HL();
 
     void decrement(uint8_t &target);
 
-    uint8_t DEC_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t DEC_r();
     uint8_t DEC_HL_();
 
     uint8_t DAA();
@@ -173,15 +480,18 @@ private:
 
     void add(uint16_t& target, uint16_t value);
 
-    uint8_t ADD_HL_rr(RegisterPairOperand value);
+    template <RegisterPairOperand value>
+    uint8_t ADD_HL_rr();
 
     void increment(uint16_t& target);
 
-    uint8_t INC_rr(RegisterPairOperand target);
+    template <RegisterPairOperand target>
+    uint8_t INC_rr();
 
     void decrement(uint16_t& target);
 
-    uint8_t DEC_rr(RegisterPairOperand target);
+    template <RegisterPairOperand target>
+    uint8_t DEC_rr();
 
     void add(uint16_t& target, int8_t value);
 
@@ -191,61 +501,75 @@ private:
     void rotateLeft(uint8_t &target);
 
     uint8_t RLCA();
-    uint8_t RLC_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t RLC_r();
     uint8_t RLC_HL();
 
     void rotateLeftThroughCarry(uint8_t &target);
 
     uint8_t RLA();
-    uint8_t RL_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t RL_r();
     uint8_t RL_HL();
 
     void rotateRight(uint8_t &target);
 
     uint8_t RRCA();
-    uint8_t RRC_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t RRC_r();
     uint8_t RRC_HL();
 
     void rotateRightThroughCarry(uint8_t &target);
 
     uint8_t RRA();
-    uint8_t RR_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t RR_r();
     uint8_t RR_HL();
 
     void shiftLeft(uint8_t &target);
 
-    uint8_t SLA_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SLA_r();
     uint8_t SLA_HL();
 
     void swap(uint8_t& target);
 
-    uint8_t SWAP_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SWAP_r();
     uint8_t SWAP_HL();
 
     void shiftTailRight(uint8_t &target);
 
-    uint8_t SRA_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SRA_r();
     uint8_t SRA_HL();
 
     void shiftRight(uint8_t &target);
 
-    uint8_t SRL_r(RegisterOperand target);
+    template <RegisterOperand target>
+    uint8_t SRL_r();
     uint8_t SRL_HL();
 
     void testBit(BitOperand bit, uint8_t byte);
 
-    uint8_t BIT_b_r(BitOperand bit, RegisterOperand reg);
-    uint8_t BIT_b_HL(BitOperand bit);
+    template <BitOperand bit, RegisterOperand reg>
+    uint8_t BIT_b_r();
+    template <BitOperand bit>
+    uint8_t BIT_b_HL();
 
     void setBit(BitOperand bit, uint8_t& target);
 
-    uint8_t SET_b_r(BitOperand bit, RegisterOperand reg);
-    uint8_t SET_b_HL(BitOperand bit);
+    template <BitOperand bit, RegisterOperand reg>
+    uint8_t SET_b_r();
+    template <BitOperand bit>
+    uint8_t SET_b_HL();
 
     void resetBit(BitOperand bit, uint8_t& target);
 
-    uint8_t RES_b_r(BitOperand bit, RegisterOperand reg);
-    uint8_t RES_b_HL(BitOperand bit);
+    template <BitOperand bit, RegisterOperand reg>
+    uint8_t RES_b_r();
+    template <BitOperand bit>
+    uint8_t RES_b_HL();
 
     uint8_t CCF();
     uint8_t SCF();
@@ -262,25 +586,30 @@ private:
 
     uint8_t JP_nn();
     uint8_t JP_HL();
-    uint8_t JP_f_nn(ConditionOperand condition);
+    template <ConditionOperand condition>
+    uint8_t JP_f_nn();
 
     void relativeJump(int8_t offset);
 
     uint8_t JR_PCdd();
-    uint8_t JR_f_PCdd(ConditionOperand condition);
+    template <ConditionOperand condition>
+    uint8_t JR_f_PCdd();
 
     void call(uint16_t address);
 
     uint8_t CALL_nn();
-    uint8_t CALL_f_nn(ConditionOperand condition);
+    template <ConditionOperand condition>
+    uint8_t CALL_f_nn();
 
     void ret();
 
     uint8_t RET();
-    uint8_t RET_f(ConditionOperand condition);
+    template <ConditionOperand condition>
+    uint8_t RET_f();
     uint8_t RETI();
 
-    uint8_t RST(ResetOperand address);
+    template <ResetOperand address>
+    uint8_t RST();
 
     MMU& m_mmu;
 
@@ -299,6 +628,71 @@ private:
 
     // Interrupt master enable flag. EI/DI will set/reset this.
     bool m_ime;
+
+    InterruptController m_interrupts;
+
+    DispatchMode m_dispatchMode = DispatchMode::SWITCH;
+
+    BlockCache m_blockCache;
+    const Cartridge* m_cartridge = nullptr;
+
+    // While executing a decoded instruction, its immediate operands are
+    // fetched from here rather than from memory
+    const uint8_t* m_operands = nullptr;
+    std::array<uint8_t, 2> m_operandBuffer{};
+
+    // Host memory backing the region (ROM bank, work RAM bank or high RAM)
+    // that the program counter is in, so that instructions can be fetched
+    // without going through the MMU. Covers m_fetchSize bytes starting at
+    // m_fetchStart; empty until first mapped, and whenever the MBC might
+    // have switched banks.
+    const uint8_t* m_fetchWindow = nullptr;
+    uint16_t m_fetchStart = 0;
+    uint16_t m_fetchSize = 0;
+
+
+#ifdef BIGBOY_JIT
+    std::unique_ptr<JIT> m_jit;
+#endif
+
+#ifdef BIGBOY_AOT
+    std::unique_ptr<AOT> m_aot;
+#endif
+
+#ifdef BIGBOY_PROFILER
+    std::unique_ptr<Profiler> m_profiler;
+
+    // Set whenever the MBC may have switched ROM banks, until the profiler
+    // has been told
+    bool m_romBankChanged = true;
+#endif
+#ifdef BIGBOY_TRACE
+    std::unique_ptr<Tracer> m_tracer;
+#endif
+#ifdef BIGBOY_STATS
+    std::unique_ptr<ExecutionStats> m_stats;
+#endif
+
+    // See runUntil()
+    SyncCallback m_sync = nullptr;
+    void* m_syncContext = nullptr;
+    IdleLoopDetector* m_idleLoops = nullptr;
+    bool m_inBatch = false;
+    bool m_endBatch = false;
+    uint32_t m_deadline = 0;
+    uint32_t m_batchCycles = 0;
+    uint32_t m_syncedCycles = 0;
+    uint8_t m_idleIteration = 0;
+
+    void syncDevices();
+
+    // See MCycleTiming. The cycle into the current instruction at which the
+    // next M-cycle starts, and the cycles of it the devices have been given
+    // outside a batch. Interrupts are dispatched between instructions, so
+    // their accesses are not timed.
+    uint8_t m_busCycle = 0;
+    uint8_t m_stepSynced = 0;
+    bool m_busTimed = false;
 };
 
 #endif //BIGBOY_CPU_H
@@ -14,13 +14,32 @@ public:
     virtual ~Cartridge() = default;
 
     std::vector<AddressSpace> addressSpaces() const override;
+    void attach(MMU& mmu) override;
 
     bool loadRamFileIfSupported(const std::string& path);
     bool saveRamFileIfSupported(const std::string& path) const;
 
     const std::string& getGameTitle() const;
 
+    // The ROM bank currently switched into 4000-7FFF
+    virtual uint16_t romBank() const = 0;
+
+    // The 16KB of ROM making up bank `bank`, or nullptr if there is no such bank
+    const uint8_t* romBankData(uint16_t bank) const;
+
 protected:
+    // Maps the ROM and RAM banks switched in into the MMU; called whenever
+    // the MBC's registers are written to
+    void mapBanks();
+
+    // The RAM bank switched into A000-BFFF, if it can be read (written) as
+    // plain memory right now, or nullptr
+    virtual uint8_t* readableRam() { return nullptr; }
+    virtual uint8_t* writableRam() { return nullptr; }
+
+    // The 8KB of RAM making up bank `bank`, or nullptr if there is no such bank
+    uint8_t* ramBankData(uint8_t bank);
+
     // 0000-3FFF: 16KB ROM Bank 00 (in cartridge, fixed at bank 00)
     // 4000-7FFF: 16KB ROM Bank 01..NN (in cartridge, switchable bank number)
     std::vector<uint8_t> m_rom;
@@ -30,6 +49,9 @@ protected:
 
     // 0100-014F: Cartridge Header
     CartridgeHeader m_header;
+
+    // The MMU the banks are mapped into, once attached
+    MMU* m_mmu = nullptr;
 };
 
 class NoMBC : public Cartridge {
@@ -38,6 +60,12 @@ public:
 
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
+
+    uint16_t romBank() const override;
+
+protected:
+    uint8_t* readableRam() override;
+    uint8_t* writableRam() override;
 };
 
 class MBC1 : public Cartridge {
@@ -47,6 +75,12 @@ public:
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
 
+    uint16_t romBank() const override;
+
+protected:
+    uint8_t* readableRam() override;
+    uint8_t* writableRam() override;
+
 private:
     // 0000-1FFF: RAM Enable (write only; lower 4 bits)
     //  - 00: Disable RAM (default)
@@ -77,6 +111,12 @@ public:
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
 
+    uint16_t romBank() const override;
+
+protected:
+    uint8_t* readableRam() override;
+    uint8_t* writableRam() override;
+
 private:
     // 0000-1FFF: RAM and Timer Enable (write only; lower 4 bits)
     //  - 00: Disable RAM and Timer (default)
@@ -135,6 +175,12 @@ public:
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
 
+    uint16_t romBank() const override;
+
+protected:
+    uint8_t* readableRam() override;
+    uint8_t* writableRam() override;
+
 private:
     // 0000-1FFF: RAM Enable (write only; lower 4 bits)
     //  - 00: Disable RAM (default)
@@ -0,0 +1,86 @@
+#ifndef BIGBOY_DIAGNOSTICS_H
+#define BIGBOY_DIAGNOSTICS_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// Accesses the hardware shrugs off, but that usually point to a bug in the
+// game or in Bigboy
+enum class Diagnostic : uint8_t {
+    // No device is registered at the address
+    UNMAPPED_READ,
+    UNMAPPED_WRITE,
+    // The device at the address does nothing with it
+    UNSUPPORTED_READ,
+    UNSUPPORTED_WRITE,
+    // VRAM accessed while the GPU is drawing from it (mode 3)
+    LOCKED_VRAM_READ,
+    LOCKED_VRAM_WRITE,
+};
+
+// Counts diagnostics by kind and address, for every emulator in the process.
+// Some games make the same bad access thousands of times a frame, so
+// reporting one costs no more than bumping its count: a warning is only
+// written for the first of a kind at an address, and then for every
+// printInterval()-th after that. The counts can be read back at any time,
+// and are summed up by writeSummary() (Bigboy's frontend does so on exit).
+//
+// Not thread-safe; emulators running on other threads will race on the
+// counts, which are only ever approximate then.
+class Diagnostics {
+public:
+    static constexpr size_t KIND_COUNT = 6;
+    static constexpr uint32_t DEFAULT_PRINT_INTERVAL = 1024;
+
+    static Diagnostics& get() { return s_instance; }
+
+    Diagnostics(const Diagnostics&) = delete;
+    Diagnostics& operator=(const Diagnostics&) = delete;
+
+    // Counts one `diagnostic` at `address`. `source` is the device that
+    // noticed it, for the warning.
+    void report(Diagnostic diagnostic, uint16_t address, const char* source) {
+        const uint32_t count = ++m_counts[static_cast<size_t>(diagnostic)][address];
+        if (((count - 1) & m_printMask) == 0 && m_printing) {
+            warn(diagnostic, address, source, count);
+        }
+    }
+
+    uint32_t count(Diagnostic diagnostic, uint16_t address) const {
+        return m_counts[static_cast<size_t>(diagnostic)][address];
+    }
+
+    // Of a kind, at every address
+    uint64_t total(Diagnostic diagnostic) const;
+
+    // Of every kind
+    uint64_t total() const;
+
+    // A warning is written every `interval` diagnostics of a kind at an
+    // address, starting with the first. Rounded up to a power of two; 0 stops
+    // the warnings altogether.
+    void setPrintInterval(uint32_t interval);
+    uint32_t printInterval() const { return m_printing ? m_printMask + 1 : 0; }
+
+    void reset();
+
+    // Every kind with any counted, and the addresses seen most often. Writes
+    // nothing if there are none.
+    void writeSummary(std::ostream& out) const;
+
+    static const char* nameOf(Diagnostic diagnostic);
+
+private:
+    Diagnostics() = default;
+
+    void warn(Diagnostic diagnostic, uint16_t address, const char* source, uint32_t count) const;
+
+    static Diagnostics s_instance;
+
+    std::array<std::array<uint32_t, 0x10000>, KIND_COUNT> m_counts{};
+    uint32_t m_printMask = DEFAULT_PRINT_INTERVAL - 1;
+    bool m_printing = true;
+};
+
+#endif //BIGBOY_DIAGNOSTICS_H
@@ -4,6 +4,7 @@
 #include <bigboy/Cartridge.h>
 #include <bigboy/CPU.h>
 #include <bigboy/GPU.h>
+#include <bigboy/IdleLoopDetector.h>
 #include <bigboy/Joypad.h>
 #include <bigboy/Serial.h>
 #include <bigboy/Timer.h>
@@ -16,6 +17,48 @@ public:
     const std::array<Colour, 160*144>& update();
     void handleInput(InputEvent event);
 
+    void setDispatchMode(DispatchMode mode);
+
+    // Skip ahead through loops that poll for a device event (see
+    // IdleLoopDetector.h); on by default. The result is the same either way.
+    void setIdleLoopSkipping(bool enabled);
+
+#ifdef BIGBOY_JIT
+    // See CPU::setJITEnabled()
+    bool setJITEnabled(bool enabled);
+#endif
+
+#ifdef BIGBOY_AOT
+    // See CPU::loadAotModule(); the ROM has to be loaded first
+    bool loadAotModule(const std::string& path);
+#endif
+
+#ifdef BIGBOY_PROFILER
+    // Profile the guest code (see Profiler.h). Off by default.
+    void setProfilingEnabled(bool enabled);
+
+    // Writes the report to `path` and the folded stacks to `path`.folded.
+    // False if profiling is off or either file could not be written.
+    bool writeProfile(const std::string& path);
+#endif
+
+#ifdef BIGBOY_STATS
+    // Count what the CPU executes (see ExecutionStats.h). Off by default.
+    void setStatsEnabled(bool enabled);
+
+    // nullptr while stats are off
+    const ExecutionStats* stats() const;
+
+    // Starts counting from zero again, e.g. after every frame
+    void resetStats();
+#endif
+
+#ifdef BIGBOY_TRACE
+    // See CPU::setTraceCapacity()
+    void setTraceCapacity(size_t capacity);
+    Tracer* tracer() { return m_cpu.tracer(); }
+#endif
+
     bool loadRomFile(const std::string& path);
     bool loadRamFileIfSupported(const std::string& path);
     bool saveRamFileIfSupported(const std::string& path);
@@ -23,11 +66,43 @@ public:
     std::string getGameTitle() const;
 
 private:
+    friend class Lockstep;
+
     void step();
 
+    // The cycles the CPU can run before a device does something it could
+    // notice
+    uint32_t cyclesUntilEvent() const;
+
+    // Run the CPU up to the next device event (see CPU::runUntil())
+    void runBatch();
+
+    // Bring the devices up to date with an instruction that took `cycles`
+    // cycles, and service any interrupts they requested.
+    void tick(uint32_t cycles);
+
+    // Bring the devices up to date, and request the interrupts they raise
+    void updateDevices(uint32_t cycles);
+    static void syncDevices(void* context, uint32_t cycles);
+
+    // If the CPU is halted, or idling in a polling loop, run it up to the next
+    // device event in one go
+    void skipIdle(uint8_t cycles);
+
+    // Advance the devices by as many whole periods of `period` cycles as
+    // complete before the next event that could change what the CPU sees
+    void fastForward(uint32_t period, bool untilDividerIncrement);
+
+#ifdef BIGBOY_THREADED_INTERPRETER
+    static bool afterStep(void* context, uint8_t cycles);
+#endif
+
     CPU m_cpu{m_mmu};
     uint32_t m_clock = 0;
 
+    IdleLoopDetector m_idleLoops{m_cpu};
+    bool m_skipIdleLoops = true;
+
     MMU m_mmu{};
     GPU m_gpu{m_mmu};
     Joypad m_joypad{};
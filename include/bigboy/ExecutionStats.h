@@ -0,0 +1,46 @@
+#ifndef BIGBOY_EXECUTIONSTATS_H
+#define BIGBOY_EXECUTIONSTATS_H
+
+#include <array>
+#include <cstdint>
+
+// Counters for what the CPU has been doing, kept up to date by CPU::step()
+// while enabled (see Emulator::setStatsEnabled()), for comparing workloads
+// and checking that the fast paths kick in. Everything the CPU runs in one
+// step counts as a single instruction, as with the profiler: a block run by
+// the JIT or an AOT module, or the first iteration of a copy loop the block
+// cache runs in bulk (the rest are counted in bulkIterations).
+//
+// The counters sit in one block, with the opcode histogram after the totals,
+// so that a step touches the first cache line and one histogram entry.
+struct alignas(64) ExecutionStats {
+    // Steps that executed an instruction, and the cycles they took
+    uint64_t instructions = 0;
+    uint64_t instructionCycles = 0;
+
+    // Cycles spent halted, whether stepped through or skipped
+    uint64_t haltedCycles = 0;
+
+    // Steps taken while stopped, which take no time at all
+    uint64_t stoppedSteps = 0;
+
+    // Idle loops skipped ahead through (see IdleLoopDetector.h), and the
+    // cycles skipped
+    uint64_t idleSkips = 0;
+    uint64_t idleSkippedCycles = 0;
+
+    // Copy and fill loop iterations the block cache ran in bulk
+    uint64_t bulkIterations = 0;
+
+    // Instructions by opcode; CB-prefixed opcodes from 256
+    std::array<uint64_t, 512> opcodes{};
+
+    // Every cycle, however it was spent
+    uint64_t cycles() const { return instructionCycles + haltedCycles + idleSkippedCycles; }
+
+    uint64_t opcodeCount(uint8_t opcode, bool prefixed = false) const {
+        return opcodes[(prefixed ? 256 : 0) + opcode];
+    }
+};
+
+#endif //BIGBOY_EXECUTIONSTATS_H
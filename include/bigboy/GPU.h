@@ -51,7 +51,11 @@ public:
     GPU(const MMU& mmu) : m_mmu{mmu} {}
 
     // Returns true if the GPU has finished rendering a frame, false otherwise
-    Request update(uint8_t cycles);
+    Request update(uint32_t cycles);
+
+    // How many more cycles until the GPU next changes mode (or, during VBLANK,
+    // moves on to the next line). UINT32_MAX while the display is disabled.
+    uint32_t cyclesUntilTransition() const;
 
     // Get the current framebuffer
     const std::array<Colour, 160*144>& getCurrentFrame() const;
@@ -61,10 +65,19 @@ public:
     std::vector<AddressSpace> addressSpaces() const override;
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
+    void attach(MMU& mmu) override;
 
 private:
+    // I/O register writes with side effects
+    void writeControl(uint8_t value);
+    void writeStatus(uint8_t value);
+    void writeCurrentY(uint8_t value);
     void launchDMATransfer(uint8_t location);
 
+    // Move on to the next mode (or line) if enough cycles have passed for the
+    // current one. Returns true if it did.
+    bool advanceMode(Request& request);
+
     // Render one scanline into the framebuffer
     void renderScanline();
     void renderBackgroundScanline();
@@ -77,6 +90,10 @@ private:
     // Returns true if a STAT interrupt is to be requested
     bool switchMode(GPUMode newMode);
 
+    // VRAM is mapped into the MMU except in mode 3 (SCANLINE_VRAM), when
+    // the CPU cannot access it
+    void mapVram();
+
     bool statInterruptEnabled(StatInterrupt interrupt) const
             { return (m_status >> static_cast<uint8_t>(interrupt)) & 1u; }
 
@@ -125,6 +142,9 @@ private:
 
     std::array<Colour, 160*144> m_frameBuffer{Colour{0, 0, 0, 255}};
 
+    // The MMU VRAM is mapped into, once attached
+    MMU* m_attachedMmu = nullptr;
+
     // Keep track of how long it has taken us to do this work
     // Once we have had enough time to (supposedly) get it done,
     // we switch to the next mode.
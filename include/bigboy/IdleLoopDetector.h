@@ -0,0 +1,107 @@
+#ifndef BIGBOY_IDLELOOPDETECTOR_H
+#define BIGBOY_IDLELOOPDETECTOR_H
+
+#include <array>
+#include <cstdint>
+
+#include <bigboy/Registers.h>
+
+class CPU;
+
+// Spots the CPU spinning in a loop that is waiting for a device to do
+// something, e.g. `LDH A,(44h); CP 90h; JR NZ` or polling IF for VBLANK, so
+// that the emulator can skip ahead to the next device event rather than
+// step through iterations that cannot behave any differently.
+//
+// A loop qualifies if it is a straight run of instructions ending in a jump
+// back to its start that writes no memory, and everything it reads is one of
+// LY, STAT, IF, DIV or IE, or ROM, work RAM or high RAM. None of those change
+// until a device next does something: the registers change only at device
+// events, and memory only when an interrupt handler writes it. So once an
+// iteration leaves the CPU registers and everything the loop reads exactly as
+// it found them, so will every iteration up until the next event.
+class IdleLoopDetector {
+public:
+    explicit IdleLoopDetector(const CPU& cpu);
+
+    // Call after every instruction with the cycles it took, once the devices
+    // have been brought up to date (or, within CPU::runUntil(), with reads of
+    // I/O registers bringing them up to date). Returns the cycles one
+    // iteration of the loop takes if the CPU is at the start of an idle loop,
+    // otherwise 0.
+    uint8_t update(uint8_t cycles);
+
+    // Does the idle loop read DIV? If so, its increments are events too.
+    bool pollsDivider() const { return m_pollsDivider; }
+
+    void reset();
+
+    // The furthest back a jump may go to be considered a loop
+    static constexpr uint16_t MAX_LOOP_BYTES = 64;
+
+private:
+    // How a loop addresses a memory read
+    enum class ReadMode : uint8_t {
+        ABSOLUTE,
+        BC,
+        DE,
+        HL,
+        FF00_C
+    };
+
+    struct Read {
+        ReadMode mode;
+        uint16_t address;
+    };
+
+    static constexpr uint8_t MAX_LOOP_INSTRUCTIONS = 16;
+    static constexpr uint8_t MAX_READS = MAX_LOOP_INSTRUCTIONS;
+
+    struct Loop {
+        uint32_t key = INVALID_KEY;
+        bool idle = false;
+
+        // Cycles per iteration
+        uint8_t cycles = 0;
+
+        std::array<Read, MAX_READS> reads{};
+        uint8_t readCount = 0;
+    };
+
+    // The observable state at the start of an iteration
+    struct Snapshot {
+        Registers registers;
+        std::array<uint8_t, MAX_READS> values{};
+    };
+
+    // Decodes the loop starting at `head`
+    Loop analyse(uint16_t head) const;
+
+    // Reads everything the current loop reads; false if any of it might change
+    // without a device event
+    bool takeSnapshot(Snapshot& snapshot);
+
+    static bool isPollable(uint16_t address);
+    static bool sameRegisters(const Registers& a, const Registers& b);
+
+    static uint32_t makeKey(uint16_t bank, uint16_t pc) { return (static_cast<uint32_t>(bank) << 16u) | pc; }
+
+    static constexpr uint32_t INVALID_KEY = 0xFFFFFFFF;
+
+    const CPU& m_cpu;
+
+    // Loops in ROM are decoded once, and kept here
+    std::array<Loop, 64> m_romLoops{};
+
+    // The loop being watched, its state at the start of the last iteration,
+    // and the cycles taken since then
+    Loop m_loop;
+    Snapshot m_snapshot{};
+    bool m_snapshotValid = false;
+    uint32_t m_cycles = 0;
+    bool m_pollsDivider = false;
+
+    uint16_t m_lastPc = 0;
+};
+
+#endif //BIGBOY_IDLELOOPDETECTOR_H
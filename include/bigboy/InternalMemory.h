@@ -6,15 +6,39 @@
 
 #include <bigboy/MemoryDevice.h>
 
+class BlockCache;
+
 class InternalMemory : public MemoryDevice {
 public:
     std::vector<AddressSpace> addressSpaces() const override;
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
+    void attach(MMU& mmu) override;
 
     void reset();
 
+    // The host memory backing work RAM bank 0 (C000-CFFF) or 1 (D000-DFFF),
+    // and high RAM (FF80-FFFE), for code that accesses it directly
+    uint8_t* workRam(uint8_t bank) { return bank == 0 ? m_wram0.data() : m_wram1.data(); }
+    uint8_t* highRam() { return m_hram.data(); }
+
+    // Bytes of work RAM (or its echo) and high RAM that hold code decoded by
+    // the block cache, which is told whenever one of them is written to
+    void setBlockCache(BlockCache* blockCache) { m_blockCache = blockCache; }
+    void watchCode(uint16_t start, uint16_t end);
+    void unwatchCode(uint16_t start, uint16_t end);
+
 private:
+    // Index of `address` in m_codeBits, or -1 if it is not work RAM or high RAM
+    static int32_t codeIndex(uint16_t address);
+
+    bool isCode(uint16_t index) const { return (m_codeBits[index >> 6u] >> (index & 63u)) & 1u; }
+    void onCodeWrite(uint16_t index);
+
+    // Maps the work RAM pages holding indices `start` to `end` into the MMU,
+    // and their echoes; writes to pages holding code are left to writeByte()
+    void mapWorkRam(uint16_t start, uint16_t end);
+
     // 2x4KB work RAM banks: C000-CFFF and D000-DFFF
     // Also addressable through E000-FDFF
     std::array<uint8_t, 0xFFF + 1> m_wram0{0};
@@ -23,11 +47,15 @@ private:
     // High RAM (HRAM): FF80-FFFE
     std::array<uint8_t, 0x7F + 1> m_hram{0};
 
-    // Interrupt enable register: FFFF
-    uint8_t m_ie = 0;
+    // IE (FFFF) and IF (FF0F) are in the CPU's InterruptController
+
+    // One bit per byte of work RAM (indices 0000-1FFF) and high RAM (2000-207E)
+    // saying whether it holds decoded code
+    static constexpr uint16_t HRAM_INDEX = 0x2000;
+    std::array<uint64_t, (HRAM_INDEX + 0x80) / 64> m_codeBits{};
+    BlockCache* m_blockCache = nullptr;
 
-    // Interrupt flag (request) register: FF0F
-    uint8_t m_if = 0;
+    MMU* m_mmu = nullptr;
 };
 
 #endif //BIGBOY_INTERNALMEMORY_H
@@ -0,0 +1,56 @@
+#ifndef BIGBOY_INTERRUPTCONTROLLER_H
+#define BIGBOY_INTERRUPTCONTROLLER_H
+
+#include <bigboy/MemoryDevice.h>
+
+enum class Interrupt : uint8_t {
+    VBLANK = 0,
+    LCD_STAT = 1,
+    TIMER = 2,
+    SERIAL = 3,
+    JOYPAD = 4
+};
+
+constexpr uint8_t INTERRUPT_COUNT = 5;
+
+// The interrupt enable (IE) and interrupt flag (IF) registers. Owned by the
+// CPU, which checks for pending interrupts after every instruction, so it
+// keeps IE & IF up to date whenever either register changes, whether that is
+// through the MMU or not.
+class InterruptController : public MemoryDevice {
+public:
+    std::vector<AddressSpace> addressSpaces() const override;
+    uint8_t readByte(uint16_t address) const override;
+    void writeByte(uint16_t address, uint8_t value) override;
+    void attach(MMU& mmu) override;
+
+    void reset();
+
+    void request(Interrupt interrupt)     { m_if |= maskOf(interrupt); updatePending(); }
+    void acknowledge(Interrupt interrupt) { m_if &= ~maskOf(interrupt); updatePending(); }
+
+    // The interrupts that are both enabled and requested, one bit each (IE & IF)
+    uint8_t pending() const { return m_pending; }
+
+    // The highest priority pending interrupt. There must be one.
+    Interrupt next() const;
+
+private:
+    static uint8_t maskOf(Interrupt interrupt) { return 1u << static_cast<uint8_t>(interrupt); }
+
+    void updatePending() { m_pending = m_ie & m_if & ALL_INTERRUPTS; }
+
+    void writeFlags(uint8_t value) { m_if = value; updatePending(); }
+
+    static constexpr uint8_t ALL_INTERRUPTS = (1u << INTERRUPT_COUNT) - 1;
+
+    // Interrupt enable register: FFFF
+    uint8_t m_ie = 0;
+
+    // Interrupt flag (request) register: FF0F
+    uint8_t m_if = 0;
+
+    uint8_t m_pending = 0;
+};
+
+#endif //BIGBOY_INTERRUPTCONTROLLER_H
@@ -0,0 +1,144 @@
+#ifndef BIGBOY_JIT_H
+#define BIGBOY_JIT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class CPU;
+class MMU;
+class Registers;
+
+// Translates hot blocks of guest code into x86-64 machine code.
+//
+// A block is a straight-line run of instructions starting at some (bank, pc)
+// and ending at the first jump, or just before the first instruction the JIT
+// does not translate. Blocks are compiled once they have been entered
+// HOT_THRESHOLD times; until then, and for anything that cannot be compiled,
+// the interpreter carries on as usual.
+//
+// Within a compiled block the guest registers live in host registers, and
+// memory accesses to ROM and work RAM go straight to host memory. Anything
+// else (I/O registers, VRAM, cartridge RAM, MBC registers) goes through the
+// MMU when it is the first instruction of the block, and otherwise ends the
+// block just before the access, so that the interpreter performs it after
+// the devices have caught up. Writes through the MMU also end the block, as
+// they may request an interrupt, switch banks or overwrite compiled code. The cycles of the whole block are charged in
+// one go when it returns.
+//
+// Blocks in ROM at 4000-7FFF are keyed by the bank switched in; blocks in
+// work RAM are dropped when the RAM they were compiled from is written to.
+class JIT {
+public:
+    explicit JIT(CPU& cpu);
+    ~JIT();
+
+    JIT(const JIT&) = delete;
+    JIT& operator=(const JIT&) = delete;
+
+    // False if no executable memory could be allocated, in which case the
+    // JIT never runs anything
+    bool available() const { return m_code != nullptr; }
+
+    // Runs the compiled block at the CPU's program counter, compiling it first
+    // if it has become hot. Returns the number of cycles it took, or 0 if there
+    // is no compiled block and the interpreter should execute the next
+    // instruction instead.
+    uint8_t execute();
+
+    // Must be told about every write to memory that goes through the MMU
+    void onWrite(uint16_t address) {
+        if (address >= 0xC000 && address <= 0xFDFF) {
+            // E000-FDFF echoes C000-DDFF
+            const uint8_t page = (address >> 8u) - (address >= 0xE000 ? 0x20 : 0x00);
+            if (m_context.codePages[page]) {
+                invalidatePage(page);
+            }
+        }
+    }
+
+    // Drops every compiled block
+    void clear();
+
+    // Compiled blocks are entered this many times before they are compiled
+    static constexpr uint16_t HOT_THRESHOLD = 16;
+
+    // State shared with the generated code, which addresses it relative to
+    // a pointer held in a host register
+    struct Context {
+        // Host memory backing each 4KB region of the address space, or
+        // nullptr where accesses have to go through the MMU
+        std::array<const uint8_t*, 16> read;
+        std::array<uint8_t*, 16> write;
+
+        // Which 256-byte pages of work RAM hold compiled code
+        std::array<uint8_t, 256> codePages;
+
+        // Maps the host flags (as loaded into AH by LAHF) onto Z, H and C
+        std::array<uint8_t, 256> flags;
+
+        Registers* registers;
+        MMU* mmu;
+        uint8_t* highRam;
+
+        // Caller-saved host registers holding guest registers are saved here
+        // around calls into the MMU
+        std::array<uint64_t, 5> spill;
+
+        // Where execution continues after the block
+        uint16_t pc;
+    };
+
+private:
+    using NativeBlock = uint8_t (*)(Context*);
+
+    struct Entry {
+        uint32_t key = INVALID_KEY;
+        uint16_t hits = 0;
+        bool failed = false;
+        NativeBlock code = nullptr;
+    };
+
+    // Compiles the block starting at `pc`; `end` is set to the address of its
+    // last byte. Returns nullptr if the first instruction cannot be compiled.
+    NativeBlock compile(uint16_t pc, uint16_t& end);
+
+    void invalidatePage(uint8_t page);
+
+    // Has writes to `page`, and its echo, go through the MMU's slow path to
+    // onWrite() while it holds compiled code
+    void watchPage(uint8_t page, bool watched);
+    void mapRomBank();
+
+    static uint32_t makeKey(uint16_t bank, uint16_t pc) { return (static_cast<uint32_t>(bank) << 16u) | pc; }
+    static size_t indexOf(uint32_t key) { return (key ^ (key >> 4u)) & (ENTRY_COUNT - 1); }
+
+    static constexpr uint32_t INVALID_KEY = 0xFFFFFFFF;
+    static constexpr size_t ENTRY_COUNT = 4096;
+    static constexpr size_t CODE_SIZE = 4 * 1024 * 1024;
+
+    CPU& m_cpu;
+
+    Context m_context{};
+
+    // Compiled blocks, direct-mapped by key. Colliding blocks simply replace
+    // each other; their code stays in the buffer until it is next flushed.
+    std::array<Entry, ENTRY_COUNT> m_entries{};
+
+    // The keys of the blocks compiled from each page of work RAM
+    std::array<std::vector<uint32_t>, 256> m_pageKeys{};
+
+    // Executable memory, filled from the start until it runs out, at which
+    // point everything is thrown away and compilation starts over
+    uint8_t* m_code = nullptr;
+    size_t m_codeUsed = 0;
+
+    // The ROM bank currently mapped into m_context.read
+    uint16_t m_mappedBank = 0xFFFF;
+
+    // Writes to RAM must go through the MMU when the block cache is watching them
+    bool m_writeThrough = false;
+};
+
+#endif //BIGBOY_JIT_H
@@ -46,13 +46,19 @@ public:
     bool update();
     void handleInput(InputEvent input);
 
+    // Will the next update() request an interrupt?
+    bool interruptPending() const { return m_requestInterruptOnNextUpdate; }
+
     void reset();
 
     std::vector<AddressSpace> addressSpaces() const;
     uint8_t readByte(uint16_t address) const;
     void writeByte(uint16_t address, uint8_t value);
+    void attach(MMU& mmu);
 
 private:
+    void writeSelect(uint8_t value);
+
     void updateKeystate(InputEvent input);
     void updateRegister();
 
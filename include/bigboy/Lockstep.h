@@ -0,0 +1,103 @@
+#ifndef BIGBOY_LOCKSTEP_H
+#define BIGBOY_LOCKSTEP_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bigboy/Emulator.h>
+
+// How much of the work a Lockstep did in lockstep
+struct LockstepStats {
+    // Instructions executed once for a whole group of lanes, and the lanes
+    // they were executed for between them
+    uint64_t vectorSteps = 0;
+    uint64_t vectorLaneSteps = 0;
+
+    // Instructions a lane executed on its own
+    uint64_t scalarSteps = 0;
+
+    // The share of the lanes the average lockstep instruction ran for
+    double laneUtilization(size_t lanes) const {
+        return vectorSteps > 0 ? static_cast<double>(vectorLaneSteps) / (vectorSteps * lanes) : 0.0;
+    }
+
+    // The share of all instructions that were executed in lockstep
+    double lockstepFraction() const {
+        const uint64_t total = vectorLaneSteps + scalarSteps;
+        return total > 0 ? static_cast<double>(vectorLaneSteps) / total : 0.0;
+    }
+};
+
+// Runs many copies (lanes) of the same ROM, each with its own input, side by
+// side. Lanes that are at the same instruction, and have no device event or
+// interrupt due, are gathered into a group whose registers are held one array
+// per register (LaneRegisters), and straight runs of instructions that touch
+// nothing but registers are executed for the whole group at once, in loops
+// over the lanes that the compiler can vectorise. Anything else (memory
+// accesses, jumps, lanes that have diverged) peels off to the lane's own CPU,
+// one instruction at a time.
+//
+// The lane furthest behind is always run next, so lanes following the same
+// path fall back into step with each other. Every lane ends up exactly where
+// it would have on its own.
+class Lockstep {
+public:
+    explicit Lockstep(size_t lanes);
+
+    // Loads the ROM into every lane
+    bool loadRomFile(const std::string& path);
+
+    size_t laneCount() const { return m_lanes.size(); }
+
+    // For input, settings and so on; anything set must be set before update()
+    Emulator& lane(size_t index) { return *m_lanes[index]; }
+
+    // Runs every lane to the end of its next frame
+    void update();
+
+    const std::array<Colour, 160*144>& frame(size_t lane) const;
+
+    const LockstepStats& stats() const { return m_stats; }
+    void resetStats() { m_stats = LockstepStats{}; }
+
+private:
+    // The registers of a group of lanes, structure-of-arrays
+    struct LaneRegisters {
+        std::vector<uint8_t> a, f, b, c, d, e, h, l;
+        std::vector<uint16_t> sp;
+
+        void resize(size_t lanes);
+        uint8_t* get(RegisterOperand target);
+    };
+
+    // Can `opcode` run on a group? Only instructions that read and write
+    // nothing but registers, and always go on to the next instruction.
+    static bool vectorizable(uint8_t opcode);
+
+    // Runs the instruction at the leader's program counter, for the leader
+    // alone or for every lane in step with it
+    void step(Emulator& leader);
+
+    // Could `lane` join a group at this instruction?
+    static bool canGroup(const Emulator& lane);
+
+    // Runs instructions for m_group until one cannot be, or a device event
+    // in one of the lanes is due
+    void runGroup(uint16_t pc);
+
+    // Executes `opcode` for the first `count` lanes in m_registers, and
+    // returns the cycles it took
+    uint8_t execute(uint8_t opcode, uint16_t operand, size_t count);
+
+    std::vector<std::unique_ptr<Emulator>> m_lanes;
+
+    std::vector<Emulator*> m_group;
+    LaneRegisters m_registers;
+
+    LockstepStats m_stats;
+};
+
+#endif //BIGBOY_LOCKSTEP_H
@@ -1,35 +1,170 @@
 #ifndef BIGBOY_MMU_H
 #define BIGBOY_MMU_H
 
+#include <array>
+#include <memory>
 #include <vector>
 
 #include <bigboy/InternalMemory.h>
 
+class BlockCache;
+class CPU;
+class JIT;
+
+// The address space is split into 256 pages of 256 bytes. A page that is
+// plain memory (work RAM, VRAM outside mode 3, the ROM and RAM banks switched
+// in) points straight at the host memory behind it, which the devices keep
+// up to date through mapMemory(); reading or writing it is a load and an
+// index. Anything else goes to the device that owns the address.
 class MMU {
+    struct Page {
+        // Host memory behind the page, or nullptr where accesses have to go
+        // through the device
+        const uint8_t* read = nullptr;
+        uint8_t* write = nullptr;
+
+        // The device that owns the whole page, or nullptr if it is shared
+        // between devices (see m_splitPages) or not owned at all
+        MemoryDevice* device = nullptr;
+    };
+
+    // How each I/O register (FF00-FF7F) is read and written. Registers that
+    // are just a byte point straight at it; bits set in unusedBits read as 1,
+    // as nothing drives them. Registers nothing handles read as FF.
+    struct IoRegister {
+        uint8_t (*read)(const void* context, uint16_t address);
+        const void* readContext;
+        void (*write)(void* context, uint16_t address, uint8_t value);
+        void* writeContext;
+        uint8_t unusedBits;
+    };
+
     // MMU does own some general system memory that belongs nowhere else:
     InternalMemory m_internal;
 
-    // We have to use pointers rather than reference wrappers for default construction
-    std::vector<MemoryDevice*> m_devices{0xFFFF + 1, nullptr};
+    std::array<Page, 256> m_pages{};
+
+    // The owner of each address in a page that is shared, such as the I/O
+    // registers and high RAM at FF00-FFFF
+    std::array<std::unique_ptr<std::array<MemoryDevice*, 256>>, 256> m_splitPages{};
+
+    // Pages as mapped by their devices, and the ones whose writes have to go
+    // through writeByte()'s slow path anyway (see watchWrites())
+    std::array<uint8_t*, 256> m_mappedWrites{};
+    std::array<bool, 256> m_watchedWrites{};
+
+    std::array<IoRegister, 0x80> m_ioRegisters{};
+
+    // Decoded code which needs to hear about writes, if any. The block cache
+    // only hears about writes to the MBC from here; m_internal tells it about
+    // writes to the RAM it has decoded.
+    BlockCache* m_blockCache = nullptr;
+#ifdef BIGBOY_JIT
+    JIT* m_jit = nullptr;
+#endif
+
+    // The CPU fetches straight from the ROM bank switched in, so it has to be
+    // told about writes to the MBC. It also runs ahead of the other devices,
+    // so it has to be told about accesses to their I/O registers.
+    CPU* m_cpu = nullptr;
 
 public:
     MMU();
     MMU(std::initializer_list<std::reference_wrapper<MemoryDevice>> devices);
     ~MMU() = default;
 
-    uint8_t readByte(uint16_t address) const;
-    void writeByte(uint16_t address, uint8_t value);
+    uint8_t readByte(uint16_t address) const {
+        const Page& page = m_pages[address >> 8u];
+        if (page.read) {
+            return page.read[address & 0xFFu];
+        }
+        return readDevice(address);
+    }
+
+    void writeByte(uint16_t address, uint8_t value) {
+        const Page& page = m_pages[address >> 8u];
+        if (page.write) {
+            page.write[address & 0xFFu] = value;
+            return;
+        }
+        writeDevice(address, value);
+    }
 
     uint16_t readWord(uint16_t address) const;
     void writeWord(uint16_t address, uint16_t value);
 
+    // Read or write `size` bytes from `address` on (wrapping round at the end
+    // of the address space), just as that many readByte()s or writeByte()s
+    // would, for DMA and other bulk transfers. A page that is plain memory is
+    // copied in one go; only the others are gone through a byte at a time.
+    void readBlock(uint16_t address, uint8_t* out, size_t size) const;
+    void writeBlock(uint16_t address, const uint8_t* data, size_t size);
+
     void registerDevice(MemoryDevice& device);
 
+    // Called by a device to have the whole pages from `start` to `end` read
+    // from `read` and written to `write` (which are where `start` is), or to
+    // go through the device where either is nullptr
+    void mapMemory(uint16_t start, uint16_t end, const uint8_t* read, uint8_t* write);
+
+    // While a page is watched, writes to it go through the device even if it
+    // is mapped, so that the JIT hears about them
+    void watchWrites(uint8_t page, bool watched);
+
+    using IoRead = uint8_t (*)(const void* context, uint16_t address);
+    using IoWrite = void (*)(void* context, uint16_t address, uint8_t value);
+
+    // Called by a device to handle the I/O register at `address` itself,
+    // rather than through its readByte() and writeByte()
+    void mapIoRegister(uint16_t address, IoRead read, const void* readContext,
+                       IoWrite write, void* writeContext, uint8_t unusedBits);
+
+    // A register that is just the byte `value`
+    void mapIoRegister(uint16_t address, uint8_t& value, uint8_t unusedBits = 0x00) {
+        mapIoRegister(address, &readValue, &value, &writeValue, &value, unusedBits);
+    }
+
+    // A register that reads as `value` but is written through `write` (a
+    // member function of `device` taking the value written)
+    template <auto write, typename Device>
+    void mapIoRegister(uint16_t address, const uint8_t& value, Device& device, uint8_t unusedBits = 0x00) {
+        mapIoRegister(address, &readValue, &value, &callWrite<write, Device>, &device, unusedBits);
+    }
+
+    // A register that can only be written, through `write`
+    template <auto write, typename Device>
+    void mapIoRegister(uint16_t address, Device& device) {
+        mapIoRegister(address, &readOpenBus, nullptr, &callWrite<write, Device>, &device, 0xFF);
+    }
+
+    void setBlockCache(BlockCache* blockCache);
+    void setCPU(CPU* cpu);
+#ifdef BIGBOY_JIT
+    void setJIT(JIT* jit);
+#endif
+
+    InternalMemory& internalMemory() { return m_internal; }
+
     void reset();
 
 private:
-    MemoryDevice* getDevice(uint16_t address);
-    const MemoryDevice* getDevice(uint16_t address) const;
+    static uint8_t readValue(const void* value, uint16_t) { return *static_cast<const uint8_t*>(value); }
+    static void writeValue(void* value, uint16_t, uint8_t v) { *static_cast<uint8_t*>(value) = v; }
+
+    static uint8_t readOpenBus(const void*, uint16_t) { return 0xFF; }
+    static void writeNothing(void*, uint16_t, uint8_t) {}
+
+    template <auto write, typename Device>
+    static void callWrite(void* device, uint16_t, uint8_t value) { (static_cast<Device*>(device)->*write)(value); }
+
+    // Registers owned by a device that does not handle them itself
+    static uint8_t readMemoryDevice(const void* device, uint16_t address);
+    static void writeMemoryDevice(void* device, uint16_t address, uint8_t value);
+
+    uint8_t readDevice(uint16_t address) const;
+    void writeDevice(uint16_t address, uint8_t value);
+
+    MemoryDevice* getDevice(uint16_t address) const;
 
     void reserveAddressSpace(MemoryDevice& device, AddressSpace addressSpace);
 };
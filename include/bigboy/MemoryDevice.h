@@ -14,6 +14,11 @@ public:
     virtual std::vector<AddressSpace> addressSpaces() const = 0;
     virtual uint8_t readByte(uint16_t address) const = 0;
     virtual void writeByte(uint16_t address, uint8_t value) = 0;
+
+    // Called by the MMU once the device is registered with it. Devices backed
+    // by plain memory map it in here (see MMU::mapMemory()), and again
+    // whenever what is behind their addresses changes.
+    virtual void attach(MMU&) {}
 };
 
 #endif //BIGBOY_MEMORYDEVICE_H
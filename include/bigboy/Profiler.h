@@ -0,0 +1,228 @@
+#ifndef BIGBOY_PROFILER_H
+#define BIGBOY_PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bigboy/InterruptController.h>
+
+// Counts the instructions executed and cycles spent at each guest address,
+// keyed by ROM bank for 4000-7FFF, along with totals for each opcode and each
+// interrupt handler.
+//
+// It also keeps a shadow of the guest's call stack, from the calls, RSTs,
+// returns and interrupts the CPU reports, and charges every cycle to the
+// routine (bank:address) on top of it and the path of calls that led there.
+// Each routine gets exclusive cycles (spent in the routine itself) and
+// inclusive cycles (from being called until returning, callees and all).
+// Games that move SP themselves, or pop a return address to jump somewhere
+// else, are caught by checking the stack against SP after every step: a
+// frame whose return address is no longer on the stack is dropped (and
+// counted as a resync). Everything from an interrupt being serviced until the
+// return that pops its return address counts towards that interrupt.
+//
+// The CPU feeds it every step (see CPU::step()), so anything the CPU runs in
+// one step is counted as a single instruction: a block run by the JIT, or
+// the iterations of a copy loop the block cache runs in bulk. Calls and
+// returns inside a compiled block are not seen, other than through SP. Cycles
+// spent halted are counted against the HALT instruction, as long as the
+// emulator steps through them rather than skipping ahead.
+class Profiler {
+public:
+    Profiler();
+
+    struct Counts {
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+    };
+
+    // Called by the CPU whenever the MBC may have switched banks, with the
+    // ROM bank now at 4000-7FFF (0 without a cartridge)
+    void setRomBank(uint16_t bank);
+
+    // Where the CPU counts a step starting at `pc` in ROM. `readOpcode()`
+    // returns the opcode there (plus 0x100 for CB-prefixed opcodes), and as
+    // ROM doesn't change, is only called the first time the address runs.
+    template <typename ReadOpcode>
+    Counts& romCounts(uint16_t pc, ReadOpcode readOpcode) {
+        Counts& counts = m_regions[pc >> 13u][pc & 0x1FFFu];
+        if (counts.instructions == 0) {
+            m_romOpcodes[pc >> 13u][pc & 0x1FFFu] = readOpcode();
+        }
+        return counts;
+    }
+
+    // Where the CPU counts a step starting at `pc` outside ROM (8000-FFFF),
+    // and the opcode run there, which it reads every time
+    Counts& ramCounts(uint16_t pc) { return m_ram[pc - 0x8000u]; }
+    Counts& opcodeCounts(uint16_t opcode) { return m_opcodes[opcode]; }
+
+    // Called by the CPU after each step with the counts for where it started,
+    // the cycles it took, and the stack pointer after it
+    void onStep(Counts& counts, uint32_t cycles, uint16_t sp) {
+        ++counts.instructions;
+        counts.cycles += cycles;
+
+        m_pendingCycles += cycles;
+        ++m_pendingSteps;
+        if (sp > m_settleSp) {
+            settle(sp);
+        }
+    }
+
+    // Called for cycles the emulator skipped through at `pc` without
+    // stepping the CPU
+    void onSkip(uint16_t pc, uint32_t cycles);
+
+    // Called by the CPU as a CALL or RST pushes its return address, with the
+    // routine called and the stack pointer after the push
+    void onCall(uint16_t bank, uint16_t address, uint16_t sp);
+
+    // Called by the CPU as a RET or RETI pops its return address, with the
+    // stack pointer before the pop
+    void onReturn(uint16_t sp);
+
+    // Called by the CPU as it services `interrupt`, with the stack pointer
+    // after its return address is pushed; the call to the interrupt's vector
+    // that follows is part of the interrupt
+    void onInterrupt(Interrupt interrupt, uint16_t sp);
+
+    // Charges the cycles run since the shadow stack last changed to the
+    // routine on top of it, which the reports only include once done
+    void flush();
+
+    void reset();
+
+    // A human-readable summary: the hottest addresses, routines, opcodes and
+    // interrupt handlers, by cycles
+    void writeReport(std::ostream& out, size_t maxAddresses = 50) const;
+
+    // One line per call path, with the cycles spent in the routine at the
+    // end of it, in the folded-stack format taken by flame graph tools, e.g.
+    // `main;ROM0:0150;VBLANK;ROM0:2A10 1234`
+    void writeFoldedStacks(std::ostream& out) const;
+
+private:
+    struct Routine {
+        uint64_t calls = 0;
+        uint64_t inclusiveCycles = 0;
+        uint64_t exclusiveCycles = 0;
+
+        // Activations on the stack now, and when the outermost began, so
+        // that recursion is only counted once
+        uint32_t active = 0;
+        uint64_t entered = 0;
+    };
+
+    // A routine as reached through one call path
+    struct Node {
+        uint32_t parent;
+        uint32_t key;
+        Routine* routine;
+        uint64_t cycles;
+    };
+
+    struct Frame {
+        uint32_t node;
+
+        // The stack pointer just after the return address was pushed; the
+        // routine has returned once the stack is above it
+        uint16_t sp;
+
+        // The innermost interrupt being handled, or -1
+        int8_t interrupt;
+    };
+
+    // Routine keys outside the address space, for the root of the call tree
+    // and the interrupts
+    static constexpr uint16_t SPECIAL_BANK = 0xFFFF;
+    static constexpr uint32_t MAIN_KEY = (static_cast<uint32_t>(SPECIAL_BANK) << 16u) | 0xFFFF;
+
+    // Deeper frames than this are not tracked; their returns are not seen
+    // either, as no frame matches them
+    static constexpr size_t MAX_DEPTH = 256;
+
+    // Charges the step just run (and those before it) to the routine on top
+    // of the shadow stack, and drops the frames that the step returned from
+    void settle(uint16_t sp);
+
+    // Enters `key` below the top of the shadow stack
+    void pushFrame(uint32_t key, uint16_t sp, int8_t interrupt);
+    void popFrame();
+
+    // The name of (bank, pc) as it appears in the output, e.g. ROM3:4123
+    static std::string nameOf(uint16_t bank, uint16_t pc);
+    static const char* nameOf(Interrupt interrupt);
+    static std::string nameOfRoutine(uint32_t key);
+
+    static uint32_t makeKey(uint16_t bank, uint16_t pc) { return (static_cast<uint32_t>(bank) << 16u) | pc; }
+
+    // Calls `visit(bank, pc, counts, opcode)` for every address that has
+    // run, with the opcode there for ROM, or -1
+    template <typename Visitor>
+    void forEachAddress(Visitor visit) const;
+
+    // ROM bank 0 (0000-3FFF), the switchable ROM banks (4000-7FFF) as they
+    // are first run, and everything else (8000-FFFF), along with the opcode
+    // at each address in ROM
+    std::vector<Counts> m_rom0;
+    std::vector<std::vector<Counts>> m_romBanks;
+    std::vector<Counts> m_ram;
+    std::vector<uint16_t> m_rom0Opcodes;
+    std::vector<std::vector<uint16_t>> m_romBankOpcodes;
+
+    // The counts (and ROM opcodes) for each 8K of the address space, with
+    // 4000-7FFF in the bank switched in
+    std::array<Counts*, 8> m_regions{};
+    std::array<uint16_t*, 4> m_romOpcodes{};
+    uint16_t m_romBank = 0;
+
+    // Cycles skipped at each address in ROM, which its opcode doesn't count
+    std::unordered_map<uint32_t, uint64_t> m_skippedRomCycles;
+
+    // Totals for each opcode run outside ROM (plus 0x100 for CB-prefixed
+    // opcodes); those in ROM are added up from the addresses they ran at
+    std::array<Counts, 0x200> m_opcodes{};
+
+    // Totals for each interrupt handler
+    std::array<Counts, INTERRUPT_COUNT> m_handlers{};
+    std::array<uint64_t, INTERRUPT_COUNT> m_handlerEntries{};
+
+    // Every routine that has been called, by makeKey(), and the call tree;
+    // node 0 is the main program
+    std::unordered_map<uint32_t, Routine> m_routines;
+    std::vector<Node> m_nodes;
+    std::unordered_map<uint64_t, uint32_t> m_children;
+
+    // The shadow stack, innermost last, and what the current step is charged
+    // to: the top of the stack as the step began
+    std::vector<Frame> m_stack;
+    uint32_t m_current = 0;
+    int8_t m_currentInterrupt = -1;
+
+    // Steps are only charged to m_current when it might change: after a step
+    // leaves SP above m_settleSp, which is the top frame's SP, FFFF with the
+    // stack empty, or -1 once a frame is pushed or a return is seen. Until
+    // then their cycles (and the number of them) are kept here.
+    int32_t m_settleSp = 0xFFFF;
+    uint64_t m_pendingCycles = 0;
+    uint64_t m_pendingSteps = 0;
+
+    // Every cycle so far
+    uint64_t m_cycles = 0;
+
+    // Set by onReturn() for the step it happens in
+    bool m_returned = false;
+    uint16_t m_returnSp = 0;
+
+    // Set by onInterrupt() until the call to the vector has been skipped
+    bool m_enteringInterrupt = false;
+
+    uint64_t m_resyncs = 0;
+};
+
+#endif //BIGBOY_PROFILER_H
@@ -87,6 +87,8 @@ public:
     uint16_t& AF();
     uint16_t AF() const;
 
+    // Defined inline below so that the switch folds away whenever the operand
+    // is a compile-time constant (see CPU's dispatch tables).
     uint8_t& get(RegisterOperand target);
     uint16_t& get(RegisterPairOperand target);
     uint16_t& get(RegisterPairStackOperand target);
@@ -116,4 +118,95 @@ private:
     static constexpr uint8_t CARRY_FLAG_BYTE_POSITION = 4;
 };
 
+inline uint16_t& Registers::BC() {
+    #ifdef BIGBOY_BIG_ENDIAN
+    return *static_cast<uint16_t*>(static_cast<void*>(&b));
+    #else
+    return *static_cast<uint16_t*>(static_cast<void*>(&c));
+    #endif
+}
+
+inline uint16_t Registers::BC() const {
+    return static_cast<uint16_t>(b) << 8u
+           | static_cast<uint16_t>(c);
+}
+
+inline uint16_t& Registers::DE() {
+    #ifdef BIGBOY_BIG_ENDIAN
+    return *static_cast<uint16_t*>(static_cast<void*>(&d));
+    #else
+    return *static_cast<uint16_t*>(static_cast<void*>(&e));
+    #endif
+}
+
+inline uint16_t Registers::DE() const {
+    return static_cast<uint16_t>(d) << 8u
+           | static_cast<uint16_t>(e);
+}
+
+inline uint16_t& Registers::HL() {
+    #ifdef BIGBOY_BIG_ENDIAN
+    return *static_cast<uint16_t*>(static_cast<void*>(&h));
+    #else
+    return *static_cast<uint16_t*>(static_cast<void*>(&l));
+    #endif
+}
+
+inline uint16_t Registers::HL() const {
+    return static_cast<uint16_t>(h) << 8u
+           | static_cast<uint16_t>(l);
+}
+
+inline uint16_t& Registers::AF() {
+    #ifdef BIGBOY_BIG_ENDIAN
+    return *static_cast<uint16_t*>(static_cast<void*>(&a));
+    #else
+    return *static_cast<uint16_t*>(static_cast<void*>(&f));
+    #endif
+}
+
+inline uint16_t Registers::AF() const {
+    return static_cast<uint16_t>(a) << 8u
+           | static_cast<uint16_t>(f);
+}
+
+inline uint8_t& Registers::get(RegisterOperand target) {
+    switch (target) {
+        case RegisterOperand::B: return b;
+        case RegisterOperand::C: return c;
+        case RegisterOperand::D: return d;
+        case RegisterOperand::E: return e;
+        case RegisterOperand::H: return h;
+        case RegisterOperand::L: return l;
+        case RegisterOperand::A: return a;
+    }
+}
+
+inline uint16_t& Registers::get(RegisterPairOperand target) {
+    switch (target) {
+        case RegisterPairOperand::BC: return BC();
+        case RegisterPairOperand::DE: return DE();
+        case RegisterPairOperand::HL: return HL();
+        case RegisterPairOperand::SP: return sp;
+    }
+}
+
+inline uint16_t& Registers::get(RegisterPairStackOperand target) {
+    switch (target) {
+        case RegisterPairStackOperand::BC: return BC();
+        case RegisterPairStackOperand::DE: return DE();
+        case RegisterPairStackOperand::HL: return HL();
+        case RegisterPairStackOperand::AF: return AF();
+    }
+}
+
+inline bool Registers::get(ConditionOperand condition) const {
+    switch (condition) {
+        case ConditionOperand::NZ: return !getZeroFlag();
+        case ConditionOperand::Z:  return getZeroFlag();
+        case ConditionOperand::NC: return !getCarryFlag();
+        case ConditionOperand::C:  return getCarryFlag();
+    }
+}
+
 #endif //BIGBOY_REGISTERS_H
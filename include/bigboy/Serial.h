@@ -10,8 +10,11 @@ public:
     std::vector<AddressSpace> addressSpaces() const override;
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
+    void attach(MMU& mmu) override;
 
 private:
+    void writeControl(uint8_t value);
+
     uint8_t m_data = 0;    // FF01: Serial data (SB)
     uint8_t m_control = 0; // FF02: Serial control (SC)
 };
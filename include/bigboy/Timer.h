@@ -13,15 +13,23 @@ enum class FrequencySelect {
 class Timer : public MemoryDevice {
 public:
     // Returns true if an interrupt is to be requested
-    bool update(uint8_t cycles);
+    bool update(uint32_t cycles);
+
+    // How many more cycles until TIMA overflows and requests an interrupt, or
+    // DIV is next incremented. UINT32_MAX if the timer is stopped.
+    uint32_t cyclesUntilInterrupt() const;
+    uint32_t cyclesUntilDividerIncrement() const { return DIVIDER_FREQUENCY - m_divClock; }
 
     std::vector<AddressSpace> addressSpaces() const override;
     uint8_t readByte(uint16_t address) const override;
     void writeByte(uint16_t address, uint8_t value) override;
+    void attach(MMU& mmu) override;
 
     void reset();
 
 private:
+    void writeDivider(uint8_t value);
+
     bool timerEnabled() const { return ((m_tac >> 2u) & 1u) != 0; }
     uint32_t getTimerFrequency() const;
 
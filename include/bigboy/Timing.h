@@ -0,0 +1,51 @@
+#ifndef BIGBOY_TIMING_H
+#define BIGBOY_TIMING_H
+
+class CPU;
+
+// How the CPU's bus accesses line up with the devices. The instruction
+// handlers report every M-cycle (4 clock cycles) they spend on the bus
+// through the hooks below, and the policy the CPU is built with (CPUTiming)
+// decides what to do about it. Both policies are compiled from the same
+// handlers.
+
+// Every access an instruction makes happens at once, and the devices only
+// hear about its cycles once it has finished (see CPU::step() and
+// CPU::runUntil()). The hooks do nothing, so nothing is left of them once
+// they are inlined.
+struct InstructionTiming {
+    static constexpr bool M_CYCLE_ACCURATE = false;
+
+    static void beginInstruction(CPU&) {}
+    static void fetch(CPU&) {}
+    static void internal(CPU&) {}
+    static void access(CPU&) {}
+};
+
+// The devices are brought up to date with the M-cycle the CPU is in just
+// before each memory access, so that, for example, the timer is read at the
+// cycle the read actually happens on rather than at the start of the
+// instruction. The cycles of an instruction are still returned from
+// CPU::step(), less those the devices have been given already (see
+// CPU::syncedInStep()). Compiled code (the JIT and AOT modules) runs whole
+// blocks at once, so neither can be used with it.
+struct MCycleTiming {
+    static constexpr bool M_CYCLE_ACCURATE = true;
+
+    // An instruction starts; its opcode has not been fetched yet
+    static void beginInstruction(CPU& cpu);
+    // An opcode or operand byte is fetched
+    static void fetch(CPU& cpu);
+    // An M-cycle passes without using the bus
+    static void internal(CPU& cpu);
+    // Just before a memory read or write
+    static void access(CPU& cpu);
+};
+
+#ifdef BIGBOY_M_CYCLE_TIMING
+using CPUTiming = MCycleTiming;
+#else
+using CPUTiming = InstructionTiming;
+#endif
+
+#endif //BIGBOY_TIMING_H
@@ -0,0 +1,111 @@
+#ifndef BIGBOY_TRACER_H
+#define BIGBOY_TRACER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// The state of the CPU just before one step
+struct TraceRecord {
+    // Cycles run (or skipped through) since tracing started
+    uint64_t cycle;
+
+    uint16_t pc;
+    // ROM bank, for 4000-7FFF; 0 elsewhere
+    uint16_t bank;
+    // The instruction at pc, padded with whatever follows it
+    std::array<uint8_t, 3> bytes;
+
+    // TRACE_IME and TRACE_HALTED
+    uint8_t state;
+
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t sp;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "trace records are meant to be small and fixed-size");
+
+constexpr uint8_t TRACE_IME = 1u << 0u;
+constexpr uint8_t TRACE_HALTED = 1u << 1u;
+
+// Records every step the CPU takes (see CPU::step()) into an in-memory ring
+// buffer, overwriting the oldest records once it is full. By default it is a
+// flight recorder: nothing leaves memory until dump() writes the last
+// `capacity` records out, which can also be left to happen if the process
+// crashes. While streaming, a background thread instead writes every record
+// out as text as it goes, and the CPU waits for it whenever it falls a whole
+// buffer behind.
+class Tracer {
+public:
+    // `capacity` is rounded up to a power of two
+    explicit Tracer(size_t capacity);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    void record(const TraceRecord& record) {
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (m_streaming && head - m_tail.load(std::memory_order_acquire) > m_mask) {
+            waitForWriter(head);
+        }
+
+        m_records[head & m_mask] = record;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    // Advances the cycle count, after a step or cycles skipped without one
+    void advance(uint32_t cycles) { m_cycle += cycles; }
+    uint64_t cycle() const { return m_cycle; }
+
+    // Writes every record from now on to `path` from a background thread.
+    // False if the file could not be opened.
+    bool startStreaming(const std::string& path);
+    void stopStreaming();
+
+    // Writes the records still in the buffer to `path` as text, oldest first
+    bool dump(const std::string& path) const;
+
+    // Dump to `path` if the process crashes (a fatal signal, including the
+    // SIGABRT from a failed assertion, or std::terminate()), or the CPU hits
+    // something it cannot execute. This is best effort: the dump is written
+    // from the signal handler, where strictly speaking only a handful of
+    // functions are safe to call. Only one tracer at a time can do this.
+    void dumpOnCrash(const std::string& path);
+
+    // Called by the CPU before it exits on a fatal error
+    void onFatal() const;
+
+    // One line per record, e.g.
+    // 000000012345 ROM1:4123 FA 00 C0  LD A, (nn)  AF=01B0 BC=0013 DE=00D8 HL=014D SP=FFFE IME
+    static void format(std::ostream& out, const TraceRecord& record);
+
+private:
+    void waitForWriter(uint64_t head);
+    void write(std::ostream& out, uint64_t from, uint64_t to) const;
+    void runWriter(std::ostream& out);
+
+    static void onCrashSignal(int signal);
+    static void onTerminate();
+
+    std::unique_ptr<TraceRecord[]> m_records;
+    uint64_t m_mask;
+
+    // Records written, and (while streaming) written out
+    std::atomic<uint64_t> m_head{0};
+    std::atomic<uint64_t> m_tail{0};
+
+    uint64_t m_cycle = 0;
+
+    bool m_streaming = false;
+    std::atomic<bool> m_stopWriter{false};
+    std::thread m_writer;
+
+    std::string m_crashPath;
+};
+
+#endif //BIGBOY_TRACER_H
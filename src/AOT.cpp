@@ -0,0 +1,170 @@
+#include <bigboy/AOT.h>
+
+#include <bigboy/Cartridge.h>
+#include <bigboy/CPU.h>
+
+#include <iostream>
+
+#include <dlfcn.h>
+
+namespace {
+    uint8_t readThrough(void* mmu, uint16_t address) {
+        return static_cast<MMU*>(mmu)->readByte(address);
+    }
+
+    void writeThrough(void* mmu, uint16_t address, uint8_t value) {
+        static_cast<MMU*>(mmu)->writeByte(address, value);
+    }
+}
+
+AOT::AOT(CPU& cpu) : m_cpu{cpu} {
+    m_context.readThrough = &readThrough;
+    m_context.writeThrough = &writeThrough;
+    m_context.mmu = &cpu.m_mmu;
+    m_context.highRam = cpu.m_mmu.internalMemory().highRam();
+}
+
+AOT::~AOT() {
+    if (m_library) {
+        dlclose(m_library);
+    }
+}
+
+bool AOT::load(const std::string& path) {
+    const Cartridge* cartridge = m_cpu.m_cartridge;
+    if (!cartridge || m_library) {
+        return false;
+    }
+
+    void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        std::cerr << "warning: AOT module '" << path << "' could not be loaded: " << dlerror() << '\n';
+        return false;
+    }
+
+    auto moduleFunction = reinterpret_cast<AotModuleFunction>(dlsym(library, BIGBOY_AOT_MODULE_SYMBOL));
+    const AotModule* module = moduleFunction ? moduleFunction() : nullptr;
+    if (!module || module->abiVersion != AOT_ABI_VERSION) {
+        std::cerr << "warning: AOT module '" << path << "' was built for another version of Bigboy.\n";
+        dlclose(library);
+        return false;
+    }
+
+    uint64_t romHash = aotHash(nullptr, 0);
+    uint16_t bankCount = 0;
+    while (const uint8_t* bank = cartridge->romBankData(bankCount)) {
+        romHash = aotHash(bank, 0x4000, romHash);
+        ++bankCount;
+    }
+    if (module->romHash != romHash) {
+        std::cerr << "warning: AOT module '" << path << "' was built for another ROM.\n";
+        dlclose(library);
+        return false;
+    }
+
+    m_rom0 = std::make_unique<BankBlocks>();
+    m_rom0->fill(nullptr);
+    m_banks.clear();
+    m_banks.resize(bankCount);
+
+    for (size_t i = 0; i < module->blockCount; ++i) {
+        const AotBlock& block = module->blocks[i];
+        if (block.pc <= 0x3FFF) {
+            (*m_rom0)[block.pc] = block.code;
+        } else if (block.pc <= 0x7FFF && block.bank < bankCount) {
+            std::unique_ptr<BankBlocks>& blocks = m_banks[block.bank];
+            if (!blocks) {
+                blocks = std::make_unique<BankBlocks>();
+                blocks->fill(nullptr);
+            }
+            (*blocks)[block.pc - 0x4000] = block.code;
+        }
+    }
+
+    m_library = library;
+    m_blockCount = module->blockCount;
+    m_mappedBank = 0xFFFF;
+    return true;
+}
+
+uint8_t AOT::execute() {
+    const Cartridge* cartridge = m_cpu.m_cartridge;
+    if (!m_library || !cartridge) {
+        return 0;
+    }
+
+    // Only ROM is translated
+    const uint16_t pc = m_cpu.m_pc;
+    AotFunction code = nullptr;
+    if (pc <= 0x3FFF) {
+        code = (*m_rom0)[pc];
+    } else if (pc <= 0x7FFF) {
+        const uint16_t bank = cartridge->romBank();
+        if (bank < m_banks.size() && m_banks[bank]) {
+            code = (*m_banks[bank])[pc - 0x4000];
+        }
+    }
+    if (!code) {
+        return 0;
+    }
+
+    map();
+
+    Registers& registers = m_cpu.m_registers;
+    m_context.a = registers.a;
+    m_context.f = registers.f;
+    m_context.b = registers.b;
+    m_context.c = registers.c;
+    m_context.d = registers.d;
+    m_context.e = registers.e;
+    m_context.h = registers.h;
+    m_context.l = registers.l;
+    m_context.sp = registers.sp;
+
+    const uint8_t cycles = code(&m_context);
+    if (cycles == 0) {
+        return 0;
+    }
+
+    registers.a = m_context.a;
+    registers.f = m_context.f;
+    registers.b = m_context.b;
+    registers.c = m_context.c;
+    registers.d = m_context.d;
+    registers.e = m_context.e;
+    registers.h = m_context.h;
+    registers.l = m_context.l;
+    registers.sp = m_context.sp;
+    m_cpu.m_pc = m_context.pc;
+    return cycles;
+}
+
+void AOT::map() {
+    const Cartridge* cartridge = m_cpu.m_cartridge;
+    const uint16_t bank = cartridge->romBank();
+    if (bank != m_mappedBank) {
+        const uint8_t* rom0 = cartridge->romBankData(0);
+        const uint8_t* romN = cartridge->romBankData(bank);
+        for (uint8_t region = 0; region < 4; ++region) {
+            m_context.read[region] = rom0 ? rom0 + region * 0x1000 : nullptr;
+            m_context.read[region + 4] = romN ? romN + region * 0x1000 : nullptr;
+        }
+        m_mappedBank = bank;
+    }
+
+    // The block cache and the JIT watch writes to RAM they have decoded, so
+    // while either is in use writes have to go through the MMU
+    bool writeThrough = m_cpu.m_dispatchMode == DispatchMode::BLOCK_CACHE;
+#ifdef BIGBOY_JIT
+    writeThrough = writeThrough || m_cpu.jitEnabled();
+#endif
+    if (writeThrough != m_writeThrough || !m_context.read[0xC]) {
+        InternalMemory& internal = m_cpu.m_mmu.internalMemory();
+        m_context.read[0xC] = internal.workRam(0);
+        m_context.read[0xD] = internal.workRam(1);
+        m_context.write[0xC] = writeThrough ? nullptr : internal.workRam(0);
+        m_context.write[0xD] = writeThrough ? nullptr : internal.workRam(1);
+        m_context.highRamWrite = writeThrough ? nullptr : internal.highRam();
+        m_writeThrough = writeThrough;
+    }
+}
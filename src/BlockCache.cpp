@@ -0,0 +1,78 @@
+#include <bigboy/BlockCache.h>
+
+#include <bigboy/InternalMemory.h>
+
+const Block* BlockCache::findSlow(uint32_t key) const {
+    auto it = m_blocks.find(key);
+    if (it == m_blocks.end()) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+const Block& BlockCache::insert(uint16_t bank, uint16_t pc, Block block) {
+    const uint32_t key = makeKey(bank, pc);
+    const Block& inserted = m_blocks[key] = std::move(block);
+
+    // Code in RAM can be overwritten, so keep an eye on it. Writes are
+    // reported at the address in C000-DFFF, so code in echo RAM goes with
+    // the page it mirrors.
+    if (pc >= 0x8000 && !inserted.ops.empty() && m_memory) {
+        m_memory->watchCode(pc, inserted.last);
+        const uint16_t mirror = (pc >= 0xE000 && pc <= 0xFDFF) ? 0x2000 : 0;
+        for (uint32_t page = (pc - mirror) >> 8u; page <= ((inserted.last - mirror) >> 8u); ++page) {
+            m_pageBlocks[page].push_back(key);
+        }
+    }
+
+    return inserted;
+}
+
+const MicroOp* BlockCache::enter(const Block& block) {
+    if (block.ops.empty()) {
+        leave();
+        return nullptr;
+    }
+
+    m_cursor = block.ops.data();
+    m_end = m_cursor + block.ops.size();
+    return m_cursor++;
+}
+
+void BlockCache::clear() {
+    leave();
+    m_blocks.clear();
+    m_lookup.fill(LookupEntry{});
+    for (std::vector<uint32_t>& keys : m_pageBlocks) {
+        keys.clear();
+    }
+
+    if (m_memory) {
+        m_memory->unwatchCode(0xC000, 0xFFFE);
+    }
+}
+
+void BlockCache::onCodeWrite(uint16_t address) {
+    invalidatePage(address >> 8u);
+}
+
+void BlockCache::invalidatePage(uint8_t page) {
+    leave();
+
+    for (uint32_t key : m_pageBlocks[page]) {
+        m_blocks.erase(key);
+
+        LookupEntry& entry = m_lookup[key & (m_lookup.size() - 1)];
+        if (entry.key == key) {
+            entry.block = nullptr;
+        }
+    }
+    m_pageBlocks[page].clear();
+
+    // Every block with code in the page is gone. Blocks running on into the
+    // neighbouring pages leave their bytes there marked, which at worst drops
+    // a few blocks for nothing later on.
+    const uint16_t start = page << 8u;
+    m_memory->unwatchCode(page == 0xFF ? 0xFF80 : start, start | 0xFFu);
+}
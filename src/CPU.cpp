@@ -1,172 +1,409 @@
 #include <bigboy/CPU.h>
 
+#ifdef BIGBOY_AOT
+#include <bigboy/AOT.h>
+#endif
+#include <bigboy/Cartridge.h>
+#include <bigboy/IdleLoopDetector.h>
+#ifdef BIGBOY_JIT
+#include <bigboy/JIT.h>
+#endif
+
+#include <algorithm>
 #include <bitset>
 #include <iostream>
-#include <sstream>
-#include <fstream>
 
 CPU::CPU(MMU& mmu) : m_mmu{mmu} {
     reset();
 }
 
+CPU::~CPU() = default;
+
+void CPU::setDispatchMode(DispatchMode mode) {
+    m_dispatchMode = mode;
+
+    m_blockCache.clear();
+    m_mmu.setBlockCache(mode == DispatchMode::BLOCK_CACHE ? &m_blockCache : nullptr);
+
+#ifdef BIGBOY_JIT
+    if (m_jit) {
+        m_jit->clear();
+    }
+#endif
+}
+
+void CPU::setCartridge(const Cartridge* cartridge) {
+    m_cartridge = cartridge;
+    m_blockCache.clear();
+
+    // The fetch window maps ROM banks, so it needs to hear about bank switches
+    invalidateFetchWindow();
+    m_mmu.setCPU(this);
+
+#ifdef BIGBOY_JIT
+    if (m_jit) {
+        m_jit->clear();
+    }
+#endif
+
+#ifdef BIGBOY_AOT
+    // Modules are built for one ROM
+    m_aot.reset();
+#endif
+}
+
+#ifdef BIGBOY_JIT
+bool CPU::setJITEnabled(bool enabled) {
+    m_mmu.setJIT(nullptr);
+    m_jit.reset();
+
+    // Compiled blocks cannot bring the devices up to date between accesses
+    if (enabled && !CPUTiming::M_CYCLE_ACCURATE) {
+        m_jit = std::make_unique<JIT>(*this);
+        if (!m_jit->available()) {
+            m_jit.reset();
+            return false;
+        }
+        m_mmu.setJIT(m_jit.get());
+    }
+
+    return jitEnabled();
+}
+#endif
+
+#ifdef BIGBOY_AOT
+bool CPU::loadAotModule(const std::string& path) {
+    // As with the JIT, translated blocks run at instruction granularity
+    if (CPUTiming::M_CYCLE_ACCURATE) {
+        return false;
+    }
+
+    m_aot = std::make_unique<AOT>(*this);
+    if (!m_aot->load(path)) {
+        m_aot.reset();
+        return false;
+    }
+    return true;
+}
+#endif
+
 void CPU::reset() {
     m_registers.reset();
     m_pc = 0x100;
     m_halted = false;
     m_stopped = false;
     m_ime = false;
+    m_interrupts.reset();
+    m_blockCache.clear();
+    invalidateFetchWindow();
+
+#ifdef BIGBOY_JIT
+    if (m_jit) {
+        m_jit->clear();
+    }
+#endif
+}
+
+#ifdef BIGBOY_PROFILER
+void CPU::setProfilerEnabled(bool enabled) {
+    m_profiler.reset();
+    if (enabled) {
+        m_profiler = std::make_unique<Profiler>();
+        m_romBankChanged = true;
+    }
+}
+#endif
+
+#ifdef BIGBOY_TRACE
+void CPU::setTraceCapacity(size_t capacity) {
+    m_tracer.reset();
+    if (capacity > 0) {
+        m_tracer = std::make_unique<Tracer>(capacity);
+    }
+}
+#endif
+
+#ifdef BIGBOY_STATS
+void CPU::setStatsEnabled(bool enabled) {
+    m_stats.reset();
+    if (enabled) {
+        m_stats = std::make_unique<ExecutionStats>();
+    }
 }
+#endif
+
+#ifdef BIGBOY_INSTRUMENTED
+void CPU::onSkipped(uint32_t cycles) {
+#ifdef BIGBOY_PROFILER
+    if (m_profiler) {
+        updateProfilerBank();
+        m_profiler->onSkip(m_pc, cycles);
+    }
+#endif
+#ifdef BIGBOY_TRACE
+    if (m_tracer) {
+        m_tracer->advance(cycles);
+    }
+#endif
+#ifdef BIGBOY_STATS
+    if (m_stats) {
+        if (m_halted) {
+            m_stats->haltedCycles += cycles;
+        } else {
+            ++m_stats->idleSkips;
+            m_stats->idleSkippedCycles += cycles;
+        }
+    }
+#endif
+}
+
+uint8_t CPU::instrumentedStep() {
+#ifdef BIGBOY_TRACE
+    // Recorded before the step, so that a flight recording dumped after a
+    // crash ends with the instruction responsible. Time spent halted counts
+    // against the HALT.
+    if (m_tracer) {
+        const uint16_t address = m_halted ? m_pc - 1 : m_pc;
+        TraceRecord record{};
+        record.cycle = m_tracer->cycle();
+        record.pc = address;
+        record.bank = bankOf(address);
+        record.bytes = {peek(address), peek(address + 1), peek(address + 2)};
+        record.state = (m_ime ? TRACE_IME : 0) | (m_halted ? TRACE_HALTED : 0);
+        record.a = m_registers.a;
+        record.f = m_registers.f;
+        record.b = m_registers.b;
+        record.c = m_registers.c;
+        record.d = m_registers.d;
+        record.e = m_registers.e;
+        record.h = m_registers.h;
+        record.l = m_registers.l;
+        record.sp = m_registers.sp;
+        m_tracer->record(record);
+    }
+#endif
+
+#ifdef BIGBOY_STATS
+    // Before the step moves the program counter on
+    const bool halted = m_halted;
+    const bool stopped = m_stopped;
+    uint16_t histogramIndex = 0;
+    if (m_stats && !halted && !stopped) {
+        histogramIndex = peek(m_pc);
+        if (histogramIndex == static_cast<uint8_t>(OpCode::CB)) {
+            histogramIndex = 256 + peek(m_pc + 1);
+        }
+    }
+#endif
+
+    // Copy loops run in bulk charge most of their cycles straight to the batch
+    const uint32_t batchCycles = m_batchCycles;
+    const uint8_t cycles = dispatch();
+    const uint32_t total = cycles + (m_batchCycles - batchCycles);
+
+#ifdef BIGBOY_TRACE
+    if (m_tracer) {
+        m_tracer->advance(total);
+    }
+#endif
+#ifdef BIGBOY_STATS
+    if (m_stats) {
+        if (stopped) {
+            ++m_stats->stoppedSteps;
+        } else if (halted) {
+            m_stats->haltedCycles += total;
+        } else {
+            ++m_stats->instructions;
+            m_stats->instructionCycles += total;
+            ++m_stats->opcodes[histogramIndex];
+        }
+    }
+#endif
+
+    return cycles;
+}
+
+uint16_t CPU::bankOf(uint16_t pc) const {
+    return (pc >= 0x4000 && pc <= 0x7FFF && m_cartridge) ? m_cartridge->romBank() : 0;
+}
+#endif
+
+uint8_t CPU::dispatch() {
+    CPUTiming::beginInstruction(*this);
 
-uint8_t CPU::step() {
     if (m_stopped) return 0;
     if (m_halted) {
         // We need to keep the clock going.
         return NOP();
     }
 
+#ifdef BIGBOY_AOT
+    if (m_aot) {
+        if (const uint8_t cycles = m_aot->execute()) {
+            return cycles;
+        }
+    }
+#endif
+
+#ifdef BIGBOY_JIT
+    if (m_jit) {
+        if (const uint8_t cycles = m_jit->execute()) {
+            return cycles;
+        }
+    }
+#endif
+
+    if (m_dispatchMode == DispatchMode::BLOCK_CACHE) {
+        return stepBlock();
+    }
+
+    if (m_dispatchMode == DispatchMode::TABLE) {
+        return s_handlers[nextByte()](*this);
+    }
+
     auto current = static_cast<OpCode>(nextByte());
 
     switch (current) {
         case OpCode::LD_B_B:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::B>();
         case OpCode::LD_B_C:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::C>();
         case OpCode::LD_B_D:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::D>();
         case OpCode::LD_B_E:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::E>();
         case OpCode::LD_B_H:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::H>();
         case OpCode::LD_B_L:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::L>();
         case OpCode::LD_B_A:
-            return LD_r_r(RegisterOperand::B, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::B, RegisterOperand::A>();
         case OpCode::LD_C_B:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::B>();
         case OpCode::LD_C_C:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::C>();
         case OpCode::LD_C_D:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::D>();
         case OpCode::LD_C_E:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::E>();
         case OpCode::LD_C_H:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::H>();
         case OpCode::LD_C_L:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::L>();
         case OpCode::LD_C_A:
-            return LD_r_r(RegisterOperand::C, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::C, RegisterOperand::A>();
         case OpCode::LD_D_B:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::B>();
         case OpCode::LD_D_C:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::C>();
         case OpCode::LD_D_D:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::D>();
         case OpCode::LD_D_E:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::E>();
         case OpCode::LD_D_H:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::H>();
         case OpCode::LD_D_L:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::L>();
         case OpCode::LD_D_A:
-            return LD_r_r(RegisterOperand::D, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::D, RegisterOperand::A>();
         case OpCode::LD_E_B:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::B>();
         case OpCode::LD_E_C:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::C>();
         case OpCode::LD_E_D:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::D>();
         case OpCode::LD_E_E:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::E>();
         case OpCode::LD_E_H:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::H>();
         case OpCode::LD_E_L:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::L>();
         case OpCode::LD_E_A:
-            return LD_r_r(RegisterOperand::E, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::E, RegisterOperand::A>();
         case OpCode::LD_H_B:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::B>();
         case OpCode::LD_H_C:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::C>();
         case OpCode::LD_H_D:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::D>();
         case OpCode::LD_H_E:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::E>();
         case OpCode::LD_H_H:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::H>();
         case OpCode::LD_H_L:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::L>();
         case OpCode::LD_H_A:
-            return LD_r_r(RegisterOperand::H, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::H, RegisterOperand::A>();
         case OpCode::LD_L_B:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::B>();
         case OpCode::LD_L_C:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::C>();
         case OpCode::LD_L_D:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::D>();
         case OpCode::LD_L_E:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::E>();
         case OpCode::LD_L_H:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::H>();
         case OpCode::LD_L_L:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::L>();
         case OpCode::LD_L_A:
-            return LD_r_r(RegisterOperand::L, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::L, RegisterOperand::A>();
         case OpCode::LD_A_B:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::B);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::B>();
         case OpCode::LD_A_C:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::C);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::C>();
         case OpCode::LD_A_D:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::D);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::D>();
         case OpCode::LD_A_E:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::E);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::E>();
         case OpCode::LD_A_H:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::H);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::H>();
         case OpCode::LD_A_L:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::L);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::L>();
         case OpCode::LD_A_A:
-            return LD_r_r(RegisterOperand::A, RegisterOperand::A);
+            return LD_r_r<RegisterOperand::A, RegisterOperand::A>();
         case OpCode::LD_B_n:
-            return LD_r_n(RegisterOperand::B);
+            return LD_r_n<RegisterOperand::B>();
         case OpCode::LD_C_n:
-            return LD_r_n(RegisterOperand::C);
+            return LD_r_n<RegisterOperand::C>();
         case OpCode::LD_D_n:
-            return LD_r_n(RegisterOperand::D);
+            return LD_r_n<RegisterOperand::D>();
         case OpCode::LD_E_n:
-            return LD_r_n(RegisterOperand::E);
+            return LD_r_n<RegisterOperand::E>();
         case OpCode::LD_H_n:
-            return LD_r_n(RegisterOperand::H);
+            return LD_r_n<RegisterOperand::H>();
         case OpCode::LD_L_n:
-            return LD_r_n(RegisterOperand::L);
+            return LD_r_n<RegisterOperand::L>();
         case OpCode::LD_A_n:
-            return LD_r_n(RegisterOperand::A);
+            return LD_r_n<RegisterOperand::A>();
         case OpCode::LD_B_HL:
-            return LD_r_HL(RegisterOperand::B);
+            return LD_r_HL<RegisterOperand::B>();
         case OpCode::LD_C_HL:
-            return LD_r_HL(RegisterOperand::C);
+            return LD_r_HL<RegisterOperand::C>();
         case OpCode::LD_D_HL:
-            return LD_r_HL(RegisterOperand::D);
+            return LD_r_HL<RegisterOperand::D>();
         case OpCode::LD_E_HL:
-            return LD_r_HL(RegisterOperand::E);
+            return LD_r_HL<RegisterOperand::E>();
         case OpCode::LD_H_HL:
-            return LD_r_HL(RegisterOperand::H);
+            return LD_r_HL<RegisterOperand::H>();
         case OpCode::LD_L_HL:
-            return LD_r_HL(RegisterOperand::L);
+            return LD_r_HL<RegisterOperand::L>();
         case OpCode::LD_A_HL:
-            return LD_r_HL(RegisterOperand::A);
+            return LD_r_HL<RegisterOperand::A>();
         case OpCode::LD_HL_B:
-            return LD_HL_r(RegisterOperand::B);
+            return LD_HL_r<RegisterOperand::B>();
         case OpCode::LD_HL_C:
-            return LD_HL_r(RegisterOperand::C);
+            return LD_HL_r<RegisterOperand::C>();
         case OpCode::LD_HL_D:
-            return LD_HL_r(RegisterOperand::D);
+            return LD_HL_r<RegisterOperand::D>();
         case OpCode::LD_HL_E:
-            return LD_HL_r(RegisterOperand::E);
+            return LD_HL_r<RegisterOperand::E>();
         case OpCode::LD_HL_H:
-            return LD_HL_r(RegisterOperand::H);
+            return LD_HL_r<RegisterOperand::H>();
         case OpCode::LD_HL_L:
-            return LD_HL_r(RegisterOperand::L);
+            return LD_HL_r<RegisterOperand::L>();
         case OpCode::LD_HL_A:
-            return LD_HL_r(RegisterOperand::A);
+            return LD_HL_r<RegisterOperand::A>();
         case OpCode::LD_HL_n:
             return LD_HL_n();
         case OpCode::LD_A_BC:
@@ -198,207 +435,207 @@ uint8_t CPU::step() {
         case OpCode::LDD_A_HL:
             return LDD_A_HL();
         case OpCode::LD_BC_nn:
-            return LD_dd_nn(RegisterPairOperand::BC);
+            return LD_dd_nn<RegisterPairOperand::BC>();
         case OpCode::LD_DE_nn:
-            return LD_dd_nn(RegisterPairOperand::DE);
+            return LD_dd_nn<RegisterPairOperand::DE>();
         case OpCode::LD_HL_nn:
-            return LD_dd_nn(RegisterPairOperand::HL);
+            return LD_dd_nn<RegisterPairOperand::HL>();
         case OpCode::LD_SP_nn:
-            return LD_dd_nn(RegisterPairOperand::SP);
+            return LD_dd_nn<RegisterPairOperand::SP>();
         case OpCode::LD_nn_SP:
             return LD_nn_SP();
         case OpCode::LD_SP_HL:
             return LD_SP_HL();
         case OpCode::PUSH_BC:
-            return PUSH_qq(RegisterPairStackOperand::BC);
+            return PUSH_qq<RegisterPairStackOperand::BC>();
         case OpCode::PUSH_DE:
-            return PUSH_qq(RegisterPairStackOperand::DE);
+            return PUSH_qq<RegisterPairStackOperand::DE>();
         case OpCode::PUSH_HL:
-            return PUSH_qq(RegisterPairStackOperand::HL);
+            return PUSH_qq<RegisterPairStackOperand::HL>();
         case OpCode::PUSH_AF:
-            return PUSH_qq(RegisterPairStackOperand::AF);
+            return PUSH_qq<RegisterPairStackOperand::AF>();
         case OpCode::POP_BC:
-            return POP_qq(RegisterPairStackOperand::BC);
+            return POP_qq<RegisterPairStackOperand::BC>();
         case OpCode::POP_DE:
-            return POP_qq(RegisterPairStackOperand::DE);
+            return POP_qq<RegisterPairStackOperand::DE>();
         case OpCode::POP_HL:
-            return POP_qq(RegisterPairStackOperand::HL);
+            return POP_qq<RegisterPairStackOperand::HL>();
         case OpCode::POP_AF:
-            return POP_qq(RegisterPairStackOperand::AF);
+            return POP_qq<RegisterPairStackOperand::AF>();
         case OpCode::ADDA_B:
-            return ADDA_r(RegisterOperand::B);
+            return ADDA_r<RegisterOperand::B>();
         case OpCode::ADDA_C:
-            return ADDA_r(RegisterOperand::C);
+            return ADDA_r<RegisterOperand::C>();
         case OpCode::ADDA_D:
-            return ADDA_r(RegisterOperand::D);
+            return ADDA_r<RegisterOperand::D>();
         case OpCode::ADDA_E:
-            return ADDA_r(RegisterOperand::E);
+            return ADDA_r<RegisterOperand::E>();
         case OpCode::ADDA_H:
-            return ADDA_r(RegisterOperand::H);
+            return ADDA_r<RegisterOperand::H>();
         case OpCode::ADDA_L:
-            return ADDA_r(RegisterOperand::L);
+            return ADDA_r<RegisterOperand::L>();
         case OpCode::ADDA_A:
-            return ADDA_r(RegisterOperand::A);
+            return ADDA_r<RegisterOperand::A>();
         case OpCode::ADDA_n:
             return ADDA_n();
         case OpCode::ADDA_HL:
             return ADDA_HL();
         case OpCode::ADCA_B:
-            return ADCA_r(RegisterOperand::B);
+            return ADCA_r<RegisterOperand::B>();
         case OpCode::ADCA_C:
-            return ADCA_r(RegisterOperand::C);
+            return ADCA_r<RegisterOperand::C>();
         case OpCode::ADCA_D:
-            return ADCA_r(RegisterOperand::D);
+            return ADCA_r<RegisterOperand::D>();
         case OpCode::ADCA_E:
-            return ADCA_r(RegisterOperand::E);
+            return ADCA_r<RegisterOperand::E>();
         case OpCode::ADCA_H:
-            return ADCA_r(RegisterOperand::H);
+            return ADCA_r<RegisterOperand::H>();
         case OpCode::ADCA_L:
-            return ADCA_r(RegisterOperand::L);
+            return ADCA_r<RegisterOperand::L>();
         case OpCode::ADCA_A:
-            return ADCA_r(RegisterOperand::A);
+            return ADCA_r<RegisterOperand::A>();
         case OpCode::ADCA_n:
             return ADCA_n();
         case OpCode::ADCA_HL:
             return ADCA_HL();
         case OpCode::SUB_B:
-            return SUB_r(RegisterOperand::B);
+            return SUB_r<RegisterOperand::B>();
         case OpCode::SUB_C:
-            return SUB_r(RegisterOperand::C);
+            return SUB_r<RegisterOperand::C>();
         case OpCode::SUB_D:
-            return SUB_r(RegisterOperand::D);
+            return SUB_r<RegisterOperand::D>();
         case OpCode::SUB_E:
-            return SUB_r(RegisterOperand::E);
+            return SUB_r<RegisterOperand::E>();
         case OpCode::SUB_H:
-            return SUB_r(RegisterOperand::H);
+            return SUB_r<RegisterOperand::H>();
         case OpCode::SUB_L:
-            return SUB_r(RegisterOperand::L);
+            return SUB_r<RegisterOperand::L>();
         case OpCode::SUB_A:
-            return SUB_r(RegisterOperand::A);
+            return SUB_r<RegisterOperand::A>();
         case OpCode::SUB_n:
             return SUB_n();
         case OpCode::SUB_HL:
             return SUB_HL();
         case OpCode::SBCA_B:
-            return SBCA_r(RegisterOperand::B);
+            return SBCA_r<RegisterOperand::B>();
         case OpCode::SBCA_C:
-            return SBCA_r(RegisterOperand::C);
+            return SBCA_r<RegisterOperand::C>();
         case OpCode::SBCA_D:
-            return SBCA_r(RegisterOperand::D);
+            return SBCA_r<RegisterOperand::D>();
         case OpCode::SBCA_E:
-            return SBCA_r(RegisterOperand::E);
+            return SBCA_r<RegisterOperand::E>();
         case OpCode::SBCA_H:
-            return SBCA_r(RegisterOperand::H);
+            return SBCA_r<RegisterOperand::H>();
         case OpCode::SBCA_L:
-            return SBCA_r(RegisterOperand::L);
+            return SBCA_r<RegisterOperand::L>();
         case OpCode::SBCA_A:
-            return SBCA_r(RegisterOperand::A);
+            return SBCA_r<RegisterOperand::A>();
         case OpCode::SBCA_n:
             return SBCA_n();
         case OpCode::SBCA_HL:
             return SBCA_HL();
         case OpCode::AND_B:
-            return AND_r(RegisterOperand::B);
+            return AND_r<RegisterOperand::B>();
         case OpCode::AND_C:
-            return AND_r(RegisterOperand::C);
+            return AND_r<RegisterOperand::C>();
         case OpCode::AND_D:
-            return AND_r(RegisterOperand::D);
+            return AND_r<RegisterOperand::D>();
         case OpCode::AND_E:
-            return AND_r(RegisterOperand::E);
+            return AND_r<RegisterOperand::E>();
         case OpCode::AND_H:
-            return AND_r(RegisterOperand::H);
+            return AND_r<RegisterOperand::H>();
         case OpCode::AND_L:
-            return AND_r(RegisterOperand::L);
+            return AND_r<RegisterOperand::L>();
         case OpCode::AND_A:
-            return AND_r(RegisterOperand::A);
+            return AND_r<RegisterOperand::A>();
         case OpCode::AND_n:
             return AND_n();
         case OpCode::AND_HL:
             return AND_HL();
         case OpCode::XOR_B:
-            return XOR_r(RegisterOperand::B);
+            return XOR_r<RegisterOperand::B>();
         case OpCode::XOR_C:
-            return XOR_r(RegisterOperand::C);
+            return XOR_r<RegisterOperand::C>();
         case OpCode::XOR_D:
-            return XOR_r(RegisterOperand::D);
+            return XOR_r<RegisterOperand::D>();
         case OpCode::XOR_E:
-            return XOR_r(RegisterOperand::E);
+            return XOR_r<RegisterOperand::E>();
         case OpCode::XOR_H:
-            return XOR_r(RegisterOperand::H);
+            return XOR_r<RegisterOperand::H>();
         case OpCode::XOR_L:
-            return XOR_r(RegisterOperand::L);
+            return XOR_r<RegisterOperand::L>();
         case OpCode::XOR_A:
-            return XOR_r(RegisterOperand::A);
+            return XOR_r<RegisterOperand::A>();
         case OpCode::XOR_n:
             return XOR_n();
         case OpCode::XOR_HL:
             return XOR_HL();
         case OpCode::OR_B:
-            return OR_r(RegisterOperand::B);
+            return OR_r<RegisterOperand::B>();
         case OpCode::OR_C:
-            return OR_r(RegisterOperand::C);
+            return OR_r<RegisterOperand::C>();
         case OpCode::OR_D:
-            return OR_r(RegisterOperand::D);
+            return OR_r<RegisterOperand::D>();
         case OpCode::OR_E:
-            return OR_r(RegisterOperand::E);
+            return OR_r<RegisterOperand::E>();
         case OpCode::OR_H:
-            return OR_r(RegisterOperand::H);
+            return OR_r<RegisterOperand::H>();
         case OpCode::OR_L:
-            return OR_r(RegisterOperand::L);
+            return OR_r<RegisterOperand::L>();
         case OpCode::OR_A:
-            return OR_r(RegisterOperand::A);
+            return OR_r<RegisterOperand::A>();
         case OpCode::OR_n:
             return OR_n();
         case OpCode::OR_HL:
             return OR_HL();
         case OpCode::CP_B:
-            return CP_r(RegisterOperand::B);
+            return CP_r<RegisterOperand::B>();
         case OpCode::CP_C:
-            return CP_r(RegisterOperand::C);
+            return CP_r<RegisterOperand::C>();
         case OpCode::CP_D:
-            return CP_r(RegisterOperand::D);
+            return CP_r<RegisterOperand::D>();
         case OpCode::CP_E:
-            return CP_r(RegisterOperand::E);
+            return CP_r<RegisterOperand::E>();
         case OpCode::CP_H:
-            return CP_r(RegisterOperand::H);
+            return CP_r<RegisterOperand::H>();
         case OpCode::CP_L:
-            return CP_r(RegisterOperand::L);
+            return CP_r<RegisterOperand::L>();
         case OpCode::CP_A:
-            return CP_r(RegisterOperand::A);
+            return CP_r<RegisterOperand::A>();
         case OpCode::CP_n:
             return CP_n();
         case OpCode::CP_HL:
             return CP_HL();
         case OpCode::INC_B:
-            return INC_r(RegisterOperand::B);
+            return INC_r<RegisterOperand::B>();
         case OpCode::INC_C:
-            return INC_r(RegisterOperand::C);
+            return INC_r<RegisterOperand::C>();
         case OpCode::INC_D:
-            return INC_r(RegisterOperand::D);
+            return INC_r<RegisterOperand::D>();
         case OpCode::INC_E:
-            return INC_r(RegisterOperand::E);
+            return INC_r<RegisterOperand::E>();
         case OpCode::INC_H:
-            return INC_r(RegisterOperand::H);
+            return INC_r<RegisterOperand::H>();
         case OpCode::INC_L:
-            return INC_r(RegisterOperand::L);
+            return INC_r<RegisterOperand::L>();
         case OpCode::INC_A:
-            return INC_r(RegisterOperand::A);
+            return INC_r<RegisterOperand::A>();
         case OpCode::INC_HL_:
             return INC_HL();
         case OpCode::DEC_B:
-            return DEC_r(RegisterOperand::B);
+            return DEC_r<RegisterOperand::B>();
         case OpCode::DEC_C:
-            return DEC_r(RegisterOperand::C);
+            return DEC_r<RegisterOperand::C>();
         case OpCode::DEC_D:
-            return DEC_r(RegisterOperand::D);
+            return DEC_r<RegisterOperand::D>();
         case OpCode::DEC_E:
-            return DEC_r(RegisterOperand::E);
+            return DEC_r<RegisterOperand::E>();
         case OpCode::DEC_H:
-            return DEC_r(RegisterOperand::H);
+            return DEC_r<RegisterOperand::H>();
         case OpCode::DEC_L:
-            return DEC_r(RegisterOperand::L);
+            return DEC_r<RegisterOperand::L>();
         case OpCode::DEC_A:
-            return DEC_r(RegisterOperand::A);
+            return DEC_r<RegisterOperand::A>();
         case OpCode::DEC_HL_:
             return DEC_HL_();
         case OpCode::DAA:
@@ -406,29 +643,29 @@ uint8_t CPU::step() {
         case OpCode::CPL:
             return CPL();
         case OpCode::ADD_HL_BC:
-            return ADD_HL_rr(RegisterPairOperand::BC);
+            return ADD_HL_rr<RegisterPairOperand::BC>();
         case OpCode::ADD_HL_DE:
-            return ADD_HL_rr(RegisterPairOperand::DE);
+            return ADD_HL_rr<RegisterPairOperand::DE>();
         case OpCode::ADD_HL_HL:
-            return ADD_HL_rr(RegisterPairOperand::HL);
+            return ADD_HL_rr<RegisterPairOperand::HL>();
         case OpCode::ADD_HL_SP:
-            return ADD_HL_rr(RegisterPairOperand::SP);
+            return ADD_HL_rr<RegisterPairOperand::SP>();
         case OpCode::INC_BC:
-            return INC_rr(RegisterPairOperand::BC);
+            return INC_rr<RegisterPairOperand::BC>();
         case OpCode::INC_DE:
-            return INC_rr(RegisterPairOperand::DE);
+            return INC_rr<RegisterPairOperand::DE>();
         case OpCode::INC_HL:
-            return INC_rr(RegisterPairOperand::HL);
+            return INC_rr<RegisterPairOperand::HL>();
         case OpCode::INC_SP:
-            return INC_rr(RegisterPairOperand::SP);
+            return INC_rr<RegisterPairOperand::SP>();
         case OpCode::DEC_BC:
-            return DEC_rr(RegisterPairOperand::BC);
+            return DEC_rr<RegisterPairOperand::BC>();
         case OpCode::DEC_DE:
-            return DEC_rr(RegisterPairOperand::DE);
+            return DEC_rr<RegisterPairOperand::DE>();
         case OpCode::DEC_HL:
-            return DEC_rr(RegisterPairOperand::HL);
+            return DEC_rr<RegisterPairOperand::HL>();
         case OpCode::DEC_SP:
-            return DEC_rr(RegisterPairOperand::SP);
+            return DEC_rr<RegisterPairOperand::SP>();
         case OpCode::ADD_SP_s:
             return ADD_SP_s();
         case OpCode::LD_HL_SPs:
@@ -460,66 +697,119 @@ uint8_t CPU::step() {
         case OpCode::JP_HL:
             return JP_HL();
         case OpCode::JP_NZ_nn:
-            return JP_f_nn(ConditionOperand::NZ);
+            return JP_f_nn<ConditionOperand::NZ>();
         case OpCode::JP_Z_nn:
-            return JP_f_nn(ConditionOperand::Z);
+            return JP_f_nn<ConditionOperand::Z>();
         case OpCode::JP_NC_nn:
-            return JP_f_nn(ConditionOperand::NC);
+            return JP_f_nn<ConditionOperand::NC>();
         case OpCode::JP_C_nn:
-            return JP_f_nn(ConditionOperand::C);
+            return JP_f_nn<ConditionOperand::C>();
         case OpCode::JR_PCdd:
             return JR_PCdd();
         case OpCode::JR_NZ_PCdd:
-            return JR_f_PCdd(ConditionOperand::NZ);
+            return JR_f_PCdd<ConditionOperand::NZ>();
         case OpCode::JR_Z_PCdd:
-            return JR_f_PCdd(ConditionOperand::Z);
+            return JR_f_PCdd<ConditionOperand::Z>();
         case OpCode::JR_NC_PCdd:
-            return JR_f_PCdd(ConditionOperand::NC);
+            return JR_f_PCdd<ConditionOperand::NC>();
         case OpCode::JR_C_PCdd:
-            return JR_f_PCdd(ConditionOperand::C);
+            return JR_f_PCdd<ConditionOperand::C>();
         case OpCode::CALL_nn:
             return CALL_nn();
         case OpCode::CALL_NZ_nn:
-            return CALL_f_nn(ConditionOperand::NZ);
+            return CALL_f_nn<ConditionOperand::NZ>();
         case OpCode::CALL_Z_nn:
-            return CALL_f_nn(ConditionOperand::Z);
+            return CALL_f_nn<ConditionOperand::Z>();
         case OpCode::CALL_NC_nn:
-            return CALL_f_nn(ConditionOperand::NC);
+            return CALL_f_nn<ConditionOperand::NC>();
         case OpCode::CALL_C_nn:
-            return CALL_f_nn(ConditionOperand::C);
+            return CALL_f_nn<ConditionOperand::C>();
         case OpCode::RET:
             return RET();
         case OpCode::RET_NZ:
-            return RET_f(ConditionOperand::NZ);
+            return RET_f<ConditionOperand::NZ>();
         case OpCode::RET_Z:
-            return RET_f(ConditionOperand::Z);
+            return RET_f<ConditionOperand::Z>();
         case OpCode::RET_NC:
-            return RET_f(ConditionOperand::NC);
+            return RET_f<ConditionOperand::NC>();
         case OpCode::RET_C:
-            return RET_f(ConditionOperand::C);
+            return RET_f<ConditionOperand::C>();
         case OpCode::RETI:
             return RETI();
         case OpCode::RST_00:
-            return RST(ResetOperand::x00);
+            return RST<ResetOperand::x00>();
         case OpCode::RST_08:
-            return RST(ResetOperand::x08);
+            return RST<ResetOperand::x08>();
         case OpCode::RST_10:
-            return RST(ResetOperand::x10);
+            return RST<ResetOperand::x10>();
         case OpCode::RST_18:
-            return RST(ResetOperand::x18);
+            return RST<ResetOperand::x18>();
         case OpCode::RST_20:
-            return RST(ResetOperand::x20);
+            return RST<ResetOperand::x20>();
         case OpCode::RST_28:
-            return RST(ResetOperand::x28);
+            return RST<ResetOperand::x28>();
         case OpCode::RST_30:
-            return RST(ResetOperand::x30);
+            return RST<ResetOperand::x30>();
         case OpCode::RST_38:
-            return RST(ResetOperand::x38);
+            return RST<ResetOperand::x38>();
         case OpCode::CB:
             return stepPrefix();
         default:
-            std::cerr << "fatal: unknown instruction: " << std::bitset<8>{static_cast<uint8_t>(current)} << ".\n";
-            std::exit(1);
+            fatal("unknown instruction", static_cast<uint8_t>(current));
+    }
+}
+
+void CPU::setDeviceSync(SyncCallback sync, void* context) {
+    m_sync = sync;
+    m_syncContext = context;
+}
+
+uint32_t CPU::runUntil(uint32_t deadline) {
+    m_inBatch = true;
+    m_endBatch = false;
+    m_deadline = deadline;
+    m_batchCycles = 0;
+    m_syncedCycles = 0;
+    m_idleIteration = 0;
+
+    while (true) {
+        const uint8_t cycles = step();
+        m_batchCycles += cycles;
+
+        if (m_batchCycles >= deadline || m_endBatch || m_halted || m_stopped || (m_ime && m_interrupts.pending())) {
+            break;
+        }
+
+        // Only once nothing else has ended the batch, so that the caller can
+        // skip ahead without anything else to do first
+        if (m_idleLoops) {
+            m_idleIteration = m_idleLoops->update(cycles);
+            if (m_idleIteration > 0) {
+                break;
+            }
+        }
+    }
+
+    syncDevices();
+    m_inBatch = false;
+    return m_batchCycles;
+}
+
+void CPU::onIoAccess(bool write) {
+    if (!m_inBatch) return;
+
+    // The access sees the devices as they were at the end of the last
+    // instruction, as it would when stepping
+    syncDevices();
+    m_endBatch |= write;
+}
+
+void CPU::syncDevices() {
+    // With M-cycle timing the devices may already be part way into the
+    // instruction
+    if (m_sync && m_batchCycles > m_syncedCycles) {
+        m_sync(m_syncContext, m_batchCycles - m_syncedCycles);
+        m_syncedCycles = m_batchCycles;
     }
 }
 
@@ -527,538 +817,994 @@ uint8_t CPU::stepPrefix() {
     auto current = static_cast<PrefixOpCode>(nextByte());
     switch (current) {
         case PrefixOpCode::RLC_B:
-            return RLC_r(RegisterOperand::B);
+            return RLC_r<RegisterOperand::B>();
         case PrefixOpCode::RLC_C:
-            return RLC_r(RegisterOperand::C);
+            return RLC_r<RegisterOperand::C>();
         case PrefixOpCode::RLC_D:
-            return RLC_r(RegisterOperand::D);
+            return RLC_r<RegisterOperand::D>();
         case PrefixOpCode::RLC_E:
-            return RLC_r(RegisterOperand::E);
+            return RLC_r<RegisterOperand::E>();
         case PrefixOpCode::RLC_H:
-            return RLC_r(RegisterOperand::H);
+            return RLC_r<RegisterOperand::H>();
         case PrefixOpCode::RLC_L:
-            return RLC_r(RegisterOperand::L);
+            return RLC_r<RegisterOperand::L>();
         case PrefixOpCode::RLC_A:
-            return RLC_r(RegisterOperand::A);
+            return RLC_r<RegisterOperand::A>();
         case PrefixOpCode::RLC_HL:
             return RLC_HL();
         case PrefixOpCode::RL_B:
-            return RL_r(RegisterOperand::B);
+            return RL_r<RegisterOperand::B>();
         case PrefixOpCode::RL_C:
-            return RL_r(RegisterOperand::C);
+            return RL_r<RegisterOperand::C>();
         case PrefixOpCode::RL_D:
-            return RL_r(RegisterOperand::D);
+            return RL_r<RegisterOperand::D>();
         case PrefixOpCode::RL_E:
-            return RL_r(RegisterOperand::E);
+            return RL_r<RegisterOperand::E>();
         case PrefixOpCode::RL_H:
-            return RL_r(RegisterOperand::H);
+            return RL_r<RegisterOperand::H>();
         case PrefixOpCode::RL_L:
-            return RL_r(RegisterOperand::L);
+            return RL_r<RegisterOperand::L>();
         case PrefixOpCode::RL_A:
-            return RL_r(RegisterOperand::A);
+            return RL_r<RegisterOperand::A>();
         case PrefixOpCode::RL_HL:
             return RL_HL();
         case PrefixOpCode::RRC_B:
-            return RRC_r(RegisterOperand::B);
+            return RRC_r<RegisterOperand::B>();
         case PrefixOpCode::RRC_C:
-            return RRC_r(RegisterOperand::C);
+            return RRC_r<RegisterOperand::C>();
         case PrefixOpCode::RRC_D:
-            return RRC_r(RegisterOperand::D);
+            return RRC_r<RegisterOperand::D>();
         case PrefixOpCode::RRC_E:
-            return RRC_r(RegisterOperand::E);
+            return RRC_r<RegisterOperand::E>();
         case PrefixOpCode::RRC_H:
-            return RRC_r(RegisterOperand::H);
+            return RRC_r<RegisterOperand::H>();
         case PrefixOpCode::RRC_L:
-            return RRC_r(RegisterOperand::L);
+            return RRC_r<RegisterOperand::L>();
         case PrefixOpCode::RRC_A:
-            return RRC_r(RegisterOperand::A);
+            return RRC_r<RegisterOperand::A>();
         case PrefixOpCode::RRC_HL:
             return RRC_HL();
         case PrefixOpCode::RR_B:
-            return RR_r(RegisterOperand::B);
+            return RR_r<RegisterOperand::B>();
         case PrefixOpCode::RR_C:
-            return RR_r(RegisterOperand::C);
+            return RR_r<RegisterOperand::C>();
         case PrefixOpCode::RR_D:
-            return RR_r(RegisterOperand::D);
+            return RR_r<RegisterOperand::D>();
         case PrefixOpCode::RR_E:
-            return RR_r(RegisterOperand::E);
+            return RR_r<RegisterOperand::E>();
         case PrefixOpCode::RR_H:
-            return RR_r(RegisterOperand::H);
+            return RR_r<RegisterOperand::H>();
         case PrefixOpCode::RR_L:
-            return RR_r(RegisterOperand::L);
+            return RR_r<RegisterOperand::L>();
         case PrefixOpCode::RR_A:
-            return RR_r(RegisterOperand::A);
+            return RR_r<RegisterOperand::A>();
         case PrefixOpCode::RR_HL:
             return RR_HL();
         case PrefixOpCode::SLA_B:
-            return SLA_r(RegisterOperand::B);
+            return SLA_r<RegisterOperand::B>();
         case PrefixOpCode::SLA_C:
-            return SLA_r(RegisterOperand::C);
+            return SLA_r<RegisterOperand::C>();
         case PrefixOpCode::SLA_D:
-            return SLA_r(RegisterOperand::D);
+            return SLA_r<RegisterOperand::D>();
         case PrefixOpCode::SLA_E:
-            return SLA_r(RegisterOperand::E);
+            return SLA_r<RegisterOperand::E>();
         case PrefixOpCode::SLA_H:
-            return SLA_r(RegisterOperand::H);
+            return SLA_r<RegisterOperand::H>();
         case PrefixOpCode::SLA_L:
-            return SLA_r(RegisterOperand::L);
+            return SLA_r<RegisterOperand::L>();
         case PrefixOpCode::SLA_A:
-            return SLA_r(RegisterOperand::A);
+            return SLA_r<RegisterOperand::A>();
         case PrefixOpCode::SLA_HL:
             return SLA_HL();
         case PrefixOpCode::SWAP_B:
-            return SWAP_r(RegisterOperand::B);
+            return SWAP_r<RegisterOperand::B>();
         case PrefixOpCode::SWAP_C:
-            return SWAP_r(RegisterOperand::C);
+            return SWAP_r<RegisterOperand::C>();
         case PrefixOpCode::SWAP_D:
-            return SWAP_r(RegisterOperand::D);
+            return SWAP_r<RegisterOperand::D>();
         case PrefixOpCode::SWAP_E:
-            return SWAP_r(RegisterOperand::E);
+            return SWAP_r<RegisterOperand::E>();
         case PrefixOpCode::SWAP_H:
-            return SWAP_r(RegisterOperand::H);
+            return SWAP_r<RegisterOperand::H>();
         case PrefixOpCode::SWAP_L:
-            return SWAP_r(RegisterOperand::L);
+            return SWAP_r<RegisterOperand::L>();
         case PrefixOpCode::SWAP_A:
-            return SWAP_r(RegisterOperand::A);
+            return SWAP_r<RegisterOperand::A>();
         case PrefixOpCode::SWAP_HL:
             return SWAP_HL();
         case PrefixOpCode::SRA_B:
-            return SRA_r(RegisterOperand::B);
+            return SRA_r<RegisterOperand::B>();
         case PrefixOpCode::SRA_C:
-            return SRA_r(RegisterOperand::C);
+            return SRA_r<RegisterOperand::C>();
         case PrefixOpCode::SRA_D:
-            return SRA_r(RegisterOperand::D);
+            return SRA_r<RegisterOperand::D>();
         case PrefixOpCode::SRA_E:
-            return SRA_r(RegisterOperand::E);
+            return SRA_r<RegisterOperand::E>();
         case PrefixOpCode::SRA_H:
-            return SRA_r(RegisterOperand::H);
+            return SRA_r<RegisterOperand::H>();
         case PrefixOpCode::SRA_L:
-            return SRA_r(RegisterOperand::L);
+            return SRA_r<RegisterOperand::L>();
         case PrefixOpCode::SRA_A:
-            return SRA_r(RegisterOperand::A);
+            return SRA_r<RegisterOperand::A>();
         case PrefixOpCode::SRA_HL:
             return SRA_HL();
         case PrefixOpCode::SRL_B:
-            return SRL_r(RegisterOperand::B);
+            return SRL_r<RegisterOperand::B>();
         case PrefixOpCode::SRL_C:
-            return SRL_r(RegisterOperand::C);
+            return SRL_r<RegisterOperand::C>();
         case PrefixOpCode::SRL_D:
-            return SRL_r(RegisterOperand::D);
+            return SRL_r<RegisterOperand::D>();
         case PrefixOpCode::SRL_E:
-            return SRL_r(RegisterOperand::E);
+            return SRL_r<RegisterOperand::E>();
         case PrefixOpCode::SRL_H:
-            return SRL_r(RegisterOperand::H);
+            return SRL_r<RegisterOperand::H>();
         case PrefixOpCode::SRL_L:
-            return SRL_r(RegisterOperand::L);
+            return SRL_r<RegisterOperand::L>();
         case PrefixOpCode::SRL_A:
-            return SRL_r(RegisterOperand::A);
+            return SRL_r<RegisterOperand::A>();
         case PrefixOpCode::SRL_HL:
             return SRL_HL();
         case PrefixOpCode::BIT_0_B:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::B>();
         case PrefixOpCode::BIT_1_B:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::B>();
         case PrefixOpCode::BIT_2_B:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::B>();
         case PrefixOpCode::BIT_3_B:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::B>();
         case PrefixOpCode::BIT_4_B:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::B>();
         case PrefixOpCode::BIT_5_B:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::B>();
         case PrefixOpCode::BIT_6_B:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::B>();
         case PrefixOpCode::BIT_7_B:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::B);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::B>();
         case PrefixOpCode::BIT_0_C:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::C>();
         case PrefixOpCode::BIT_1_C:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::C>();
         case PrefixOpCode::BIT_2_C:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::C>();
         case PrefixOpCode::BIT_3_C:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::C>();
         case PrefixOpCode::BIT_4_C:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::C>();
         case PrefixOpCode::BIT_5_C:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::C>();
         case PrefixOpCode::BIT_6_C:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::C>();
         case PrefixOpCode::BIT_7_C:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::C);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::C>();
         case PrefixOpCode::BIT_0_D:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::D>();
         case PrefixOpCode::BIT_1_D:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::D>();
         case PrefixOpCode::BIT_2_D:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::D>();
         case PrefixOpCode::BIT_3_D:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::D>();
         case PrefixOpCode::BIT_4_D:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::D>();
         case PrefixOpCode::BIT_5_D:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::D>();
         case PrefixOpCode::BIT_6_D:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::D>();
         case PrefixOpCode::BIT_7_D:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::D);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::D>();
         case PrefixOpCode::BIT_0_E:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::E>();
         case PrefixOpCode::BIT_1_E:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::E>();
         case PrefixOpCode::BIT_2_E:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::E>();
         case PrefixOpCode::BIT_3_E:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::E>();
         case PrefixOpCode::BIT_4_E:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::E>();
         case PrefixOpCode::BIT_5_E:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::E>();
         case PrefixOpCode::BIT_6_E:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::E>();
         case PrefixOpCode::BIT_7_E:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::E);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::E>();
         case PrefixOpCode::BIT_0_H:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::H>();
         case PrefixOpCode::BIT_1_H:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::H>();
         case PrefixOpCode::BIT_2_H:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::H>();
         case PrefixOpCode::BIT_3_H:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::H>();
         case PrefixOpCode::BIT_4_H:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::H>();
         case PrefixOpCode::BIT_5_H:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::H>();
         case PrefixOpCode::BIT_6_H:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::H>();
         case PrefixOpCode::BIT_7_H:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::H);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::H>();
         case PrefixOpCode::BIT_0_L:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::L>();
         case PrefixOpCode::BIT_1_L:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::L>();
         case PrefixOpCode::BIT_2_L:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::L>();
         case PrefixOpCode::BIT_3_L:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::L>();
         case PrefixOpCode::BIT_4_L:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::L>();
         case PrefixOpCode::BIT_5_L:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::L>();
         case PrefixOpCode::BIT_6_L:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::L>();
         case PrefixOpCode::BIT_7_L:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::L);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::L>();
         case PrefixOpCode::BIT_0_A:
-            return BIT_b_r(BitOperand::BIT0, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT0, RegisterOperand::A>();
         case PrefixOpCode::BIT_1_A:
-            return BIT_b_r(BitOperand::BIT1, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT1, RegisterOperand::A>();
         case PrefixOpCode::BIT_2_A:
-            return BIT_b_r(BitOperand::BIT2, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT2, RegisterOperand::A>();
         case PrefixOpCode::BIT_3_A:
-            return BIT_b_r(BitOperand::BIT3, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT3, RegisterOperand::A>();
         case PrefixOpCode::BIT_4_A:
-            return BIT_b_r(BitOperand::BIT4, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT4, RegisterOperand::A>();
         case PrefixOpCode::BIT_5_A:
-            return BIT_b_r(BitOperand::BIT5, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT5, RegisterOperand::A>();
         case PrefixOpCode::BIT_6_A:
-            return BIT_b_r(BitOperand::BIT6, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT6, RegisterOperand::A>();
         case PrefixOpCode::BIT_7_A:
-            return BIT_b_r(BitOperand::BIT7, RegisterOperand::A);
+            return BIT_b_r<BitOperand::BIT7, RegisterOperand::A>();
         case PrefixOpCode::BIT_0_HL:
-            return BIT_b_HL(BitOperand::BIT0);
+            return BIT_b_HL<BitOperand::BIT0>();
         case PrefixOpCode::BIT_1_HL:
-            return BIT_b_HL(BitOperand::BIT1);
+            return BIT_b_HL<BitOperand::BIT1>();
         case PrefixOpCode::BIT_2_HL:
-            return BIT_b_HL(BitOperand::BIT2);
+            return BIT_b_HL<BitOperand::BIT2>();
         case PrefixOpCode::BIT_3_HL:
-            return BIT_b_HL(BitOperand::BIT3);
+            return BIT_b_HL<BitOperand::BIT3>();
         case PrefixOpCode::BIT_4_HL:
-            return BIT_b_HL(BitOperand::BIT4);
+            return BIT_b_HL<BitOperand::BIT4>();
         case PrefixOpCode::BIT_5_HL:
-            return BIT_b_HL(BitOperand::BIT5);
+            return BIT_b_HL<BitOperand::BIT5>();
         case PrefixOpCode::BIT_6_HL:
-            return BIT_b_HL(BitOperand::BIT6);
+            return BIT_b_HL<BitOperand::BIT6>();
         case PrefixOpCode::BIT_7_HL:
-            return BIT_b_HL(BitOperand::BIT7);
+            return BIT_b_HL<BitOperand::BIT7>();
         case PrefixOpCode::SET_0_B:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::B>();
         case PrefixOpCode::SET_1_B:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::B>();
         case PrefixOpCode::SET_2_B:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::B>();
         case PrefixOpCode::SET_3_B:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::B>();
         case PrefixOpCode::SET_4_B:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::B>();
         case PrefixOpCode::SET_5_B:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::B>();
         case PrefixOpCode::SET_6_B:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::B>();
         case PrefixOpCode::SET_7_B:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::B);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::B>();
         case PrefixOpCode::SET_0_C:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::C>();
         case PrefixOpCode::SET_1_C:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::C>();
         case PrefixOpCode::SET_2_C:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::C>();
         case PrefixOpCode::SET_3_C:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::C>();
         case PrefixOpCode::SET_4_C:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::C>();
         case PrefixOpCode::SET_5_C:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::C>();
         case PrefixOpCode::SET_6_C:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::C>();
         case PrefixOpCode::SET_7_C:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::C);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::C>();
         case PrefixOpCode::SET_0_D:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::D>();
         case PrefixOpCode::SET_1_D:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::D>();
         case PrefixOpCode::SET_2_D:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::D>();
         case PrefixOpCode::SET_3_D:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::D>();
         case PrefixOpCode::SET_4_D:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::D>();
         case PrefixOpCode::SET_5_D:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::D>();
         case PrefixOpCode::SET_6_D:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::D>();
         case PrefixOpCode::SET_7_D:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::D);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::D>();
         case PrefixOpCode::SET_0_E:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::E>();
         case PrefixOpCode::SET_1_E:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::E>();
         case PrefixOpCode::SET_2_E:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::E>();
         case PrefixOpCode::SET_3_E:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::E>();
         case PrefixOpCode::SET_4_E:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::E>();
         case PrefixOpCode::SET_5_E:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::E>();
         case PrefixOpCode::SET_6_E:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::E>();
         case PrefixOpCode::SET_7_E:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::E);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::E>();
         case PrefixOpCode::SET_0_H:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::H>();
         case PrefixOpCode::SET_1_H:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::H>();
         case PrefixOpCode::SET_2_H:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::H>();
         case PrefixOpCode::SET_3_H:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::H>();
         case PrefixOpCode::SET_4_H:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::H>();
         case PrefixOpCode::SET_5_H:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::H>();
         case PrefixOpCode::SET_6_H:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::H>();
         case PrefixOpCode::SET_7_H:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::H);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::H>();
         case PrefixOpCode::SET_0_L:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::L>();
         case PrefixOpCode::SET_1_L:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::L>();
         case PrefixOpCode::SET_2_L:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::L>();
         case PrefixOpCode::SET_3_L:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::L>();
         case PrefixOpCode::SET_4_L:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::L>();
         case PrefixOpCode::SET_5_L:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::L>();
         case PrefixOpCode::SET_6_L:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::L>();
         case PrefixOpCode::SET_7_L:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::L);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::L>();
         case PrefixOpCode::SET_0_A:
-            return SET_b_r(BitOperand::BIT0, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT0, RegisterOperand::A>();
         case PrefixOpCode::SET_1_A:
-            return SET_b_r(BitOperand::BIT1, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT1, RegisterOperand::A>();
         case PrefixOpCode::SET_2_A:
-            return SET_b_r(BitOperand::BIT2, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT2, RegisterOperand::A>();
         case PrefixOpCode::SET_3_A:
-            return SET_b_r(BitOperand::BIT3, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT3, RegisterOperand::A>();
         case PrefixOpCode::SET_4_A:
-            return SET_b_r(BitOperand::BIT4, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT4, RegisterOperand::A>();
         case PrefixOpCode::SET_5_A:
-            return SET_b_r(BitOperand::BIT5, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT5, RegisterOperand::A>();
         case PrefixOpCode::SET_6_A:
-            return SET_b_r(BitOperand::BIT6, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT6, RegisterOperand::A>();
         case PrefixOpCode::SET_7_A:
-            return SET_b_r(BitOperand::BIT7, RegisterOperand::A);
+            return SET_b_r<BitOperand::BIT7, RegisterOperand::A>();
         case PrefixOpCode::SET_0_HL:
-            return SET_b_HL(BitOperand::BIT0);
+            return SET_b_HL<BitOperand::BIT0>();
         case PrefixOpCode::SET_1_HL:
-            return SET_b_HL(BitOperand::BIT1);
+            return SET_b_HL<BitOperand::BIT1>();
         case PrefixOpCode::SET_2_HL:
-            return SET_b_HL(BitOperand::BIT2);
+            return SET_b_HL<BitOperand::BIT2>();
         case PrefixOpCode::SET_3_HL:
-            return SET_b_HL(BitOperand::BIT3);
+            return SET_b_HL<BitOperand::BIT3>();
         case PrefixOpCode::SET_4_HL:
-            return SET_b_HL(BitOperand::BIT4);
+            return SET_b_HL<BitOperand::BIT4>();
         case PrefixOpCode::SET_5_HL:
-            return SET_b_HL(BitOperand::BIT5);
+            return SET_b_HL<BitOperand::BIT5>();
         case PrefixOpCode::SET_6_HL:
-            return SET_b_HL(BitOperand::BIT6);
+            return SET_b_HL<BitOperand::BIT6>();
         case PrefixOpCode::SET_7_HL:
-            return SET_b_HL(BitOperand::BIT7);
+            return SET_b_HL<BitOperand::BIT7>();
         case PrefixOpCode::RES_0_B:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::B>();
         case PrefixOpCode::RES_1_B:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::B>();
         case PrefixOpCode::RES_2_B:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::B>();
         case PrefixOpCode::RES_3_B:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::B>();
         case PrefixOpCode::RES_4_B:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::B>();
         case PrefixOpCode::RES_5_B:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::B>();
         case PrefixOpCode::RES_6_B:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::B>();
         case PrefixOpCode::RES_7_B:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::B);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::B>();
         case PrefixOpCode::RES_0_C:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::C>();
         case PrefixOpCode::RES_1_C:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::C>();
         case PrefixOpCode::RES_2_C:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::C>();
         case PrefixOpCode::RES_3_C:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::C>();
         case PrefixOpCode::RES_4_C:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::C>();
         case PrefixOpCode::RES_5_C:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::C>();
         case PrefixOpCode::RES_6_C:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::C>();
         case PrefixOpCode::RES_7_C:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::C);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::C>();
         case PrefixOpCode::RES_0_D:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::D>();
         case PrefixOpCode::RES_1_D:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::D>();
         case PrefixOpCode::RES_2_D:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::D>();
         case PrefixOpCode::RES_3_D:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::D>();
         case PrefixOpCode::RES_4_D:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::D>();
         case PrefixOpCode::RES_5_D:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::D>();
         case PrefixOpCode::RES_6_D:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::D>();
         case PrefixOpCode::RES_7_D:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::D);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::D>();
         case PrefixOpCode::RES_0_E:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::E>();
         case PrefixOpCode::RES_1_E:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::E>();
         case PrefixOpCode::RES_2_E:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::E>();
         case PrefixOpCode::RES_3_E:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::E>();
         case PrefixOpCode::RES_4_E:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::E>();
         case PrefixOpCode::RES_5_E:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::E>();
         case PrefixOpCode::RES_6_E:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::E>();
         case PrefixOpCode::RES_7_E:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::E);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::E>();
         case PrefixOpCode::RES_0_H:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::H>();
         case PrefixOpCode::RES_1_H:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::H>();
         case PrefixOpCode::RES_2_H:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::H>();
         case PrefixOpCode::RES_3_H:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::H>();
         case PrefixOpCode::RES_4_H:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::H>();
         case PrefixOpCode::RES_5_H:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::H>();
         case PrefixOpCode::RES_6_H:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::H>();
         case PrefixOpCode::RES_7_H:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::H);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::H>();
         case PrefixOpCode::RES_0_L:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::L>();
         case PrefixOpCode::RES_1_L:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::L>();
         case PrefixOpCode::RES_2_L:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::L>();
         case PrefixOpCode::RES_3_L:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::L>();
         case PrefixOpCode::RES_4_L:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::L>();
         case PrefixOpCode::RES_5_L:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::L>();
         case PrefixOpCode::RES_6_L:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::L>();
         case PrefixOpCode::RES_7_L:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::L);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::L>();
         case PrefixOpCode::RES_0_A:
-            return RES_b_r(BitOperand::BIT0, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT0, RegisterOperand::A>();
         case PrefixOpCode::RES_1_A:
-            return RES_b_r(BitOperand::BIT1, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT1, RegisterOperand::A>();
         case PrefixOpCode::RES_2_A:
-            return RES_b_r(BitOperand::BIT2, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT2, RegisterOperand::A>();
         case PrefixOpCode::RES_3_A:
-            return RES_b_r(BitOperand::BIT3, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT3, RegisterOperand::A>();
         case PrefixOpCode::RES_4_A:
-            return RES_b_r(BitOperand::BIT4, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT4, RegisterOperand::A>();
         case PrefixOpCode::RES_5_A:
-            return RES_b_r(BitOperand::BIT5, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT5, RegisterOperand::A>();
         case PrefixOpCode::RES_6_A:
-            return RES_b_r(BitOperand::BIT6, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT6, RegisterOperand::A>();
         case PrefixOpCode::RES_7_A:
-            return RES_b_r(BitOperand::BIT7, RegisterOperand::A);
+            return RES_b_r<BitOperand::BIT7, RegisterOperand::A>();
         case PrefixOpCode::RES_0_HL:
-            return RES_b_HL(BitOperand::BIT0);
+            return RES_b_HL<BitOperand::BIT0>();
         case PrefixOpCode::RES_1_HL:
-            return RES_b_HL(BitOperand::BIT1);
+            return RES_b_HL<BitOperand::BIT1>();
         case PrefixOpCode::RES_2_HL:
-            return RES_b_HL(BitOperand::BIT2);
+            return RES_b_HL<BitOperand::BIT2>();
         case PrefixOpCode::RES_3_HL:
-            return RES_b_HL(BitOperand::BIT3);
+            return RES_b_HL<BitOperand::BIT3>();
         case PrefixOpCode::RES_4_HL:
-            return RES_b_HL(BitOperand::BIT4);
+            return RES_b_HL<BitOperand::BIT4>();
         case PrefixOpCode::RES_5_HL:
-            return RES_b_HL(BitOperand::BIT5);
+            return RES_b_HL<BitOperand::BIT5>();
         case PrefixOpCode::RES_6_HL:
-            return RES_b_HL(BitOperand::BIT6);
+            return RES_b_HL<BitOperand::BIT6>();
         case PrefixOpCode::RES_7_HL:
-            return RES_b_HL(BitOperand::BIT7);
+            return RES_b_HL<BitOperand::BIT7>();
         default:
-            std::cerr << "fatal: unknown prefix instructon: " << std::bitset<8>{static_cast<uint8_t>(current)} << ".\n";
-            std::exit(-1);
+            fatal("unknown prefix instruction", static_cast<uint8_t>(current));
     }
 }
 
-void CPU::handleInterrupts() {
-    if (!m_ime) return;
+namespace {
+    // Operand fields as they are laid out in the opcode bit patterns
+    constexpr RegisterOperand decodeRegister(uint8_t bits) {
+        // 110 is (HL), which has its own handlers; 111 is A
+        return (bits == 0b111) ? RegisterOperand::A : static_cast<RegisterOperand>(bits);
+    }
 
-    for (int i = 0; i < INTERRUPT_COUNT; ++i) {
-        auto interrupt = static_cast<Interrupt>(i);
-        if (isInterruptServicable(interrupt)) {
-            serviceInterrupt(interrupt);
-            return;
+    constexpr RegisterPairOperand decodeRegisterPair(uint8_t bits) {
+        return static_cast<RegisterPairOperand>(bits);
+    }
+
+    constexpr RegisterPairStackOperand decodeRegisterPairStack(uint8_t bits) {
+        return static_cast<RegisterPairStackOperand>(bits);
+    }
+
+    constexpr ConditionOperand decodeCondition(uint8_t bits) {
+        return static_cast<ConditionOperand>(bits & 0b11u);
+    }
+
+    constexpr BitOperand decodeBit(uint8_t bits) {
+        return static_cast<BitOperand>(bits);
+    }
+
+    constexpr ResetOperand decodeReset(uint8_t bits) {
+        return static_cast<ResetOperand>(bits << 3u);
+    }
+
+    // Length in bytes of each (non-prefix) instruction, including its immediate
+    // operands. 0 for opcodes that don't exist.
+    constexpr uint8_t instructionLength(uint8_t opcode) {
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 0b111u;
+        const uint8_t z = opcode & 0b111u;
+
+        if (x == 0b00) {
+            if (z == 0b000) return (y == 1) ? 3 : (y >= 3) ? 2 : 1; // LD (nn), SP; JR
+            if (z == 0b001) return ((y & 1u) == 0) ? 3 : 1;         // LD dd, nn
+            if (z == 0b110) return 2;                               // LD r, n
+            return 1;
+        }
+        if (x == 0b01 || x == 0b10) return 1;
+
+        switch (z) {
+            case 0b000: return (y >= 4) ? 2 : 1;                     // LD (FF00+n); ADD SP, s; LD HL, SP+s
+            case 0b001: return 1;
+            case 0b010: return (y == 4 || y == 6) ? 1 : 3;          // JP f, nn; LD (nn), A
+            case 0b011: return (y == 0) ? 3 : (y == 1) ? 2 : (y >= 6) ? 1 : 0;
+            case 0b100: return (y < 4) ? 3 : 0;                      // CALL f, nn
+            case 0b101: return ((y & 1u) == 0) ? 1 : (y == 1) ? 3 : 0;
+            case 0b110: return 2;                                    // ALU A, n
+            default:    return 1;                                    // RST
+        }
+    }
+
+    // Does the instruction (possibly) continue execution somewhere other than
+    // the next instruction?
+    constexpr bool transfersControl(uint8_t opcode) {
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 0b111u;
+        const uint8_t z = opcode & 0b111u;
+
+        if (x == 0b00) return z == 0b000 && y >= 2;                 // STOP, JR
+        if (x == 0b01) return opcode == static_cast<uint8_t>(OpCode::HALT);
+        if (x == 0b10) return false;
+
+        switch (z) {
+            case 0b000: return y < 4;                                // RET f
+            case 0b001: return (y & 1u) != 0 && y != 7;              // RET, RETI, JP HL
+            case 0b010: return y < 4;                                // JP f, nn
+            case 0b011: return y == 0;                               // JP nn
+            case 0b100: return true;                                 // CALL f, nn
+            case 0b101: return y == 1;                               // CALL nn
+            case 0b110: return false;
+            default:    return true;                                 // RST
+        }
+    }
+
+    // Cycle cost of each (non-prefix) instruction; the not-taken cost for
+    // conditional control flow
+    constexpr std::array<uint8_t, 256> CYCLES{
+             4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4,
+             0, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8,  8,  4,  4,  8,  4,
+             8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,
+             8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+             8, 12, 12, 16, 12, 16,  8, 16,  8, 16, 12,  0, 12, 24,  8, 16,
+             8, 12, 12,  0, 12, 16,  8, 16,  8, 16, 12,  0, 12,  0,  8, 16,
+            12, 12,  8,  0,  0, 16,  8, 16, 16,  4, 16,  0,  0,  0,  8, 16,
+            12, 12,  8,  4,  0, 16,  8, 16, 12,  8, 16,  4,  0,  0,  8, 16
+    };
+
+    constexpr uint8_t prefixCycles(uint8_t opcode) {
+        // Register operands take 8 cycles; (HL) takes 16, or 12 for BIT
+        if ((opcode & 0b111u) != 0b110) return 8;
+        return ((opcode >> 6u) == 0b01) ? 12 : 16;
+    }
+
+    // The longest run of instructions decoded into a single block
+    constexpr size_t MAX_BLOCK_LENGTH = 64;
+
+    // Loops that copy or fill memory a byte at a time, which the block cache
+    // runs in bulk (see CPU::executeMemoryLoop()). The body is one of
+    //   LD A, (HL+); LD (DE), A; INC DE    copy upwards from HL to DE
+    //   LD A, (DE); LD (HL+), A; INC DE    copy upwards from DE to HL
+    //   LD (HL+), A                        fill upwards from HL
+    //   LD (HL-), A                        fill downwards from HL
+    // followed by a count and JR NZ back to the start. The count is DEC r for
+    // one of B, C, D or E that the body leaves alone, or for copies, which
+    // reload A every iteration anyway, DEC BC; LD A, B; OR C.
+    enum class MemoryLoop : uint8_t {
+        COPY_FROM_HL,
+        COPY_FROM_DE,
+        FILL_UP,
+        FILL_DOWN
+    };
+
+    // Counted in BC rather than a single register
+    constexpr uint8_t COUNT_BC = 0xFF;
+
+    struct MemoryLoopShape {
+        uint8_t firstOpcode;
+
+        // Length in bytes, and cycles per iteration that jumps back
+        uint8_t length;
+        uint8_t cycles;
+    };
+
+    constexpr MemoryLoopShape shapeOf(MemoryLoop loop, uint8_t counter) {
+        switch (loop) {
+            case MemoryLoop::COPY_FROM_HL:
+            case MemoryLoop::COPY_FROM_DE: {
+                const uint8_t firstOpcode = static_cast<uint8_t>(
+                        loop == MemoryLoop::COPY_FROM_HL ? OpCode::LDI_A_HL : OpCode::LD_A_DE);
+                return (counter == COUNT_BC) ? MemoryLoopShape{firstOpcode, 8, 52} : MemoryLoopShape{firstOpcode, 6, 40};
+            }
+            case MemoryLoop::FILL_UP:
+                return MemoryLoopShape{static_cast<uint8_t>(OpCode::LDI_HL_A), 4, 24};
+            default:
+                return MemoryLoopShape{static_cast<uint8_t>(OpCode::LDD_HL_A), 4, 24};
+        }
+    }
+
+    // Does `code` start with a memory loop? If so, sets `loop` and `counter`
+    bool matchMemoryLoop(const std::array<uint8_t, 8>& code, MemoryLoop& loop, uint8_t& counter) {
+        auto is = [&](size_t i, OpCode opcode) { return code[i] == static_cast<uint8_t>(opcode); };
+
+        uint8_t body;
+        if (is(0, OpCode::LDI_A_HL) && is(1, OpCode::LD_DE_A) && is(2, OpCode::INC_DE)) {
+            loop = MemoryLoop::COPY_FROM_HL;
+            body = 3;
+        } else if (is(0, OpCode::LD_A_DE) && is(1, OpCode::LDI_HL_A) && is(2, OpCode::INC_DE)) {
+            loop = MemoryLoop::COPY_FROM_DE;
+            body = 3;
+        } else if (is(0, OpCode::LDI_HL_A)) {
+            loop = MemoryLoop::FILL_UP;
+            body = 1;
+        } else if (is(0, OpCode::LDD_HL_A)) {
+            loop = MemoryLoop::FILL_DOWN;
+            body = 1;
+        } else {
+            return false;
         }
+
+        // DEC r is 00 rrr 101; copies use D and E as a pointer
+        const uint8_t lastCounter = (body == 3) ? 0b001 : 0b011;
+        const uint8_t r = (code[body] >> 3u) & 0b111u;
+        if ((code[body] & 0b11000111u) == 0b00000101u && r <= lastCounter) {
+            counter = r;
+        } else if (body == 3 && is(3, OpCode::DEC_BC) && is(4, OpCode::LD_A_B) && is(5, OpCode::OR_C)) {
+            counter = COUNT_BC;
+        } else {
+            return false;
+        }
+
+        const uint8_t length = shapeOf(loop, counter).length;
+        return is(length - 2, OpCode::JR_NZ_PCdd) && static_cast<int8_t>(code[length - 1]) == -length;
+    }
+
+    // Can a loop access `count` bytes starting at `start` in bulk? They must
+    // all be somewhere that accessing has no side effects, other than ROM
+    // for writes.
+    bool isBulkAccessible(uint16_t start, uint32_t count, bool write) {
+        const uint32_t end = start + count - 1;
+        if (write && start < 0x8000) return false;
+        return end <= 0xFEFF || (start >= 0xFF80 && end <= 0xFFFE);
     }
 }
 
+uint8_t CPU::lengthOf(uint8_t opcode) {
+    return instructionLength(opcode);
+}
+
+uint8_t CPU::cyclesOf(uint8_t opcode) {
+    return CYCLES[opcode];
+}
+
+bool CPU::endsBlock(uint8_t opcode) {
+    return transfersControl(opcode);
+}
+
+// Opcodes are split into fields: <x x> <y y y> <z z z>, where y is further
+// split into <p p> <q>. The field layout of each instruction is documented
+// alongside it in OpCode.h.
+template <uint8_t opcode>
+uint8_t CPU::execute(CPU& cpu) {
+    constexpr uint8_t x = opcode >> 6u;
+    constexpr uint8_t y = (opcode >> 3u) & 0b111u;
+    constexpr uint8_t z = opcode & 0b111u;
+    constexpr uint8_t p = y >> 1u;
+    constexpr uint8_t q = y & 1u;
+
+    if constexpr (x == 0b00) {
+        if constexpr (z == 0b000) {
+            if constexpr (y == 0) return cpu.NOP();
+            else if constexpr (y == 1) return cpu.LD_nn_SP();
+            else if constexpr (y == 2) return cpu.STOP();
+            else if constexpr (y == 3) return cpu.JR_PCdd();
+            else return cpu.JR_f_PCdd<decodeCondition(y)>();
+        } else if constexpr (z == 0b001) {
+            if constexpr (q == 0) return cpu.LD_dd_nn<decodeRegisterPair(p)>();
+            else return cpu.ADD_HL_rr<decodeRegisterPair(p)>();
+        } else if constexpr (z == 0b010) {
+            if constexpr (y == 0) return cpu.LD_BC_A();
+            else if constexpr (y == 1) return cpu.LD_A_BC();
+            else if constexpr (y == 2) return cpu.LD_DE_A();
+            else if constexpr (y == 3) return cpu.LD_A_DE();
+            else if constexpr (y == 4) return cpu.LDI_HL_A();
+            else if constexpr (y == 5) return cpu.LDI_A_HL();
+            else if constexpr (y == 6) return cpu.LDD_HL_A();
+            else return cpu.LDD_A_HL();
+        } else if constexpr (z == 0b011) {
+            if constexpr (q == 0) return cpu.INC_rr<decodeRegisterPair(p)>();
+            else return cpu.DEC_rr<decodeRegisterPair(p)>();
+        } else if constexpr (z == 0b100) {
+            if constexpr (y == 0b110) return cpu.INC_HL();
+            else return cpu.INC_r<decodeRegister(y)>();
+        } else if constexpr (z == 0b101) {
+            if constexpr (y == 0b110) return cpu.DEC_HL_();
+            else return cpu.DEC_r<decodeRegister(y)>();
+        } else if constexpr (z == 0b110) {
+            if constexpr (y == 0b110) return cpu.LD_HL_n();
+            else return cpu.LD_r_n<decodeRegister(y)>();
+        } else {
+            if constexpr (y == 0) return cpu.RLCA();
+            else if constexpr (y == 1) return cpu.RRCA();
+            else if constexpr (y == 2) return cpu.RLA();
+            else if constexpr (y == 3) return cpu.RRA();
+            else if constexpr (y == 4) return cpu.DAA();
+            else if constexpr (y == 5) return cpu.CPL();
+            else if constexpr (y == 6) return cpu.SCF();
+            else return cpu.CCF();
+        }
+    } else if constexpr (x == 0b01) {
+        if constexpr (y == 0b110 && z == 0b110) return cpu.HALT();
+        else if constexpr (z == 0b110) return cpu.LD_r_HL<decodeRegister(y)>();
+        else if constexpr (y == 0b110) return cpu.LD_HL_r<decodeRegister(z)>();
+        else return cpu.LD_r_r<decodeRegister(y), decodeRegister(z)>();
+    } else if constexpr (x == 0b10) {
+        if constexpr (z == 0b110) {
+            if constexpr (y == 0) return cpu.ADDA_HL();
+            else if constexpr (y == 1) return cpu.ADCA_HL();
+            else if constexpr (y == 2) return cpu.SUB_HL();
+            else if constexpr (y == 3) return cpu.SBCA_HL();
+            else if constexpr (y == 4) return cpu.AND_HL();
+            else if constexpr (y == 5) return cpu.XOR_HL();
+            else if constexpr (y == 6) return cpu.OR_HL();
+            else return cpu.CP_HL();
+        } else {
+            constexpr RegisterOperand r = decodeRegister(z);
+            if constexpr (y == 0) return cpu.ADDA_r<r>();
+            else if constexpr (y == 1) return cpu.ADCA_r<r>();
+            else if constexpr (y == 2) return cpu.SUB_r<r>();
+            else if constexpr (y == 3) return cpu.SBCA_r<r>();
+            else if constexpr (y == 4) return cpu.AND_r<r>();
+            else if constexpr (y == 5) return cpu.XOR_r<r>();
+            else if constexpr (y == 6) return cpu.OR_r<r>();
+            else return cpu.CP_r<r>();
+        }
+    } else {
+        if constexpr (z == 0b000) {
+            if constexpr (y < 4) return cpu.RET_f<decodeCondition(y)>();
+            else if constexpr (y == 4) return cpu.LD_FF00n_A();
+            else if constexpr (y == 5) return cpu.ADD_SP_s();
+            else if constexpr (y == 6) return cpu.LD_A_FF00n();
+            else return cpu.LD_HL_SPs();
+        } else if constexpr (z == 0b001) {
+            if constexpr (q == 0) return cpu.POP_qq<decodeRegisterPairStack(p)>();
+            else if constexpr (p == 0) return cpu.RET();
+            else if constexpr (p == 1) return cpu.RETI();
+            else if constexpr (p == 2) return cpu.JP_HL();
+            else return cpu.LD_SP_HL();
+        } else if constexpr (z == 0b010) {
+            if constexpr (y < 4) return cpu.JP_f_nn<decodeCondition(y)>();
+            else if constexpr (y == 4) return cpu.LD_FF00C_A();
+            else if constexpr (y == 5) return cpu.LD_nn_A();
+            else if constexpr (y == 6) return cpu.LD_A_FF00C();
+            else return cpu.LD_A_nn();
+        } else if constexpr (z == 0b011) {
+            if constexpr (y == 0) return cpu.JP_nn();
+            else if constexpr (y == 1) return s_prefixHandlers[cpu.nextByte()](cpu);
+            else if constexpr (y == 6) return cpu.DI();
+            else if constexpr (y == 7) return cpu.EI();
+            else return executeUnknown(cpu);
+        } else if constexpr (z == 0b100) {
+            if constexpr (y < 4) return cpu.CALL_f_nn<decodeCondition(y)>();
+            else return executeUnknown(cpu);
+        } else if constexpr (z == 0b101) {
+            if constexpr (q == 0) return cpu.PUSH_qq<decodeRegisterPairStack(p)>();
+            else if constexpr (p == 0) return cpu.CALL_nn();
+            else return executeUnknown(cpu);
+        } else if constexpr (z == 0b110) {
+            if constexpr (y == 0) return cpu.ADDA_n();
+            else if constexpr (y == 1) return cpu.ADCA_n();
+            else if constexpr (y == 2) return cpu.SUB_n();
+            else if constexpr (y == 3) return cpu.SBCA_n();
+            else if constexpr (y == 4) return cpu.AND_n();
+            else if constexpr (y == 5) return cpu.XOR_n();
+            else if constexpr (y == 6) return cpu.OR_n();
+            else return cpu.CP_n();
+        } else {
+            return cpu.RST<decodeReset(y)>();
+        }
+    }
+}
+
+// Prefix opcodes are laid out as <x x> <y y y> <z z z>, where z is the
+// register (or (HL)) operand. See PrefixOpCode.h.
+template <uint8_t opcode>
+uint8_t CPU::executePrefix(CPU& cpu) {
+    constexpr uint8_t x = opcode >> 6u;
+    constexpr uint8_t y = (opcode >> 3u) & 0b111u;
+    constexpr uint8_t z = opcode & 0b111u;
+
+    if constexpr (z == 0b110) {
+        if constexpr (x == 0b01) return cpu.BIT_b_HL<decodeBit(y)>();
+        else if constexpr (x == 0b10) return cpu.RES_b_HL<decodeBit(y)>();
+        else if constexpr (x == 0b11) return cpu.SET_b_HL<decodeBit(y)>();
+        else if constexpr (y == 0) return cpu.RLC_HL();
+        else if constexpr (y == 1) return cpu.RRC_HL();
+        else if constexpr (y == 2) return cpu.RL_HL();
+        else if constexpr (y == 3) return cpu.RR_HL();
+        else if constexpr (y == 4) return cpu.SLA_HL();
+        else if constexpr (y == 5) return cpu.SRA_HL();
+        else if constexpr (y == 6) return cpu.SWAP_HL();
+        else return cpu.SRL_HL();
+    } else {
+        constexpr RegisterOperand r = decodeRegister(z);
+        if constexpr (x == 0b01) return cpu.BIT_b_r<decodeBit(y), r>();
+        else if constexpr (x == 0b10) return cpu.RES_b_r<decodeBit(y), r>();
+        else if constexpr (x == 0b11) return cpu.SET_b_r<decodeBit(y), r>();
+        else if constexpr (y == 0) return cpu.RLC_r<r>();
+        else if constexpr (y == 1) return cpu.RRC_r<r>();
+        else if constexpr (y == 2) return cpu.RL_r<r>();
+        else if constexpr (y == 3) return cpu.RR_r<r>();
+        else if constexpr (y == 4) return cpu.SLA_r<r>();
+        else if constexpr (y == 5) return cpu.SRA_r<r>();
+        else if constexpr (y == 6) return cpu.SWAP_r<r>();
+        else return cpu.SRL_r<r>();
+    }
+}
+
+uint8_t CPU::executeUnknown(CPU& cpu) {
+    cpu.fatal("unknown instruction", cpu.m_mmu.readByte(cpu.m_pc - 1));
+}
+
+void CPU::fatal(const char* what, uint8_t opcode) {
+    std::cerr << "fatal: " << what << ": " << std::bitset<8>{opcode} << ".\n";
+
+#ifdef BIGBOY_TRACE
+    if (m_tracer) {
+        m_tracer->onFatal();
+    }
+#endif
+
+    std::exit(1);
+}
+
+template <size_t... opcodes>
+constexpr std::array<CPU::Handler, 256> CPU::makeHandlers(std::index_sequence<opcodes...>) {
+    return {{&CPU::execute<opcodes>...}};
+}
+
+template <size_t... opcodes>
+constexpr std::array<CPU::Handler, 256> CPU::makePrefixHandlers(std::index_sequence<opcodes...>) {
+    return {{&CPU::executePrefix<opcodes>...}};
+}
+
+const std::array<CPU::Handler, 256> CPU::s_handlers =
+        CPU::makeHandlers(std::make_index_sequence<256>{});
+const std::array<CPU::Handler, 256> CPU::s_prefixHandlers =
+        CPU::makePrefixHandlers(std::make_index_sequence<256>{});
+
+#ifdef BIGBOY_THREADED_INTERPRETER
+#if !defined(__GNUC__) && !defined(__clang__)
+#error "BIGBOY_THREADED_INTERPRETER requires labels-as-values (GCC or Clang)"
+#endif
+
+#define BIGBOY_OPCODES_16(X, hi) \
+    X(hi##0) X(hi##1) X(hi##2) X(hi##3) X(hi##4) X(hi##5) X(hi##6) X(hi##7) \
+    X(hi##8) X(hi##9) X(hi##A) X(hi##B) X(hi##C) X(hi##D) X(hi##E) X(hi##F)
+
+#define BIGBOY_OPCODES(X) \
+    BIGBOY_OPCODES_16(X, 0x0) BIGBOY_OPCODES_16(X, 0x1) BIGBOY_OPCODES_16(X, 0x2) BIGBOY_OPCODES_16(X, 0x3) \
+    BIGBOY_OPCODES_16(X, 0x4) BIGBOY_OPCODES_16(X, 0x5) BIGBOY_OPCODES_16(X, 0x6) BIGBOY_OPCODES_16(X, 0x7) \
+    BIGBOY_OPCODES_16(X, 0x8) BIGBOY_OPCODES_16(X, 0x9) BIGBOY_OPCODES_16(X, 0xA) BIGBOY_OPCODES_16(X, 0xB) \
+    BIGBOY_OPCODES_16(X, 0xC) BIGBOY_OPCODES_16(X, 0xD) BIGBOY_OPCODES_16(X, 0xE) BIGBOY_OPCODES_16(X, 0xF)
+
+void CPU::run(StepCallback afterStep, void* context) {
+#define BIGBOY_LABEL_ADDRESS(opcode) &&op_##opcode,
+    static void* const labels[256] = {BIGBOY_OPCODES(BIGBOY_LABEL_ADDRESS)};
+#undef BIGBOY_LABEL_ADDRESS
+
+    uint8_t cycles;
+
+    // Every handler ends with its own copy of this, so that each opcode gets its
+    // own indirect branch (and branch history) to the next one.
+#define BIGBOY_DISPATCH() \
+    do { \
+        if (!afterStep(context, cycles)) return; \
+        CPUTiming::beginInstruction(*this); \
+        if (m_halted || m_stopped) goto idle; \
+        goto *labels[nextByte()]; \
+    } while (false)
+
+    CPUTiming::beginInstruction(*this);
+    if (m_halted || m_stopped) goto idle;
+    goto *labels[nextByte()];
+
+idle:
+    // Same as step(): keep the clock going while halted, stand still while stopped.
+    cycles = m_stopped ? 0 : NOP();
+    BIGBOY_DISPATCH();
+
+#define BIGBOY_HANDLER(opcode) \
+    op_##opcode: \
+    cycles = execute<opcode>(*this); \
+    BIGBOY_DISPATCH();
+    BIGBOY_OPCODES(BIGBOY_HANDLER)
+#undef BIGBOY_HANDLER
+
+#undef BIGBOY_DISPATCH
+}
+
+#undef BIGBOY_OPCODES
+#undef BIGBOY_OPCODES_16
+#endif
+
+void CPU::handleInterrupts() {
+    if (m_interrupts.pending() == 0) return;
+    if (!m_ime) return;
+
+    serviceInterrupt(m_interrupts.next());
+}
+
 void CPU::serviceInterrupt(Interrupt interrupt) {
+    m_busTimed = false;
     m_ime = false;
-    unrequestInterrupt(interrupt);
+    m_interrupts.acknowledge(interrupt);
+
+#ifdef BIGBOY_PROFILER
+    if (m_profiler) {
+        // The return address is pushed by the call below
+        m_profiler->onInterrupt(interrupt, m_registers.sp - 2);
+    }
+#endif
 
     switch (interrupt) {
         case Interrupt::VBLANK:
@@ -1079,219 +1825,505 @@ void CPU::serviceInterrupt(Interrupt interrupt) {
     }
 }
 
-uint8_t CPU::nextByte() {
-    return m_mmu.readByte(m_pc++);
+uint8_t CPU::stepBlock() {
+    const MicroOp* op = m_blockCache.next(m_pc);
+    if (!op) {
+        op = enterBlock();
+        if (!op) {
+            // We can't cache code here, so decode it the usual way
+            return s_handlers[nextByte()](*this);
+        }
+    }
+
+    // The handler may write over (and so invalidate) its own block, so take
+    // a copy of the operands first
+    m_pc += op->opcodeLength;
+    CPUTiming::fetch(*this);
+    if (op->opcodeLength == 2) {
+        CPUTiming::fetch(*this);
+    }
+    m_operandBuffer = op->operands;
+    m_operands = m_operandBuffer.data();
+
+    const uint8_t cycles = op->handler(*this);
+
+    m_operands = nullptr;
+    return cycles;
 }
 
-uint16_t CPU::nextWord() {
-    uint16_t word = m_mmu.readWord(m_pc);
-    m_pc += 2;
-    return word;
+const MicroOp* CPU::enterBlock() {
+    uint16_t bank = 0;
+    if (m_pc >= 0x4000 && m_pc <= 0x7FFF) {
+        if (!m_cartridge) return nullptr;
+        bank = m_cartridge->romBank();
+    } else if (m_pc >= 0x8000 &&
+            !(m_pc >= 0xC000 && m_pc <= 0xFDFF) &&
+            !(m_pc >= 0xFF80 && m_pc <= 0xFFFE)) {
+        // Only ROM, work RAM (and its echo) and high RAM are cached
+        return nullptr;
+    }
+
+    const Block* block = m_blockCache.find(bank, m_pc);
+    if (!block) {
+        block = &m_blockCache.insert(bank, m_pc, decodeBlock(m_pc));
+    }
+
+    return m_blockCache.enter(*block);
+}
+
+Block CPU::decodeBlock(uint16_t pc) {
+    // Blocks never cross from one memory region (or ROM bank) into another
+    uint16_t regionEnd;
+    if (pc <= 0x3FFF) regionEnd = 0x3FFF;
+    else if (pc <= 0x7FFF) regionEnd = 0x7FFF;
+    else if (pc <= 0xDFFF) regionEnd = 0xDFFF;
+    else if (pc <= 0xFDFF) regionEnd = 0xFDFF;
+    else regionEnd = 0xFFFE;
+
+    Block block;
+
+    // A memory loop starting the block is run in bulk by a fused op standing
+    // in for its first instruction
+    std::array<uint8_t, 8> code{};
+    if (static_cast<uint32_t>(pc) + code.size() - 1 <= regionEnd) {
+        for (uint8_t i = 0; i < code.size(); ++i) {
+            code[i] = m_mmu.readByte(pc + i);
+        }
+
+        MemoryLoop loop;
+        uint8_t counter;
+        if (matchMemoryLoop(code, loop, counter)) {
+            MicroOp op{};
+            op.handler = &CPU::executeMemoryLoop;
+            op.pc = pc;
+            op.operands = {static_cast<uint8_t>(loop), counter};
+            op.opcodeLength = 1;
+            op.cycles = CYCLES[code[0]];
+
+            block.ops.push_back(op);
+            ++pc;
+        }
+    }
+
+    while (block.ops.size() < MAX_BLOCK_LENGTH) {
+        const uint8_t opcode = m_mmu.readByte(pc);
+        const uint8_t length = instructionLength(opcode);
+        if (length == 0 || pc + length - 1 > regionEnd) {
+            break;
+        }
+
+        MicroOp op{};
+        op.pc = pc;
+
+        if (opcode == static_cast<uint8_t>(OpCode::CB)) {
+            const uint8_t prefixOpcode = m_mmu.readByte(pc + 1);
+            op.handler = s_prefixHandlers[prefixOpcode];
+            op.opcodeLength = 2;
+            op.cycles = prefixCycles(prefixOpcode);
+        } else {
+            op.handler = s_handlers[opcode];
+            op.opcodeLength = 1;
+            op.cycles = CYCLES[opcode];
+            for (uint8_t i = 1; i < length; ++i) {
+                op.operands[i - 1] = m_mmu.readByte(pc + i);
+            }
+        }
+
+        block.ops.push_back(op);
+        pc += length;
+
+        if (endsBlock(opcode)) {
+            break;
+        }
+    }
+
+    block.last = pc - 1;
+    return block;
 }
 
-bool CPU::isInterruptServicable(Interrupt interrupt) const {
-    return isInterruptEnabled(interrupt) && isInterruptRequested(interrupt);
+uint8_t CPU::executeMemoryLoop(CPU& cpu) {
+    const auto loop = static_cast<MemoryLoop>(cpu.m_operands[0]);
+    const uint8_t counter = cpu.m_operands[1];
+    const MemoryLoopShape shape = shapeOf(loop, counter);
+    const uint16_t head = cpu.m_pc - 1;
+
+    Registers& registers = cpu.m_registers;
+    MMU& mmu = cpu.m_mmu;
+
+    // Iterations left, including the last one that falls out of the loop
+    uint32_t remaining;
+    if (counter == COUNT_BC) {
+        remaining = (registers.BC() == 0) ? 0x10000 : registers.BC();
+    } else {
+        const uint8_t value = registers.get(static_cast<RegisterOperand>(counter));
+        remaining = (value == 0) ? 0x100 : value;
+    }
+
+    // Run as many whole iterations as fit before the batch's deadline, as no
+    // device can do anything until then. Stepping would only have ended the
+    // batch at the deadline, so the loop must be back at its start (and not
+    // have fallen out of it) before the deadline is reached.
+    uint32_t iterations = 0;
+    if (cpu.m_inBatch && cpu.m_batchCycles < cpu.m_deadline) {
+        iterations = std::min((cpu.m_deadline - cpu.m_batchCycles - 1) / shape.cycles, remaining - 1);
+    }
+
+    if (iterations > 0) {
+        // Everything the loop reads or writes has to be plain memory, and it
+        // mustn't write over itself
+        const uint16_t hl = registers.HL();
+        const uint16_t de = registers.DE();
+
+        uint16_t writeStart = hl;
+        bool accessible = false;
+        switch (loop) {
+            case MemoryLoop::COPY_FROM_HL:
+                writeStart = de;
+                accessible = isBulkAccessible(hl, iterations, false);
+                break;
+            case MemoryLoop::COPY_FROM_DE:
+                accessible = isBulkAccessible(de, iterations, false);
+                break;
+            case MemoryLoop::FILL_UP:
+                accessible = true;
+                break;
+            case MemoryLoop::FILL_DOWN:
+                writeStart = hl - (iterations - 1);
+                accessible = hl >= iterations - 1;
+                break;
+        }
+
+        // Work RAM code can also be written through its echo, and the other
+        // way round
+        uint16_t mirror = head;
+        if (head >= 0xC000 && head <= 0xDDFF) mirror = head + 0x2000;
+        else if (head >= 0xE000 && head <= 0xFDFF) mirror = head - 0x2000;
+        auto overwrites = [&](uint16_t code) {
+            return writeStart < code + shape.length && code < writeStart + iterations;
+        };
+        const bool overwritesLoop = overwrites(head) || overwrites(mirror);
+        if (!accessible || overwritesLoop || !isBulkAccessible(writeStart, iterations, true)) {
+            iterations = 0;
+        }
+    }
+
+#ifdef BIGBOY_STATS
+    if (cpu.m_stats) {
+        cpu.m_stats->bulkIterations += iterations;
+    }
+#endif
+
+    if (iterations > 0) {
+        // In blocks through the MMU, which only goes a byte at a time through
+        // pages that are not plain memory (OAM, VRAM in mode 3, RAM holding
+        // decoded or compiled code), just as the loop would
+        std::array<uint8_t, 0x100> buffer;
+        const uint16_t hl = registers.HL();
+        const uint16_t de = registers.DE();
+        switch (loop) {
+            case MemoryLoop::COPY_FROM_HL:
+            case MemoryLoop::COPY_FROM_DE: {
+                const uint16_t source = (loop == MemoryLoop::COPY_FROM_HL) ? hl : de;
+                const uint16_t destination = (loop == MemoryLoop::COPY_FROM_HL) ? de : hl;
+
+                // A byte written ahead of the source (directly or through the
+                // echo of work RAM) is read back later in the same loop, so
+                // mustn't be written until everything before it is read
+                uint32_t chunkSize = buffer.size();
+                for (int32_t alias : {0, 0x2000, -0x2000}) {
+                    const int32_t distance = destination + alias - source;
+                    if (distance > 0 && static_cast<uint32_t>(distance) < iterations) {
+                        chunkSize = std::min<uint32_t>(chunkSize, distance);
+                    }
+                }
+
+                for (uint32_t done = 0; done < iterations;) {
+                    const uint32_t chunk = std::min(chunkSize, iterations - done);
+                    mmu.readBlock(source + done, buffer.data(), chunk);
+                    mmu.writeBlock(destination + done, buffer.data(), chunk);
+                    done += chunk;
+                }
+
+                registers.HL() = hl + iterations;
+                registers.DE() = de + iterations;
+                registers.a = buffer[(iterations - 1) % chunkSize];
+                break;
+            }
+            case MemoryLoop::FILL_UP:
+            case MemoryLoop::FILL_DOWN: {
+                const uint16_t start = (loop == MemoryLoop::FILL_UP) ? hl : hl - (iterations - 1);
+                buffer.fill(registers.a);
+                for (uint32_t done = 0; done < iterations;) {
+                    const uint32_t chunk = std::min<uint32_t>(buffer.size(), iterations - done);
+                    mmu.writeBlock(start + done, buffer.data(), chunk);
+                    done += chunk;
+                }
+
+                registers.HL() = (loop == MemoryLoop::FILL_UP) ? hl + iterations : hl - iterations;
+                break;
+            }
+        }
+
+        // The counter as it was before the last iteration, which is then
+        // counted down with the same helpers as the instructions, so that the
+        // flags come out the same
+        if (counter == COUNT_BC) {
+            registers.BC() -= iterations;
+            registers.a = registers.b;
+            cpu.bitwiseOr(registers.c);
+        } else {
+            uint8_t& value = registers.get(static_cast<RegisterOperand>(counter));
+            value -= iterations - 1;
+            cpu.decrement(value);
+        }
+    }
+
+    // Charged straight to the batch, as they may not fit in the cycles
+    // returned from a single step
+    cpu.m_batchCycles += iterations * shape.cycles;
+
+    // Carry on with the first instruction of the next iteration as usual
+    return s_handlers[shape.firstOpcode](cpu);
 }
 
-bool CPU::isInterruptEnabled(Interrupt interrupt) const {
-    uint8_t ie = m_mmu.readByte(0xFFFF);
-    auto offset = static_cast<uint8_t>(interrupt);
-    return ((ie >> offset) & 1u) != 0;
+void MCycleTiming::beginInstruction(CPU& cpu) {
+    cpu.m_busCycle = 0;
+    cpu.m_stepSynced = 0;
+    cpu.m_busTimed = true;
 }
 
-bool CPU::isInterruptRequested(Interrupt interrupt) const {
-    uint8_t if_ = m_mmu.readByte(0xFF0F);
-    auto offset = static_cast<uint8_t>(interrupt);
-    return ((if_ >> offset) & 1u) != 0;
+void MCycleTiming::fetch(CPU& cpu) {
+    cpu.m_busCycle += 4;
 }
 
-void CPU::enableInterrupt(Interrupt interrupt) {
-    uint8_t ie = m_mmu.readByte(0xFFFF);
-    auto offset = static_cast<uint8_t>(interrupt);
+void MCycleTiming::internal(CPU& cpu) {
+    cpu.m_busCycle += 4;
+}
 
-    ie |= (1u << offset);
-    m_mmu.writeByte(0xFFFF, ie);
+void MCycleTiming::access(CPU& cpu) {
+    if (!cpu.m_busTimed || !cpu.m_sync) {
+        return;
+    }
+
+    // In a batch the devices are synced to a point in the batch (see
+    // runUntil()); otherwise the caller of step() hands them whatever is
+    // left of the instruction afterwards
+    if (cpu.m_inBatch) {
+        const uint32_t target = cpu.m_batchCycles + cpu.m_busCycle;
+        if (target > cpu.m_syncedCycles) {
+            cpu.m_sync(cpu.m_syncContext, target - cpu.m_syncedCycles);
+            cpu.m_syncedCycles = target;
+        }
+    } else if (cpu.m_busCycle > cpu.m_stepSynced) {
+        cpu.m_sync(cpu.m_syncContext, cpu.m_busCycle - cpu.m_stepSynced);
+        cpu.m_stepSynced = cpu.m_busCycle;
+    }
+
+    cpu.m_busCycle += 4;
+}
+
+uint8_t CPU::readBus(uint16_t address) {
+    CPUTiming::access(*this);
+    return m_mmu.readByte(address);
+}
+
+void CPU::writeBus(uint16_t address, uint8_t value) {
+    CPUTiming::access(*this);
+    m_mmu.writeByte(address, value);
+}
+
+uint8_t CPU::nextByte() {
+    CPUTiming::fetch(*this);
+
+    if (m_operands) {
+        ++m_pc;
+        return *m_operands++;
+    }
+
+    if (static_cast<uint16_t>(m_pc - m_fetchStart) >= m_fetchSize && !mapFetchWindow(m_pc)) {
+        return m_mmu.readByte(m_pc++);
+    }
+
+    const uint8_t byte = m_fetchWindow[m_pc - m_fetchStart];
+    ++m_pc;
+    return byte;
 }
 
-void CPU::disableInterrupt(Interrupt interrupt) {
-    uint8_t ie = m_mmu.readByte(0xFFFF);
-    auto offset = static_cast<uint8_t>(interrupt);
+uint16_t CPU::nextWord() {
+    if (m_operands) {
+        CPUTiming::fetch(*this);
+        CPUTiming::fetch(*this);
+        uint16_t word = m_operands[0] | (m_operands[1] << 8u);
+        m_operands += 2;
+        m_pc += 2;
+        return word;
+    }
+
+    // Both bytes have to be in the window, or we take them one at a time
+    const uint16_t offset = m_pc - m_fetchStart;
+    if (offset + 1u < m_fetchSize) {
+        CPUTiming::fetch(*this);
+        CPUTiming::fetch(*this);
+        uint16_t word = m_fetchWindow[offset] | (m_fetchWindow[offset + 1] << 8u);
+        m_pc += 2;
+        return word;
+    }
+
+    const uint8_t lower = nextByte();
+    const uint8_t higher = nextByte();
+    return (higher << 8u) | lower;
+}
+
+bool CPU::mapFetchWindow(uint16_t address) {
+    InternalMemory& internal = m_mmu.internalMemory();
+
+    const uint8_t* window = nullptr;
+    uint16_t start = 0;
+    uint16_t size = 0;
+    if (address <= 0x3FFF) {
+        window = m_cartridge ? m_cartridge->romBankData(0) : nullptr;
+        start = 0x0000;
+        size = 0x4000;
+    } else if (address <= 0x7FFF) {
+        window = m_cartridge ? m_cartridge->romBankData(m_cartridge->romBank()) : nullptr;
+        start = 0x4000;
+        size = 0x4000;
+    } else if (address >= 0xC000 && address <= 0xDFFF) {
+        window = internal.workRam(address >= 0xD000 ? 1 : 0);
+        start = address & 0xF000u;
+        size = 0x1000;
+    } else if (address >= 0xE000 && address <= 0xFDFF) {
+        // Echo of C000-DDFF
+        window = internal.workRam(address >= 0xF000 ? 1 : 0);
+        start = address & 0xF000u;
+        size = (start == 0xF000) ? 0xE00 : 0x1000;
+    } else if (address >= 0xFF80 && address <= 0xFFFE) {
+        window = internal.highRam();
+        start = 0xFF80;
+        size = 0x7F;
+    }
+
+    if (!window) {
+        m_fetchSize = 0;
+        return false;
+    }
 
-    ie &= ~(1u << offset);
-    m_mmu.writeByte(0xFFFF, ie);
+    m_fetchWindow = window;
+    m_fetchStart = start;
+    m_fetchSize = size;
+    return true;
 }
 
 void CPU::requestInterrupt(Interrupt interrupt) {
     m_halted = false;
-    uint8_t if_ = m_mmu.readByte(0xFF0F);
-    auto offset = static_cast<uint8_t>(interrupt);
-
-    if_ |= (1u << offset);
-    m_mmu.writeByte(0xFF0F, if_);
-}
-
-void CPU::unrequestInterrupt(Interrupt interrupt) {
-    uint8_t if_ = m_mmu.readByte(0xFF0F);
-    auto offset = static_cast<uint8_t>(interrupt);
-
-    if_ &= ~(1u << offset);
-    m_mmu.writeByte(0xFF0F, if_);
-}
-
-std::string CPU::disassembleCurrent() {
-    auto current = static_cast<OpCode>(m_mmu.readByte(m_pc));
-    std::stringstream s;
-
-    s << "-- DISASSEMBLY\n";
-    s << "-- clock = " << m_clock << '\n';
-    s << "-- " //<< opCodeToString(current)
-            << '(' << (int)current << ") "
-            << '[' << (int)(m_mmu.readByte(m_pc + 1)) << "] "
-            << '[' << (int)(m_mmu.readByte(m_pc + 2)) << "]\n";
-    s << "-- b = " << (int) m_registers.b <<
-            ", c = " << (int) m_registers.c <<
-            ", bc = " << m_registers.BC() << '\n';
-    s << "-- d = " << (int) m_registers.d <<
-            ", e = " << (int) m_registers.e <<
-            ", de = " << m_registers.DE() << '\n';
-    s << "-- h = " << (int) m_registers.h <<
-            ", l = " << (int) m_registers.l <<
-            ", hl = " << m_registers.HL() << '\n';
-    s << "-- a = " << (int) m_registers.a <<
-            ", f = " << (int) m_registers.f <<
-            ", af = " << m_registers.AF() << '\n';
-    s << "-- pc = " << m_pc << ", sp = " << m_registers.sp << '\n';
-    s << "-- zero = " << m_registers.getZeroFlag() <<
-            ", subtract = " << m_registers.getSubtractFlag() <<
-            ", halfCarry = " << m_registers.getHalfCarryFlag() <<
-            ", carry = " << m_registers.getCarryFlag() << '\n';
-    s << "-- lcdc = " << (int)(m_mmu.readByte(0xFF40)) <<
-            //", stat = " << (int)(m_mmu.readByte(0xFF41)) <<
-            ", ly = " << (int)(m_mmu.readByte(0xFF44)) << '\n';
-    s << "-- ime = " << m_ime <<
-            ", ie = " << (int)(m_mmu.readByte(0xFFFF)) <<
-            ", if = " << (int)(m_mmu.readByte(0xFF0F)) << '\n';
-    s << "-- div = " << (int)(m_mmu.readByte(0xFF04)) <<
-            ", tima = " << (int)(m_mmu.readByte(0xFF05)) <<
-            ", tma = " << (int)(m_mmu.readByte(0xFF06)) << '\n';
-
-    std::ofstream outfile;
-    outfile.open("/Users/dboulton/bigboy-dump.txt", std::ios_base::app);
-    outfile << s.str();
-    outfile.close();
-
-    return s.str();
+    m_interrupts.request(interrupt);
 }
 
 void CPU::load(uint8_t& target, uint8_t value) {
     target = value;
 }
 
-uint8_t CPU::LD_r_r(RegisterOperand target, RegisterOperand value) {
+template <RegisterOperand target, RegisterOperand value>
+uint8_t CPU::LD_r_r() {
     load(m_registers.get(target), m_registers.get(value));
     return 4;
 }
 
-uint8_t CPU::LD_r_n(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::LD_r_n() {
     load(m_registers.get(target), nextByte());
     return 8;
 }
 
-uint8_t CPU::LD_r_HL(RegisterOperand target) {
-    load(m_registers.get(target), m_mmu.readByte(m_registers.HL()));
+template <RegisterOperand target>
+uint8_t CPU::LD_r_HL() {
+    load(m_registers.get(target), readBus(m_registers.HL()));
     return 8;
 }
 
-uint8_t CPU::LD_HL_r(RegisterOperand value) {
-    m_mmu.writeByte(m_registers.HL(), m_registers.get(value));
+template <RegisterOperand value>
+uint8_t CPU::LD_HL_r() {
+    writeBus(m_registers.HL(), m_registers.get(value));
     return 8;
 }
 
 uint8_t CPU::LD_HL_n() {
-    m_mmu.writeByte(m_registers.HL(), nextByte());
+    writeBus(m_registers.HL(), nextByte());
     return 12;
 }
 
 uint8_t CPU::LD_A_BC() {
-    load(m_registers.a, m_mmu.readByte(m_registers.BC()));
+    load(m_registers.a, readBus(m_registers.BC()));
     return 8;
 }
 
 uint8_t CPU::LD_A_DE() {
-    load(m_registers.a, m_mmu.readByte(m_registers.DE()));
+    load(m_registers.a, readBus(m_registers.DE()));
     return 8;
 }
 
 uint8_t CPU::LD_A_nn() {
     uint16_t nn = nextWord();
-    load(m_registers.a, m_mmu.readByte(nn));
+    load(m_registers.a, readBus(nn));
     return 16;
 }
 
 uint8_t CPU::LD_BC_A() {
-    m_mmu.writeByte(m_registers.BC(), m_registers.a);
+    writeBus(m_registers.BC(), m_registers.a);
     return 8;
 }
 
 uint8_t CPU::LD_DE_A() {
-    m_mmu.writeByte(m_registers.DE(), m_registers.a);
+    writeBus(m_registers.DE(), m_registers.a);
     return 8;
 }
 
 uint8_t CPU::LD_nn_A() {
     uint16_t nn = nextWord();
-    m_mmu.writeByte(nn, m_registers.a);
+    writeBus(nn, m_registers.a);
     return 16;
 }
 
 uint8_t CPU::LD_A_FF00n() {
-    load(m_registers.a, m_mmu.readByte(0xFF00 + nextByte()));
+    load(m_registers.a, readBus(0xFF00 + nextByte()));
     return 12;
 }
 
 uint8_t CPU::LD_FF00n_A() {
     uint16_t addr = 0xFF00 + nextByte();
-    //uint8_t dummy = m_mmu.readByte(addr);
-    //load(dummy, m_registers.a);
-    m_mmu.writeByte(addr, m_registers.a);
+    writeBus(addr, m_registers.a);
     return 12;
 }
 
 uint8_t CPU::LD_A_FF00C() {
-    load(m_registers.a, m_mmu.readByte(0xFF00 + m_registers.c));
+    load(m_registers.a, readBus(0xFF00 + m_registers.c));
     return 8;
 }
 
 uint8_t CPU::LD_FF00C_A() {
     uint16_t addr = 0xFF00 + m_registers.c;
-    uint8_t dummy = m_mmu.readByte(addr);
-    load(dummy, m_registers.a);
-    m_mmu.writeByte(addr, dummy);
+    writeBus(addr, m_registers.a);
     return 8;
 }
 
 uint8_t CPU::LDI_HL_A() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
-    load(dummy , m_registers.a);
-    m_mmu.writeByte(m_registers.HL()++, dummy);
+    writeBus(m_registers.HL()++, m_registers.a);
     return 8;
 }
 
 uint8_t CPU::LDI_A_HL() {
-    load(m_registers.a, m_mmu.readByte(m_registers.HL()));
+    load(m_registers.a, readBus(m_registers.HL()));
     ++m_registers.HL();
     return 8;
 }
 
 uint8_t CPU::LDD_HL_A() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
-    load(dummy , m_registers.a);
-    m_mmu.writeByte(m_registers.HL()--, dummy);
+    writeBus(m_registers.HL()--, m_registers.a);
     return 8;
 }
 
 uint8_t CPU::LDD_A_HL() {
-    load(m_registers.a, m_mmu.readByte(m_registers.HL()));
+    load(m_registers.a, readBus(m_registers.HL()));
     --m_registers.HL();
     return 8;
 }
@@ -1300,7 +2332,8 @@ void CPU::load(uint16_t& target, uint16_t value) {
     target = value;
 }
 
-uint8_t CPU::LD_dd_nn(RegisterPairOperand target) {
+template <RegisterPairOperand target>
+uint8_t CPU::LD_dd_nn() {
     uint16_t nn = nextWord();
 
     load(m_registers.get(target), nn);
@@ -1308,7 +2341,9 @@ uint8_t CPU::LD_dd_nn(RegisterPairOperand target) {
 }
 
 uint8_t CPU::LD_nn_SP() {
-    m_mmu.writeWord(nextWord(), m_registers.sp);
+    const uint16_t nn = nextWord();
+    writeBus(nn, m_registers.sp & 0xFFu);
+    writeBus(nn + 1, m_registers.sp >> 8u);
     return 20;
 }
 
@@ -1318,27 +2353,34 @@ uint8_t CPU::LD_SP_HL() {
 }
 
 void CPU::push(uint16_t value) {
+    // SP is decremented before the first write
+    CPUTiming::internal(*this);
+
     uint8_t high = (value >> 8u);
-    m_mmu.writeByte(--m_registers.sp, high);
+    writeBus(--m_registers.sp, high);
 
     uint8_t low = (value & 0xFFu);
-    m_mmu.writeByte(--m_registers.sp, low);
+    writeBus(--m_registers.sp, low);
 }
 
-uint8_t CPU::PUSH_qq(RegisterPairStackOperand value) {
+template <RegisterPairStackOperand value>
+uint8_t CPU::PUSH_qq() {
     push(m_registers.get(value));
     return 16;
 }
 
 void CPU::pop(uint16_t& target) {
-    target = m_mmu.readWord(m_registers.sp);
+    const uint8_t low = readBus(m_registers.sp);
+    const uint8_t high = readBus(m_registers.sp + 1);
+    target = (high << 8u) | low;
     m_registers.sp += 2;
 }
 
-uint8_t CPU::POP_qq(RegisterPairStackOperand target) {
+template <RegisterPairStackOperand target>
+uint8_t CPU::POP_qq() {
     pop(m_registers.get(target));
 
-    if (target == RegisterPairStackOperand::AF) {
+    if constexpr (target == RegisterPairStackOperand::AF) {
         m_registers.f &= 0xF0;
     }
 
@@ -1357,7 +2399,8 @@ void CPU::add(uint8_t value) {
     m_registers.a = result;
 }
 
-uint8_t CPU::ADDA_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::ADDA_r() {
     add(m_registers.get(target));
     return 4;
 }
@@ -1368,7 +2411,7 @@ uint8_t CPU::ADDA_n() {
 }
 
 uint8_t CPU::ADDA_HL() {
-    add(m_mmu.readByte(m_registers.HL()));
+    add(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1394,7 +2437,8 @@ void CPU::addWithCarry(uint8_t value) {
     m_registers.a = result;
 }
 
-uint8_t CPU::ADCA_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::ADCA_r() {
     addWithCarry(m_registers.get(target));
     return 4;
 }
@@ -1405,7 +2449,7 @@ uint8_t CPU::ADCA_n() {
 }
 
 uint8_t CPU::ADCA_HL() {
-    addWithCarry(m_mmu.readByte(m_registers.HL()));
+    addWithCarry(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1422,7 +2466,8 @@ void CPU::subtract(uint8_t value) {
     m_registers.a = result;
 }
 
-uint8_t CPU::SUB_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SUB_r() {
     subtract(m_registers.get(target));
     return 4;
 }
@@ -1433,7 +2478,7 @@ uint8_t CPU::SUB_n() {
 }
 
 uint8_t CPU::SUB_HL() {
-    subtract(m_mmu.readByte(m_registers.HL()));
+    subtract(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1454,7 +2499,8 @@ void CPU::subtractWithCarry(uint8_t value) {
     m_registers.a = static_cast<uint8_t>(iResult);
 }
 
-uint8_t CPU::SBCA_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SBCA_r() {
     subtractWithCarry(m_registers.get(target));
     return 4;
 }
@@ -1465,7 +2511,7 @@ uint8_t CPU::SBCA_n() {
 }
 
 uint8_t CPU::SBCA_HL() {
-    subtractWithCarry(m_mmu.readByte(m_registers.HL()));
+    subtractWithCarry(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1478,7 +2524,8 @@ void CPU::bitwiseAnd(uint8_t value) {
     m_registers.clearCarryFlag();
 }
 
-uint8_t CPU::AND_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::AND_r() {
     bitwiseAnd(m_registers.get(target));
     return 4;
 }
@@ -1489,7 +2536,7 @@ uint8_t CPU::AND_n() {
 }
 
 uint8_t CPU::AND_HL() {
-    bitwiseAnd(m_mmu.readByte(m_registers.HL()));
+    bitwiseAnd(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1502,7 +2549,8 @@ void CPU::bitwiseXor(uint8_t value) {
     m_registers.clearHalfCarryFlag();
 }
 
-uint8_t CPU::XOR_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::XOR_r() {
     bitwiseXor(m_registers.get(target));
     return 4;
 }
@@ -1513,7 +2561,7 @@ uint8_t CPU::XOR_n() {
 }
 
 uint8_t CPU::XOR_HL() {
-    bitwiseXor(m_mmu.readByte(m_registers.HL()));
+    bitwiseXor(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1526,7 +2574,8 @@ void CPU::bitwiseOr(uint8_t value) {
     m_registers.clearCarryFlag();
 }
 
-uint8_t CPU::OR_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::OR_r() {
     bitwiseOr(m_registers.get(target));
     return 4;
 }
@@ -1537,7 +2586,7 @@ uint8_t CPU::OR_n() {
 }
 
 uint8_t CPU::OR_HL() {
-    bitwiseOr(m_mmu.readByte(m_registers.HL()));
+    bitwiseOr(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1552,7 +2601,8 @@ void CPU::compare(uint8_t value) {
     (m_registers.a < value) ? m_registers.setCarryFlag() : m_registers.clearCarryFlag();
 }
 
-uint8_t CPU::CP_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::CP_r() {
     compare(m_registers.get(target));
     return 4;
 }
@@ -1563,7 +2613,7 @@ uint8_t CPU::CP_n() {
 }
 
 uint8_t CPU::CP_HL() {
-    compare(m_mmu.readByte(m_registers.HL()));
+    compare(readBus(m_registers.HL()));
     return 8;
 }
 
@@ -1577,15 +2627,16 @@ void CPU::increment(uint8_t &target) {
     target = result;
 }
 
-uint8_t CPU::INC_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::INC_r() {
     increment(m_registers.get(target));
     return 4;
 }
 
 uint8_t CPU::INC_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     increment(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 12;
 }
 
@@ -1599,15 +2650,16 @@ void CPU::decrement(uint8_t& target) {
     target = result;
 }
 
-uint8_t CPU::DEC_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::DEC_r() {
     decrement(m_registers.get(target));
     return 4;
 }
 
 uint8_t CPU::DEC_HL_() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     decrement(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 12;
 }
 
@@ -1664,7 +2716,8 @@ void CPU::add(uint16_t &target, uint16_t value) {
     target = result;
 }
 
-uint8_t CPU::ADD_HL_rr(RegisterPairOperand value) {
+template <RegisterPairOperand value>
+uint8_t CPU::ADD_HL_rr() {
     add(m_registers.HL(), m_registers.get(value));
     return 8;
 }
@@ -1673,7 +2726,8 @@ void CPU::increment(uint16_t& target) {
     ++target;
 }
 
-uint8_t CPU::INC_rr(RegisterPairOperand target) {
+template <RegisterPairOperand target>
+uint8_t CPU::INC_rr() {
     increment(m_registers.get(target));
     return 8;
 }
@@ -1682,7 +2736,8 @@ void CPU::decrement(uint16_t& target) {
     --target;
 }
 
-uint8_t CPU::DEC_rr(RegisterPairOperand target) {
+template <RegisterPairOperand target>
+uint8_t CPU::DEC_rr() {
     decrement(m_registers.get(target));
     return 8;
 }
@@ -1731,15 +2786,16 @@ uint8_t CPU::RLCA() {
     return 4;
 }
 
-uint8_t CPU::RLC_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::RLC_r() {
     rotateLeft(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::RLC_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     rotateLeft(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1768,15 +2824,16 @@ uint8_t CPU::RLA() {
     return 4;
 }
 
-uint8_t CPU::RL_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::RL_r() {
     rotateLeftThroughCarry(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::RL_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     rotateLeftThroughCarry(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1798,15 +2855,16 @@ uint8_t CPU::RRCA() {
     return 4;
 }
 
-uint8_t CPU::RRC_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::RRC_r() {
     rotateRight(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::RRC_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     rotateRight(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1836,15 +2894,16 @@ uint8_t CPU::RRA() {
     return 4;
 }
 
-uint8_t CPU::RR_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::RR_r() {
     rotateRightThroughCarry(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::RR_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     rotateRightThroughCarry(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1859,15 +2918,16 @@ void CPU::shiftLeft(uint8_t& target) {
     m_registers.clearSubtractFlag();
 }
 
-uint8_t CPU::SLA_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SLA_r() {
     shiftLeft(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::SLA_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     shiftLeft(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1882,15 +2942,16 @@ void CPU::swap(uint8_t& target) {
     m_registers.clearCarryFlag();
 }
 
-uint8_t CPU::SWAP_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SWAP_r() {
     swap(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::SWAP_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     swap(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1914,15 +2975,16 @@ void CPU::shiftTailRight(uint8_t& target) {
     m_registers.clearSubtractFlag();
 }
 
-uint8_t CPU::SRA_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SRA_r() {
     shiftTailRight(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::SRA_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     shiftTailRight(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1938,15 +3000,16 @@ void CPU::shiftRight(uint8_t& target) {
     m_registers.clearSubtractFlag();
 }
 
-uint8_t CPU::SRL_r(RegisterOperand target) {
+template <RegisterOperand target>
+uint8_t CPU::SRL_r() {
     shiftRight(m_registers.get(target));
     return 8;
 }
 
 uint8_t CPU::SRL_HL() {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+    uint8_t dummy = readBus(m_registers.HL());
     shiftRight(dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1959,13 +3022,15 @@ void CPU::testBit(BitOperand bit, uint8_t byte) {
     m_registers.clearSubtractFlag();
 }
 
-uint8_t CPU::BIT_b_r(BitOperand bit, RegisterOperand reg) {
+template <BitOperand bit, RegisterOperand reg>
+uint8_t CPU::BIT_b_r() {
     testBit(bit, m_registers.get(reg));
     return 8;
 }
 
-uint8_t CPU::BIT_b_HL(BitOperand bit) {
-    testBit(bit, m_mmu.readByte(m_registers.HL()));
+template <BitOperand bit>
+uint8_t CPU::BIT_b_HL() {
+    testBit(bit, readBus(m_registers.HL()));
     return 12;
 }
 
@@ -1974,15 +3039,17 @@ void CPU::setBit(BitOperand bit, uint8_t &target) {
     target |= (1u << static_cast<uint8_t>(bit));
 }
 
-uint8_t CPU::SET_b_r(BitOperand bit, RegisterOperand reg) {
+template <BitOperand bit, RegisterOperand reg>
+uint8_t CPU::SET_b_r() {
     setBit(bit, m_registers.get(reg));
     return 8;
 }
 
-uint8_t CPU::SET_b_HL(BitOperand bit) {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+template <BitOperand bit>
+uint8_t CPU::SET_b_HL() {
+    uint8_t dummy = readBus(m_registers.HL());
     setBit(bit, dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -1991,15 +3058,17 @@ void CPU::resetBit(BitOperand bit, uint8_t &target) {
     target &= ~(1u << static_cast<uint8_t>(bit));
 }
 
-uint8_t CPU::RES_b_r(BitOperand bit, RegisterOperand reg) {
+template <BitOperand bit, RegisterOperand reg>
+uint8_t CPU::RES_b_r() {
     resetBit(bit, m_registers.get(reg));
     return 8;
 }
 
-uint8_t CPU::RES_b_HL(BitOperand bit) {
-    uint8_t dummy = m_mmu.readByte(m_registers.HL());
+template <BitOperand bit>
+uint8_t CPU::RES_b_HL() {
+    uint8_t dummy = readBus(m_registers.HL());
     resetBit(bit, dummy);
-    m_mmu.writeByte(m_registers.HL(), dummy);
+    writeBus(m_registers.HL(), dummy);
     return 16;
 }
 
@@ -2064,7 +3133,8 @@ uint8_t CPU::JP_HL() {
     return 4;
 }
 
-uint8_t CPU::JP_f_nn(ConditionOperand condition) {
+template <ConditionOperand condition>
+uint8_t CPU::JP_f_nn() {
     uint16_t nn = nextWord();
 
     if (m_registers.get(condition)) {
@@ -2085,7 +3155,8 @@ uint8_t CPU::JR_PCdd() {
     return 12;
 }
 
-uint8_t CPU::JR_f_PCdd(ConditionOperand condition) {
+template <ConditionOperand condition>
+uint8_t CPU::JR_f_PCdd() {
     auto dd = static_cast<int8_t>(nextByte());
     if (m_registers.get(condition)) {
         relativeJump(dd);
@@ -2097,6 +3168,11 @@ uint8_t CPU::JR_f_PCdd(ConditionOperand condition) {
 
 void CPU::call(uint16_t address) {
     push(m_pc);
+#ifdef BIGBOY_PROFILER
+    if (m_profiler) {
+        m_profiler->onCall(bankOf(address), address, m_registers.sp);
+    }
+#endif
     absoluteJump(address);
 }
 
@@ -2107,7 +3183,8 @@ uint8_t CPU::CALL_nn() {
     return 24;
 }
 
-uint8_t CPU::CALL_f_nn(ConditionOperand condition) {
+template <ConditionOperand condition>
+uint8_t CPU::CALL_f_nn() {
     uint16_t nn = nextWord();
 
     if (m_registers.get(condition)) {
@@ -2119,6 +3196,11 @@ uint8_t CPU::CALL_f_nn(ConditionOperand condition) {
 }
 
 void CPU::ret() {
+#ifdef BIGBOY_PROFILER
+    if (m_profiler) {
+        m_profiler->onReturn(m_registers.sp);
+    }
+#endif
     pop(m_pc);
 }
 
@@ -2127,7 +3209,10 @@ uint8_t CPU::RET() {
     return 16;
 }
 
-uint8_t CPU::RET_f(ConditionOperand condition) {
+template <ConditionOperand condition>
+uint8_t CPU::RET_f() {
+    // The condition is checked in an M-cycle of its own
+    CPUTiming::internal(*this);
     if (m_registers.get(condition)) {
         ret();
         return 20;
@@ -2142,7 +3227,8 @@ uint8_t CPU::RETI() {
     return 16;
 }
 
-uint8_t CPU::RST(ResetOperand address) {
+template <ResetOperand address>
+uint8_t CPU::RST() {
     call(static_cast<uint16_t>(address));
     return 16;
 }
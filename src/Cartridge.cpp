@@ -1,5 +1,8 @@
 #include <bigboy/Cartridge.h>
 
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
+
 #include <algorithm>
 #include <fstream>
 #include <iostream>
@@ -79,10 +82,60 @@ const std::string& Cartridge::getGameTitle() const {
     return m_header.title;
 }
 
+const uint8_t* Cartridge::romBankData(uint16_t bank) const {
+    if ((bank + 1u) * 0x4000u > m_rom.size()) {
+        return nullptr;
+    }
+
+    return m_rom.data() + bank * 0x4000u;
+}
+
+uint8_t* Cartridge::ramBankData(uint8_t bank) {
+    if ((bank + 1u) * 0x2000u > m_ram.size()) {
+        return nullptr;
+    }
+
+    return m_ram.data() + bank * 0x2000u;
+}
+
+void Cartridge::attach(MMU& mmu) {
+    m_mmu = &mmu;
+    m_mmu->mapMemory(0x0000, 0x3FFF, romBankData(0), nullptr);
+    mapBanks();
+}
+
+void Cartridge::mapBanks() {
+    if (!m_mmu) {
+        return;
+    }
+
+    // Writes to the ROM are writes to the MBC's registers
+    m_mmu->mapMemory(0x4000, 0x7FFF, romBankData(romBank()), nullptr);
+    m_mmu->mapMemory(0xA000, 0xBFFF, readableRam(), writableRam());
+}
+
 NoMBC::NoMBC(std::vector<uint8_t> rom, std::vector<uint8_t> ram, CartridgeHeader header) :
         Cartridge{std::move(rom), std::move(ram), std::move(header)} {
 }
 
+uint16_t NoMBC::romBank() const {
+    return 1;
+}
+
+uint8_t* NoMBC::readableRam() {
+    switch (m_header.mbcType) {
+        case MBCType::ROM_RAM:
+        case MBCType::ROM_RAM_BATTERY:
+            return ramBankData(0);
+        default:
+            return nullptr;
+    }
+}
+
+uint8_t* NoMBC::writableRam() {
+    return readableRam();
+}
+
 uint8_t NoMBC::readByte(const uint16_t address) const {
     if (address >= 0x0000 && address <= 0x7FFF) {
         return m_rom[address];
@@ -97,8 +150,7 @@ uint8_t NoMBC::readByte(const uint16_t address) const {
         }
     }
 
-    std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-            ") does not support reading the address " << std::to_string(address) << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Cartridge");
     return 0xFF;
 }
 
@@ -108,8 +160,7 @@ void NoMBC::writeByte(const uint16_t address, const uint8_t value) {
             m_header.mbcType == MBCType::ROM_RAM_BATTERY)) {
         m_ram[address - 0xA000] = value;
     } else {
-        std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-                  ") does not support writing to the address " << std::to_string(address) << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Cartridge");
     }
 }
 
@@ -117,15 +168,32 @@ MBC1::MBC1(std::vector<uint8_t> rom, std::vector<uint8_t> ram, CartridgeHeader h
         Cartridge{std::move(rom), std::move(ram), std::move(header)} {
 }
 
+uint16_t MBC1::romBank() const {
+    return m_romRamModeSelect
+           ? ((m_ramBankNumber << 5u) | m_romBankNumber)
+           : m_romBankNumber;
+}
+
+uint8_t* MBC1::readableRam() {
+    if (!m_ramEnable ||
+            (m_header.mbcType != MBCType::MBC1_RAM &&
+            m_header.mbcType != MBCType::MBC1_RAM_BATTERY)) {
+        return nullptr;
+    }
+
+    return ramBankData(m_romRamModeSelect ? 0 : m_ramBankNumber);
+}
+
+uint8_t* MBC1::writableRam() {
+    return readableRam();
+}
+
 uint8_t MBC1::readByte(const uint16_t address) const {
     if (address >= 0x0000 && address <= 0x3FFF) {
         return m_rom[address];
     }
     if (address >= 0x4000 && address <= 0x7FFF) {
-        const uint8_t romBankNumber = m_romRamModeSelect
-                                      ? ((m_ramBankNumber << 5u) | m_romBankNumber)
-                                      : m_romBankNumber;
-        return m_rom[address - 0x4000 + 0x4000 * romBankNumber];
+        return m_rom[address - 0x4000 + 0x4000 * romBank()];
     }
     if (address >= 0xA000 && address <= 0xBFFF &&
             m_ramEnable &&
@@ -135,8 +203,7 @@ uint8_t MBC1::readByte(const uint16_t address) const {
         return m_ram[address - 0xA000 + 0x2000 * ramBankNumber];
     }
 
-    std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-              ") does not support reading the address " << std::to_string(address) << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Cartridge");
     return 0xFF;
 }
 
@@ -158,8 +225,12 @@ void MBC1::writeByte(const uint16_t address, const uint8_t value) {
         const uint8_t ramBankNumber = m_romRamModeSelect ? 0 : m_ramBankNumber;
         m_ram[address - 0xA000 + 0x2000 * ramBankNumber] = value;
     } else {
-        std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-                  ") does not support writing to the address " << std::to_string(address) << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Cartridge");
+    }
+
+    if (address <= 0x7FFF) {
+        // The banks switched in may have changed
+        mapBanks();
     }
 }
 
@@ -167,6 +238,29 @@ MBC3::MBC3(std::vector<uint8_t> rom, std::vector<uint8_t> ram, CartridgeHeader h
         Cartridge{std::move(rom), std::move(ram), std::move(header)} {
 }
 
+uint16_t MBC3::romBank() const {
+    return m_romBankNumber;
+}
+
+uint8_t* MBC3::readableRam() {
+    // The RTC registers are read through readByte()
+    if (!m_ramAndTimerEnable || m_ramBankNumberOrRtcRegisterSelect > 0x03) {
+        return nullptr;
+    }
+
+    return ramBankData(m_ramBankNumberOrRtcRegisterSelect);
+}
+
+uint8_t* MBC3::writableRam() {
+    if (m_header.mbcType != MBCType::MBC3_RAM &&
+            m_header.mbcType != MBCType::MBC3_RAM_BATTERY &&
+            m_header.mbcType != MBCType::MBC3_TIMER_RAM_BATTERY) {
+        return nullptr;
+    }
+
+    return readableRam();
+}
+
 uint8_t MBC3::readByte(uint16_t address) const {
     if (address >= 0x0000 && address <= 0x3FFF) {
         return m_rom[address];
@@ -191,8 +285,7 @@ uint8_t MBC3::readByte(uint16_t address) const {
         }
     }
 
-    std::cerr << "Memory device Cartridge (" << serialise(m_header.mbcType) <<
-              ") does not support reading the address " << std::to_string(address) << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Cartridge");
     return 0xFF;
 }
 
@@ -271,12 +364,15 @@ void MBC3::writeByte(uint16_t address, uint8_t value) {
             // Reset the clock
             clockStartTime = std::chrono::system_clock::now();
         } else {
-            std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-                      ") does not support writing to the address " << std::to_string(address) << '\n';
+            Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Cartridge");
         }
     } else {
-        std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-                  ") does not support writing to the address " << std::to_string(address) << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Cartridge");
+    }
+
+    if (address <= 0x7FFF) {
+        // The banks switched in may have changed
+        mapBanks();
     }
 }
 
@@ -284,15 +380,33 @@ MBC5::MBC5(std::vector<uint8_t> rom, std::vector<uint8_t> ram, CartridgeHeader h
         Cartridge{std::move(rom), std::move(ram), std::move(header)} {
 }
 
+uint16_t MBC5::romBank() const {
+    return (static_cast<uint16_t>(m_romBankNumberHigher) << 8u) |
+           static_cast<uint16_t>(m_romBankNumberLower);
+}
+
+uint8_t* MBC5::readableRam() {
+    if (!m_ramEnable ||
+            (m_header.mbcType != MBCType::MBC5_RAM &&
+            m_header.mbcType != MBCType::MBC5_RAM_BATTERY)) {
+        return nullptr;
+    }
+
+    return ramBankData(m_ramBankNumber);
+}
+
+uint8_t* MBC5::writableRam() {
+    // Writes are only taken for MBC1 RAM types (see writeByte()), so none get
+    // through to memory
+    return nullptr;
+}
+
 uint8_t MBC5::readByte(const uint16_t address) const {
     if (address >= 0x0000 && address <= 0x3FFF) {
         return m_rom[address];
     }
     if (address >= 0x4000 && address <= 0x7FFF) {
-        const uint16_t romBankNumber =
-                (static_cast<uint16_t>(m_romBankNumberHigher) << 8u) |
-                static_cast<uint16_t>(m_romBankNumberLower);
-        return m_rom[address - 0x4000 + 0x4000 * romBankNumber];
+        return m_rom[address - 0x4000 + 0x4000 * romBank()];
     }
     if (address >= 0xA000 && address <= 0xBFFF &&
         m_ramEnable &&
@@ -301,8 +415,7 @@ uint8_t MBC5::readByte(const uint16_t address) const {
         return m_ram[address - 0xA000 + 0x2000 * m_ramBankNumber];
     }
 
-    std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-              ") does not support reading the address " << std::to_string(address) << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Cartridge");
     return 0xFF;
 }
 
@@ -321,8 +434,12 @@ void MBC5::writeByte(const uint16_t address, const uint8_t value) {
                 m_header.mbcType == MBCType::MBC1_RAM_BATTERY)) {
         m_ram[address - 0xA000 + 0x2000 * m_ramBankNumber] = value;
     } else {
-        std::cerr << "warning: memory device Cartridge (" << serialise(m_header.mbcType) <<
-                  ") does not support writing to the address " << std::to_string(address) << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Cartridge");
+    }
+
+    if (address <= 0x7FFF) {
+        // The banks switched in may have changed
+        mapBanks();
     }
 }
 
@@ -0,0 +1,103 @@
+#include <bigboy/Diagnostics.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+Diagnostics Diagnostics::s_instance;
+
+uint64_t Diagnostics::total(Diagnostic diagnostic) const {
+    const auto& counts = m_counts[static_cast<size_t>(diagnostic)];
+    uint64_t total = 0;
+    for (uint32_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t Diagnostics::total() const {
+    uint64_t total = 0;
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind) {
+        total += this->total(static_cast<Diagnostic>(kind));
+    }
+    return total;
+}
+
+void Diagnostics::setPrintInterval(uint32_t interval) {
+    m_printing = interval > 0;
+
+    uint32_t rounded = 1;
+    while (rounded < interval && rounded < 0x80000000u) {
+        rounded <<= 1u;
+    }
+    m_printMask = rounded - 1;
+}
+
+void Diagnostics::reset() {
+    for (auto& counts : m_counts) {
+        counts.fill(0);
+    }
+}
+
+void Diagnostics::writeSummary(std::ostream& out) const {
+    // The addresses listed for each kind
+    constexpr size_t TOP_ADDRESSES = 8;
+
+    bool first = true;
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind) {
+        const auto diagnostic = static_cast<Diagnostic>(kind);
+        const auto& counts = m_counts[kind];
+
+        std::vector<uint16_t> addresses;
+        uint64_t total = 0;
+        for (uint32_t address = 0; address < counts.size(); ++address) {
+            if (counts[address] > 0) {
+                addresses.push_back(address);
+                total += counts[address];
+            }
+        }
+        if (addresses.empty()) {
+            continue;
+        }
+
+        if (first) {
+            out << "diagnostics:\n";
+            first = false;
+        }
+        out << "  " << nameOf(diagnostic) << ": " << total << " at " << addresses.size() << " address"
+            << (addresses.size() == 1 ? "" : "es") << '\n';
+
+        const size_t shown = std::min(addresses.size(), TOP_ADDRESSES);
+        std::partial_sort(addresses.begin(), addresses.begin() + shown, addresses.end(),
+                [&counts](uint16_t a, uint16_t b) { return counts[a] > counts[b]; });
+        for (size_t i = 0; i < shown; ++i) {
+            char address[8];
+            std::snprintf(address, sizeof(address), "0x%04X", addresses[i]);
+            out << "    " << address << std::setw(14) << counts[addresses[i]] << '\n';
+        }
+    }
+}
+
+const char* Diagnostics::nameOf(Diagnostic diagnostic) {
+    switch (diagnostic) {
+        case Diagnostic::UNMAPPED_READ:     return "read of an unmapped address";
+        case Diagnostic::UNMAPPED_WRITE:    return "write to an unmapped address";
+        case Diagnostic::UNSUPPORTED_READ:  return "unsupported read";
+        case Diagnostic::UNSUPPORTED_WRITE: return "unsupported write";
+        case Diagnostic::LOCKED_VRAM_READ:  return "VRAM read in mode 3";
+        case Diagnostic::LOCKED_VRAM_WRITE: return "VRAM write in mode 3";
+    }
+    return "unknown";
+}
+
+void Diagnostics::warn(Diagnostic diagnostic, uint16_t address, const char* source, uint32_t count) const {
+    char hex[8];
+    std::snprintf(hex, sizeof(hex), "0x%04X", address);
+    std::cerr << "warning: " << source << ": " << nameOf(diagnostic) << " at " << hex;
+    if (count > 1) {
+        std::cerr << " (" << count << " times)";
+    }
+    std::cerr << '\n';
+}
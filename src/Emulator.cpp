@@ -1,6 +1,13 @@
 #include <bigboy/Emulator.h>
 
+#include <algorithm>
+#ifdef BIGBOY_PROFILER
+#include <fstream>
+#endif
+
 Emulator::Emulator() {
+    m_cpu.setDeviceSync(&Emulator::syncDevices, this);
+    m_cpu.setIdleLoopDetector(&m_idleLoops);
     reset();
 }
 
@@ -8,13 +15,16 @@ void Emulator::reset() {
     m_clock = 0;
 
     m_cpu.reset();
+    m_idleLoops.reset();
     m_cartridge.reset();
+    m_cpu.setCartridge(nullptr);
     m_gpu.reset();
     m_joypad.reset();
     m_timer.reset();
     //m_serial.reset();
 
     m_mmu.reset();
+    m_mmu.registerDevice(m_cpu.interruptController());
     m_mmu.registerDevice(m_gpu);
     m_mmu.registerDevice(m_joypad);
     m_mmu.registerDevice(m_timer);
@@ -22,9 +32,33 @@ void Emulator::reset() {
 }
 
 const std::array<Colour, 160*144>& Emulator::update() {
-    while (m_clock < 70224) {
+#ifdef BIGBOY_THREADED_INTERPRETER
+#ifdef BIGBOY_JIT
+    // Compiled blocks are run from CPU::step()
+    while (m_cpu.jitEnabled() && m_clock < 70224) {
+        step();
+    }
+#endif
+#ifdef BIGBOY_AOT
+    // As are translated blocks
+    while (m_cpu.aotLoaded() && m_clock < 70224) {
         step();
     }
+#endif
+#ifdef BIGBOY_INSTRUMENTED
+    // As are the profiler, tracer and stats counters
+    while (m_cpu.instrumented() && m_clock < 70224) {
+        step();
+    }
+#endif
+    if (m_clock < 70224) {
+        m_cpu.run(&Emulator::afterStep, this);
+    }
+#else
+    while (m_clock < 70224) {
+        runBatch();
+    }
+#endif
 
     m_clock -= 70224;
     return m_gpu.getCurrentFrame();
@@ -32,6 +66,50 @@ const std::array<Colour, 160*144>& Emulator::update() {
 
 void Emulator::step() {
     const uint8_t cycles = m_cpu.step();
+    tick(cycles - m_cpu.syncedInStep());
+    skipIdle(cycles);
+}
+
+#ifdef BIGBOY_THREADED_INTERPRETER
+bool Emulator::afterStep(void* context, uint8_t cycles) {
+    auto emulator = static_cast<Emulator*>(context);
+    emulator->tick(cycles - emulator->m_cpu.syncedInStep());
+    emulator->skipIdle(cycles);
+    return emulator->m_clock < 70224;
+}
+#endif
+
+uint32_t Emulator::cyclesUntilEvent() const {
+    // Devices are next going to do something (and so need to be brought up
+    // to date) at the end of the frame, when the timer overflows or when the
+    // GPU changes mode; and a joypad interrupt is requested right away
+    if (m_joypad.interruptPending()) {
+        return 0;
+    }
+    return std::min({70224 - m_clock, m_timer.cyclesUntilInterrupt(), m_gpu.cyclesUntilTransition()});
+}
+
+void Emulator::runBatch() {
+    m_cpu.runUntil(cyclesUntilEvent());
+    m_cpu.handleInterrupts();
+
+    if (m_cpu.isHalted()) {
+        fastForward(CPU::HALTED_CYCLES, false);
+    } else if (const uint8_t iteration = m_cpu.idleIteration()) {
+        fastForward(iteration, m_idleLoops.pollsDivider());
+    }
+}
+
+void Emulator::tick(uint32_t cycles) {
+    updateDevices(cycles);
+    m_cpu.handleInterrupts();
+}
+
+void Emulator::syncDevices(void* context, uint32_t cycles) {
+    static_cast<Emulator*>(context)->updateDevices(cycles);
+}
+
+void Emulator::updateDevices(uint32_t cycles) {
     m_clock += cycles;
 
     const bool joypadRequest = m_joypad.update();
@@ -51,17 +129,112 @@ void Emulator::step() {
     if (gpuRequest.stat) {
         m_cpu.requestInterrupt(Interrupt::LCD_STAT);
     }
+}
 
-    m_cpu.handleInterrupts();
+void Emulator::skipIdle(uint8_t cycles) {
+    const uint8_t iteration = m_skipIdleLoops ? m_idleLoops.update(cycles) : 0;
+
+    if (m_cpu.isHalted()) {
+        // Only an interrupt request wakes the CPU. The joypad only requests one
+        // for input, which arrives between frames, and the serial port never does.
+        fastForward(CPU::HALTED_CYCLES, false);
+    } else if (iteration > 0) {
+        fastForward(iteration, m_idleLoops.pollsDivider());
+    }
+}
+
+void Emulator::fastForward(uint32_t period, bool untilDividerIncrement) {
+    // Nothing can change until a device event, and we must not run past the
+    // end of the frame
+    uint32_t horizon = std::min({70224 - m_clock, m_timer.cyclesUntilInterrupt(), m_gpu.cyclesUntilTransition()});
+    if (untilDividerIncrement) {
+        horizon = std::min(horizon, m_timer.cyclesUntilDividerIncrement());
+    }
+
+    // Whole periods only, finishing before the event itself
+    const uint32_t periods = (horizon > 0) ? (horizon - 1) / period : 0;
+    if (periods > 0) {
+#ifdef BIGBOY_INSTRUMENTED
+        m_cpu.onSkipped(periods * period);
+#endif
+        tick(periods * period);
+    }
 }
 
 void Emulator::handleInput(InputEvent event) {
     m_joypad.handleInput(event);
 }
 
+void Emulator::setDispatchMode(DispatchMode mode) {
+    m_cpu.setDispatchMode(mode);
+}
+
+void Emulator::setIdleLoopSkipping(bool enabled) {
+    m_skipIdleLoops = enabled;
+    m_idleLoops.reset();
+    m_cpu.setIdleLoopDetector(enabled ? &m_idleLoops : nullptr);
+}
+
+#ifdef BIGBOY_JIT
+bool Emulator::setJITEnabled(bool enabled) {
+    return m_cpu.setJITEnabled(enabled);
+}
+#endif
+
+#ifdef BIGBOY_AOT
+bool Emulator::loadAotModule(const std::string& path) {
+    return m_cpu.loadAotModule(path);
+}
+#endif
+
+#ifdef BIGBOY_PROFILER
+void Emulator::setProfilingEnabled(bool enabled) {
+    m_cpu.setProfilerEnabled(enabled);
+}
+
+bool Emulator::writeProfile(const std::string& path) {
+    Profiler* profiler = m_cpu.profiler();
+    if (!profiler) {
+        return false;
+    }
+    profiler->flush();
+
+    std::ofstream report{path};
+    profiler->writeReport(report);
+
+    std::ofstream folded{path + ".folded"};
+    profiler->writeFoldedStacks(folded);
+
+    return report.good() && folded.good();
+}
+#endif
+
+#ifdef BIGBOY_STATS
+void Emulator::setStatsEnabled(bool enabled) {
+    m_cpu.setStatsEnabled(enabled);
+}
+
+const ExecutionStats* Emulator::stats() const {
+    return m_cpu.stats();
+}
+
+void Emulator::resetStats() {
+    if (ExecutionStats* stats = m_cpu.stats()) {
+        *stats = ExecutionStats{};
+    }
+}
+#endif
+
+#ifdef BIGBOY_TRACE
+void Emulator::setTraceCapacity(size_t capacity) {
+    m_cpu.setTraceCapacity(capacity);
+}
+#endif
+
 bool Emulator::loadRomFile(const std::string& path) {
     m_cartridge = ::loadRomFile(path);
     m_mmu.registerDevice(*m_cartridge);
+    m_cpu.setCartridge(m_cartridge.get());
     return m_cartridge != nullptr;
 }
 
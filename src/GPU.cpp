@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include <bigboy/Diagnostics.h>
 #include <bigboy/MMU.h>
 
 const Colour Colour::DARKEST{
@@ -40,7 +41,7 @@ const std::array<Colour, 160 * 144>& GPU::getCurrentFrame() const {
     return m_frameBuffer;
 }
 
-GPU::Request GPU::update(uint8_t cycles) {
+GPU::Request GPU::update(uint32_t cycles) {
     if (!displayEnable()) {
         return Request{false, false};
     }
@@ -51,9 +52,44 @@ GPU::Request GPU::update(uint8_t cycles) {
 
     m_clock += cycles;
 
-    bool requestVblank = false;
-    bool requestStat = false;
+    Request request{false, false};
 
+    // The CPU may report the cycles of several instructions at once, which can
+    // span more than one mode
+    bool advanced;
+    do {
+        advanced = advanceMode(request);
+
+        // LYC STAT interrupt?
+        if (m_currentYCompare == m_currentY &&
+            statInterruptEnabled(StatInterrupt::LYC)) {
+            setCoincidenceFlag();
+            request.stat = true;
+        } else {
+            clearCoincidenceFlag();
+        }
+    } while (advanced);
+
+    return request;
+}
+
+uint32_t GPU::cyclesUntilTransition() const {
+    if (!displayEnable()) {
+        return UINT32_MAX;
+    }
+
+    uint32_t duration = 0;
+    switch (getMode()) {
+        case GPUMode::HORIZONTAL_BLANK: duration = 204; break;
+        case GPUMode::VERTICAL_BLANK:   duration = 456; break;
+        case GPUMode::SCANLINE_OAM:     duration = 80;  break;
+        case GPUMode::SCANLINE_VRAM:    duration = 172; break;
+    }
+
+    return duration > m_clock ? duration - m_clock : 0;
+}
+
+bool GPU::advanceMode(Request& request) {
     switch (getMode()) {
         case GPUMode::HORIZONTAL_BLANK:
             if (m_clock >= 204) {
@@ -62,11 +98,12 @@ GPU::Request GPU::update(uint8_t cycles) {
 
                 if (m_currentY == 144) {
                     // Request a VBLANK interrupt!
-                    requestVblank = true;
-                    requestStat = switchMode(GPUMode::VERTICAL_BLANK);
+                    request.vblank = true;
+                    request.stat |= switchMode(GPUMode::VERTICAL_BLANK);
                 } else {
-                    requestStat = switchMode(GPUMode::SCANLINE_OAM);
+                    request.stat |= switchMode(GPUMode::SCANLINE_OAM);
                 }
+                return true;
             }
             break;
         case GPUMode::VERTICAL_BLANK:
@@ -76,35 +113,29 @@ GPU::Request GPU::update(uint8_t cycles) {
 
                 if (m_currentY == 154) {
                     m_currentY = 0;
-                    requestStat = switchMode(GPUMode::SCANLINE_OAM);
+                    request.stat |= switchMode(GPUMode::SCANLINE_OAM);
                 }
+                return true;
             }
             break;
         case GPUMode::SCANLINE_OAM:
             if (m_clock >= 80) {
                 m_clock -= 80;
-                requestStat = switchMode(GPUMode::SCANLINE_VRAM);
+                request.stat |= switchMode(GPUMode::SCANLINE_VRAM);
+                return true;
             }
             break;
         case GPUMode::SCANLINE_VRAM:
             if (m_clock >= 172) {
                 m_clock -= 172;
                 renderScanline();
-                requestStat = switchMode(GPUMode::HORIZONTAL_BLANK);
+                request.stat |= switchMode(GPUMode::HORIZONTAL_BLANK);
+                return true;
             }
             break;
     }
 
-    // LYC STAT interrupt?
-    if (m_currentYCompare == m_currentY &&
-        statInterruptEnabled(StatInterrupt::LYC)) {
-        setCoincidenceFlag();
-        requestStat = true;
-    } else {
-        clearCoincidenceFlag();
-    }
-
-    return Request{requestVblank, requestStat};
+    return false;
 }
 
 void GPU::reset() {
@@ -148,7 +179,7 @@ uint8_t GPU::readByte(uint16_t address) const {
 
     if (address >= 0x8000 && address <= 0x9FFF) {
         if (getMode() == GPUMode::SCANLINE_VRAM) {
-            std::cerr << "warning: tried to read VRAM while GPU was in mode 3 (SCANLINE_VRAM)\n";
+            Diagnostics::get().report(Diagnostic::LOCKED_VRAM_READ, address, "GPU");
             return 0xFF; // Bogus value.
         }
 
@@ -157,28 +188,18 @@ uint8_t GPU::readByte(uint16_t address) const {
         return m_oam[address - 0xFE00];
     }
 
-    std::cerr << "warning: memory device GPU does not support reading the address " << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "GPU");
     return 0xFF;
 }
 
 void GPU::writeByte(uint16_t address, uint8_t value) {
     // Registers?
     switch (address) {
-        case 0xFF40: {
-            const bool wasEnabled = displayEnable();
-            m_control = value;
-            if (wasEnabled && !displayEnable()) {
-                // Display has been turned off. We need to clear the screen.
-                m_frameBuffer.fill(Colour::LIGHTEST);
-                m_currentY = 153;
-                m_clock = 456;
-                switchMode(GPUMode::VERTICAL_BLANK);
-            }
+        case 0xFF40:
+            writeControl(value);
             return;
-        }
         case 0xFF41:
-            // Only bits 3-7 are writable
-            m_status = (value & 0xF8) | (m_status & 0x07);
+            writeStatus(value);
             return;
         case 0xFF42:
             m_scrollY = value;
@@ -187,7 +208,7 @@ void GPU::writeByte(uint16_t address, uint8_t value) {
             m_scrollX = value;
             return;
         case 0xFF44:
-            m_currentY = 0;
+            writeCurrentY(value);
             return;
         case 0xFF45:
             m_currentYCompare = value;
@@ -216,7 +237,7 @@ void GPU::writeByte(uint16_t address, uint8_t value) {
 
     if (address >= 0x8000 && address <= 0x9FFF) {
         if (getMode() == GPUMode::SCANLINE_VRAM) {
-            std::cerr << "warning: tried to write to VRAM while GPU was in mode 3 (SCANLINE_VRAM)\n";
+            Diagnostics::get().report(Diagnostic::LOCKED_VRAM_WRITE, address, "GPU");
             return; // Do nothing.
         }
 
@@ -224,16 +245,59 @@ void GPU::writeByte(uint16_t address, uint8_t value) {
     } else if (address >= 0xFE00 && address <= 0xFE9F) {
         m_oam[address - 0xFE00] = value;
     } else {
-        std::cerr << "warning: memory device GPU does not support reading the address " << address << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "GPU");
     }
 }
 
-void GPU::launchDMATransfer(const uint8_t location) {
-    const uint16_t start = location << 8u;
+void GPU::attach(MMU& mmu) {
+    m_attachedMmu = &mmu;
+    mapVram();
+
+    mmu.mapIoRegister<&GPU::writeControl>(0xFF40, m_control, *this);
+    mmu.mapIoRegister<&GPU::writeStatus>(0xFF41, m_status, *this, 0x80);
+    mmu.mapIoRegister(0xFF42, m_scrollY);
+    mmu.mapIoRegister(0xFF43, m_scrollX);
+    mmu.mapIoRegister<&GPU::writeCurrentY>(0xFF44, m_currentY, *this);
+    mmu.mapIoRegister(0xFF45, m_currentYCompare);
+    mmu.mapIoRegister<&GPU::launchDMATransfer>(0xFF46, *this);
+    mmu.mapIoRegister(0xFF47, m_bgPalette);
+    mmu.mapIoRegister(0xFF48, m_spritePalette0);
+    mmu.mapIoRegister(0xFF49, m_spritePalette1);
+    mmu.mapIoRegister(0xFF4A, m_windowY);
+    mmu.mapIoRegister(0xFF4B, m_windowX);
+}
 
-    for (uint8_t i = 0; i < 160; ++i) {
-        m_oam[i] = m_mmu.readByte(start + i);
+void GPU::writeControl(uint8_t value) {
+    const bool wasEnabled = displayEnable();
+    m_control = value;
+    if (wasEnabled && !displayEnable()) {
+        // Display has been turned off. We need to clear the screen.
+        m_frameBuffer.fill(Colour::LIGHTEST);
+        m_currentY = 153;
+        m_clock = 456;
+        switchMode(GPUMode::VERTICAL_BLANK);
     }
+}
+
+void GPU::writeStatus(uint8_t value) {
+    // Only bits 3-7 are writable
+    m_status = (value & 0xF8) | (m_status & 0x07);
+}
+
+void GPU::writeCurrentY(uint8_t) {
+    // Writing resets it
+    m_currentY = 0;
+}
+
+void GPU::mapVram() {
+    if (m_attachedMmu) {
+        uint8_t* vram = getMode() == GPUMode::SCANLINE_VRAM ? nullptr : m_vram.data();
+        m_attachedMmu->mapMemory(0x8000, 0x9FFF, vram, vram);
+    }
+}
+
+void GPU::launchDMATransfer(const uint8_t location) {
+    m_mmu.readBlock(location << 8u, m_oam.data(), m_oam.size());
 
     m_dmaCountdown = 752;
 }
@@ -448,10 +512,16 @@ void GPU::renderSpriteScanline() {
 }
 
 bool GPU::switchMode(GPUMode newMode) {
+    const bool vramWasBlocked = getMode() == GPUMode::SCANLINE_VRAM;
+
     // Set the lower 2 bits of STAT to newMode
     m_status &= ~0b11u;
     m_status |= static_cast<uint8_t>(newMode);
 
+    if (vramWasBlocked != (newMode == GPUMode::SCANLINE_VRAM)) {
+        mapVram();
+    }
+
     // Should we request a STAT interrupt?
     switch (newMode) {
         case GPUMode::HORIZONTAL_BLANK: return statInterruptEnabled(StatInterrupt::HBLANK);
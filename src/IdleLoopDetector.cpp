@@ -0,0 +1,225 @@
+#include <bigboy/IdleLoopDetector.h>
+
+#include <bigboy/Cartridge.h>
+#include <bigboy/CPU.h>
+
+IdleLoopDetector::IdleLoopDetector(const CPU& cpu) : m_cpu{cpu} {
+}
+
+void IdleLoopDetector::reset() {
+    m_romLoops.fill(Loop{});
+    m_loop = Loop{};
+    m_snapshotValid = false;
+    m_cycles = 0;
+    m_pollsDivider = false;
+    m_lastPc = 0;
+}
+
+uint8_t IdleLoopDetector::update(uint8_t cycles) {
+    const uint16_t pc = m_cpu.m_pc;
+    const uint16_t lastPc = m_lastPc;
+    m_lastPc = pc;
+
+    if (m_cpu.m_halted || m_cpu.m_stopped) {
+        m_snapshotValid = false;
+        return 0;
+    }
+
+    m_cycles += cycles;
+
+    const uint16_t bank = (pc >= 0x4000 && pc <= 0x7FFF && m_cpu.m_cartridge) ? m_cpu.m_cartridge->romBank() : 0;
+    const uint32_t key = makeKey(bank, pc);
+
+    if (key != m_loop.key) {
+        // Only a jump backwards can start a loop
+        if (pc > lastPc || lastPc - pc > MAX_LOOP_BYTES) {
+            return 0;
+        }
+
+        if (pc <= 0x7FFF) {
+            Loop& cached = m_romLoops[(pc ^ bank) % m_romLoops.size()];
+            if (cached.key != key) {
+                cached = analyse(pc);
+                cached.key = key;
+            }
+            m_loop = cached;
+        } else {
+            // RAM can be rewritten, so don't hang on to what was decoded from it
+            m_loop = analyse(pc);
+            m_loop.key = key;
+        }
+
+        m_snapshotValid = m_loop.idle && takeSnapshot(m_snapshot);
+        m_cycles = 0;
+        return 0;
+    }
+
+    if (!m_loop.idle) {
+        return 0;
+    }
+
+    // Back at the start of the loop. Did the last iteration run undisturbed
+    // (no interrupt, say) and leave everything as it was?
+    Snapshot current;
+    const bool valid = takeSnapshot(current);
+    const bool unchanged = valid && m_snapshotValid && m_cycles == m_loop.cycles &&
+            sameRegisters(current.registers, m_snapshot.registers) &&
+            current.values == m_snapshot.values;
+
+    m_snapshot = current;
+    m_snapshotValid = valid;
+    m_cycles = 0;
+
+    return unchanged ? m_loop.cycles : 0;
+}
+
+IdleLoopDetector::Loop IdleLoopDetector::analyse(uint16_t head) const {
+    const MMU& mmu = m_cpu.m_mmu;
+
+    Loop loop;
+    uint16_t address = head;
+    uint32_t cycles = 0;
+
+    // Reads through a register pair are resolved at the start of the loop,
+    // so the loop must not change the pairs
+    bool writesPairs = false;
+    bool readsThroughPairs = false;
+
+    auto read = [&](ReadMode mode, uint16_t absolute = 0) {
+        loop.reads[loop.readCount++] = Read{mode, absolute};
+        readsThroughPairs |= (mode != ReadMode::ABSOLUTE);
+    };
+
+    for (uint8_t i = 0; i < MAX_LOOP_INSTRUCTIONS; ++i) {
+        const uint8_t opcode = mmu.readByte(address);
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 0b111u;
+        const uint8_t z = opcode & 0b111u;
+
+        if (opcode == static_cast<uint8_t>(OpCode::CB)) {
+            // BIT b, r / BIT b, (HL) only
+            const uint8_t prefixOpcode = mmu.readByte(address + 1);
+            if ((prefixOpcode >> 6u) != 0b01) {
+                return loop;
+            }
+            if ((prefixOpcode & 0b111u) == 0b110) {
+                read(ReadMode::HL);
+                cycles += 12;
+            } else {
+                cycles += 8;
+            }
+            address += 2;
+            continue;
+        }
+
+        const uint8_t length = CPU::lengthOf(opcode);
+        if (length == 0) {
+            return loop;
+        }
+
+        if (CPU::endsBlock(opcode)) {
+            // Which must be a jump back to the start
+            uint16_t target;
+            uint32_t taken;
+            if (x == 0b00 && z == 0b000 && y >= 3) {
+                // JR e / JR f, e
+                target = address + 2 + static_cast<int8_t>(mmu.readByte(address + 1));
+                taken = 12;
+            } else if (opcode == static_cast<uint8_t>(OpCode::JP_nn) || (x == 0b11 && z == 0b010 && y < 4)) {
+                // JP nn / JP f, nn
+                target = mmu.readWord(address + 1);
+                taken = 16;
+            } else {
+                return loop;
+            }
+
+            cycles += taken;
+            loop.idle = target == head && cycles <= UINT8_MAX && !(writesPairs && readsThroughPairs);
+            loop.cycles = static_cast<uint8_t>(cycles);
+            return loop;
+        }
+
+        if (x == 0b01) {
+            // LD r, r' / LD r, (HL); not LD (HL), r
+            if (y == 0b110) return loop;
+            if (z == 0b110) read(ReadMode::HL);
+            writesPairs |= (y != 0b111);
+        } else if (x == 0b10) {
+            // ALU A, r / ALU A, (HL)
+            if (z == 0b110) read(ReadMode::HL);
+        } else if (x == 0b00) {
+            if (z == 0b110) {
+                // LD r, n; not LD (HL), n
+                if (y == 0b110) return loop;
+                writesPairs |= (y != 0b111);
+            } else if (opcode == static_cast<uint8_t>(OpCode::LD_A_BC)) {
+                read(ReadMode::BC);
+            } else if (opcode == static_cast<uint8_t>(OpCode::LD_A_DE)) {
+                read(ReadMode::DE);
+            } else if (opcode != static_cast<uint8_t>(OpCode::NOP) &&
+                       opcode != static_cast<uint8_t>(OpCode::CPL) &&
+                       opcode != static_cast<uint8_t>(OpCode::SCF) &&
+                       opcode != static_cast<uint8_t>(OpCode::CCF)) {
+                return loop;
+            }
+        } else {
+            if (opcode == static_cast<uint8_t>(OpCode::LD_A_FF00n)) {
+                read(ReadMode::ABSOLUTE, 0xFF00 + mmu.readByte(address + 1));
+            } else if (opcode == static_cast<uint8_t>(OpCode::LD_A_nn)) {
+                read(ReadMode::ABSOLUTE, mmu.readWord(address + 1));
+            } else if (opcode == static_cast<uint8_t>(OpCode::LD_A_FF00C)) {
+                read(ReadMode::FF00_C);
+            } else if (z != 0b110) {
+                // Anything but ALU A, n
+                return loop;
+            }
+        }
+
+        cycles += CPU::cyclesOf(opcode);
+        address += length;
+    }
+
+    return loop;
+}
+
+bool IdleLoopDetector::takeSnapshot(Snapshot& snapshot) {
+    const Registers& registers = m_cpu.m_registers;
+    snapshot.registers = registers;
+
+    m_pollsDivider = false;
+    for (uint8_t i = 0; i < m_loop.readCount; ++i) {
+        const Read& read = m_loop.reads[i];
+
+        uint16_t address = read.address;
+        switch (read.mode) {
+            case ReadMode::ABSOLUTE: break;
+            case ReadMode::BC:       address = registers.BC(); break;
+            case ReadMode::DE:       address = registers.DE(); break;
+            case ReadMode::HL:       address = registers.HL(); break;
+            case ReadMode::FF00_C:   address = 0xFF00 + registers.c; break;
+        }
+
+        if (!isPollable(address)) {
+            return false;
+        }
+
+        m_pollsDivider |= (address == 0xFF04);
+        snapshot.values[i] = m_cpu.m_mmu.readByte(address);
+    }
+
+    return true;
+}
+
+bool IdleLoopDetector::isPollable(uint16_t address) {
+    // ROM, work RAM, high RAM and IE
+    if (address <= 0x7FFF) return true;
+    if (address >= 0xC000 && address <= 0xDFFF) return true;
+    if (address >= 0xFF80) return true;
+
+    // DIV, IF, STAT and LY
+    return address == 0xFF04 || address == 0xFF0F || address == 0xFF41 || address == 0xFF44;
+}
+
+bool IdleLoopDetector::sameRegisters(const Registers& a, const Registers& b) {
+    return a.AF() == b.AF() && a.BC() == b.BC() && a.DE() == b.DE() && a.HL() == b.HL() && a.sp == b.sp;
+}
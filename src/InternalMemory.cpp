@@ -1,10 +1,14 @@
 #include <bigboy/InternalMemory.h>
 
+#include <bigboy/BlockCache.h>
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
+
+#include <algorithm>
 #include <string>
-#include <iostream>
 
 std::vector<AddressSpace> InternalMemory::addressSpaces() const {
-    return {{0xC000, 0xFDFF}, {0xFF80, 0xFFFF}, {0xFF0F, 0xFF0F}};
+    return {{0xC000, 0xFDFF}, {0xFF80, 0xFFFE}};
 }
 
 uint8_t InternalMemory::readByte(uint16_t address) const {
@@ -33,47 +37,119 @@ uint8_t InternalMemory::readByte(uint16_t address) const {
         return m_hram[address - 0xFF80];
     }
 
-    // Interrupt Enable Register
-    if (address == 0xFFFF) {
-        return m_ie;
-    }
-
-    // Interrupt Flag Register
-    if (address == 0xFF0F) {
-        return m_if;
-    }
-
-    std::cerr << "warning: memory device InternalMemory does not support reading the address" << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "InternalMemory");
     return 0xFF;
 }
 
 void InternalMemory::writeByte(uint16_t address, uint8_t value) {
+    uint16_t index;
     if (address >= 0xC000 && address <= 0xCFFF) {
         // 4KB Work RAM Bank 0
         m_wram0[address - 0xC000] = value;
+        index = address - 0xC000;
     } else if (address >= 0xD000 && address <= 0xDFFF) {
         // 4KB Work RAM Bank 1
         m_wram1[address - 0xD000] = value;
+        index = address - 0xC000;
     } else if (address >= 0xE000 && address <= 0xEFFF) {
         // ECHO of C000-CFFF
         m_wram0[address - 0xE000] = value;
+        index = address - 0xE000;
     } else if (address >= 0xF000 && address <= 0xFDFF) {
         // ECHO of D000 to DDFF
         m_wram1[address - 0xF000] = value;
+        index = address - 0xE000;
     } else if (address >= 0xFF80 && address <= 0xFFFE) {
         // High RAM (HRAM)
         m_hram[address - 0xFF80] = value;
-    } else if (address == 0xFFFF) {
-        // Interrupt Enable Register
-        m_ie = value;
-    } else if (address == 0xFF0F) {
-        // Interrupt Flag Register
-        m_if = value;
+        index = HRAM_INDEX + (address - 0xFF80);
+    } else {
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "InternalMemory");
+        return;
+    }
+
+    if (isCode(index)) {
+        onCodeWrite(index);
+    }
+}
+
+void InternalMemory::attach(MMU& mmu) {
+    m_mmu = &mmu;
+    mapWorkRam(0x0000, HRAM_INDEX - 1);
+}
+
+void InternalMemory::watchCode(uint16_t start, uint16_t end) {
+    int32_t first = -1;
+    int32_t last = -1;
+    for (uint32_t address = start; address <= end; ++address) {
+        const int32_t index = codeIndex(address);
+        if (index >= 0) {
+            m_codeBits[index >> 6u] |= uint64_t{1} << (index & 63u);
+            first = (first < 0) ? index : std::min(first, index);
+            last = std::max(last, index);
+        }
+    }
+
+    if (first >= 0) {
+        mapWorkRam(first, last);
+    }
+}
+
+void InternalMemory::unwatchCode(uint16_t start, uint16_t end) {
+    int32_t first = -1;
+    int32_t last = -1;
+    for (uint32_t address = start; address <= end; ++address) {
+        const int32_t index = codeIndex(address);
+        if (index >= 0) {
+            m_codeBits[index >> 6u] &= ~(uint64_t{1} << (index & 63u));
+            first = (first < 0) ? index : std::min(first, index);
+            last = std::max(last, index);
+        }
+    }
+
+    if (first >= 0) {
+        mapWorkRam(first, last);
+    }
+}
+
+void InternalMemory::mapWorkRam(uint16_t start, uint16_t end) {
+    // High RAM shares its page with the I/O registers, so is never mapped
+    if (!m_mmu || start >= HRAM_INDEX) {
+        return;
+    }
+
+    for (uint16_t page = start >> 8u; page <= (std::min<uint16_t>(end, HRAM_INDEX - 1) >> 8u); ++page) {
+        const uint64_t* bits = &m_codeBits[page * 4];
+        const bool code = (bits[0] | bits[1] | bits[2] | bits[3]) != 0;
+
+        uint8_t* memory = (page < 0x10) ? m_wram0.data() + (page << 8u) : m_wram1.data() + ((page - 0x10) << 8u);
+        const uint16_t address = 0xC000 + (page << 8u);
+        m_mmu->mapMemory(address, address, memory, code ? nullptr : memory);
+
+        // The echo at E000-FDFF stops short of DE00-DFFF
+        if (address + 0x2000 <= 0xFDFF) {
+            m_mmu->mapMemory(address + 0x2000, address + 0x2000, memory, code ? nullptr : memory);
+        }
+    }
+}
+
+int32_t InternalMemory::codeIndex(uint16_t address) {
+    if (address >= 0xC000 && address <= 0xDFFF) return address - 0xC000;
+    if (address >= 0xE000 && address <= 0xFDFF) return address - 0xE000;
+    if (address >= 0xFF80 && address <= 0xFFFE) return HRAM_INDEX + (address - 0xFF80);
+    return -1;
+}
+
+void InternalMemory::onCodeWrite(uint16_t index) {
+    if (m_blockCache) {
+        const uint16_t address = (index < HRAM_INDEX) ? 0xC000 + index : 0xFF80 + (index - HRAM_INDEX);
+        m_blockCache->onCodeWrite(address);
     } else {
-        std::cerr << "warning: memory device InternalMemory does not support writing to the address " << address << '\n';
+        // Nothing is decoded any more
+        m_codeBits.fill(0);
+        mapWorkRam(0x0000, HRAM_INDEX - 1);
     }
 }
 
 void InternalMemory::reset() {
-    m_ie = 0x00;
 }
@@ -0,0 +1,56 @@
+#include <bigboy/InterruptController.h>
+
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
+
+std::vector<AddressSpace> InterruptController::addressSpaces() const {
+    return {AddressSpace{0xFF0F}, AddressSpace{0xFFFF}};
+}
+
+uint8_t InterruptController::readByte(uint16_t address) const {
+    switch (address) {
+        case 0xFF0F:
+            return m_if;
+        case 0xFFFF:
+            return m_ie;
+        default:
+            Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "InterruptController");
+            return 0xFF;
+    }
+}
+
+void InterruptController::writeByte(uint16_t address, uint8_t value) {
+    switch (address) {
+        case 0xFF0F:
+            m_if = value;
+            break;
+        case 0xFFFF:
+            m_ie = value;
+            break;
+        default:
+            Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "InterruptController");
+            return;
+    }
+
+    updatePending();
+}
+
+void InterruptController::attach(MMU& mmu) {
+    // IE (FFFF) is outside the I/O registers, so goes through writeByte()
+    mmu.mapIoRegister<&InterruptController::writeFlags>(0xFF0F, m_if, *this, 0xE0);
+}
+
+void InterruptController::reset() {
+    m_ie = 0x00;
+    updatePending();
+}
+
+Interrupt InterruptController::next() const {
+    // Lower bits have priority
+    uint8_t bit = 0;
+    while (((m_pending >> bit) & 1u) == 0) {
+        ++bit;
+    }
+
+    return static_cast<Interrupt>(bit);
+}
@@ -0,0 +1,934 @@
+#include <bigboy/JIT.h>
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "The JIT generates x86-64 code; configure with BIGBOY_JIT=OFF on other hosts"
+#endif
+
+#include <bigboy/Cartridge.h>
+#include <bigboy/CPU.h>
+
+#include <cstring>
+
+#include <sys/mman.h>
+
+namespace {
+    enum Reg : uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+        NO_REG = 0xFF
+    };
+
+    // Where the guest registers live while a block is running. RBX holds the
+    // context; RAX, RCX, RDX and R11 are scratch.
+    constexpr Reg GUEST_A = R12;
+    constexpr Reg GUEST_F = R13;
+    constexpr Reg GUEST_SP = R10;
+
+    // Indexed by the 3-bit register operand (see Registers.h); 110 is (HL)
+    constexpr std::array<Reg, 8> GUEST_REGISTERS{R14, R15, RSI, RDI, R8, R9, NO_REG, R12};
+
+    // Caller-saved host registers holding guest registers
+    constexpr std::array<Reg, 5> SPILLED{RSI, RDI, R8, R9, R10};
+
+    // Indexed by the register pair operand (BC, DE, HL); SP is GUEST_SP
+    constexpr std::array<Reg, 3> PAIR_HIGH{R14, RSI, R8};
+    constexpr std::array<Reg, 3> PAIR_LOW{R15, RDI, R9};
+
+    // x86 ALU operations, as the /digit of their immediate forms. The
+    // register forms are (digit << 3).
+    enum Alu : uint8_t { ADD = 0, OR = 1, ADC = 2, SBB = 3, AND = 4, SUB = 5, XOR = 6, CMP = 7 };
+
+    // Indexed by the 3-bit ALU operation encoded in the guest opcode
+    constexpr std::array<Alu, 8> GUEST_ALU{ADD, ADC, SUB, SBB, AND, XOR, OR, CMP};
+
+    enum Shift : uint8_t { SHL = 4, SHR = 5 };
+
+    enum Condition : uint8_t { JZ = 0x4, JNZ = 0x5 };
+
+    // Just enough of an x86-64 assembler for the JIT
+    class Assembler {
+    public:
+        std::vector<uint8_t> code;
+
+        size_t position() const { return code.size(); }
+
+        void byte(uint8_t value) { code.push_back(value); }
+        void word(uint16_t value) { byte(value & 0xFFu); byte(value >> 8u); }
+        void dword(uint32_t value) { word(value & 0xFFFFu); word(value >> 16u); }
+        void qword(uint64_t value) { dword(value & 0xFFFFFFFFu); dword(value >> 32u); }
+
+        // mov dst32, src32
+        void mov(Reg dst, Reg src) { rex(false, src, NO_REG, dst, false); byte(0x89); direct(src, dst); }
+
+        // mov dst64, src64
+        void mov64(Reg dst, Reg src) { rex(true, src, NO_REG, dst, false); byte(0x89); direct(src, dst); }
+
+        // mov dst32, imm32
+        void mov(Reg dst, uint32_t imm) { rex(false, 0, NO_REG, dst, false); byte(0xB8 + (dst & 7u)); dword(imm); }
+
+        // mov dst64, imm64
+        void movabs(Reg dst, uint64_t imm) { rex(true, 0, NO_REG, dst, false); byte(0xB8 + (dst & 7u)); qword(imm); }
+
+        // movzx dst32, src8
+        void movzx8(Reg dst, Reg src) { rex(false, dst, NO_REG, src, true); byte(0x0F); byte(0xB6); direct(dst, src); }
+
+        // movzx dst32, byte [base + index * scale + disp]
+        void load8(Reg dst, Reg base, Reg index, uint8_t scale, int32_t disp) {
+            rex(false, dst, index, base, false); byte(0x0F); byte(0xB6); memory(dst, base, index, scale, disp);
+        }
+
+        // movzx dst32, word [base + disp]
+        void load16(Reg dst, Reg base, int32_t disp) {
+            rex(false, dst, NO_REG, base, false); byte(0x0F); byte(0xB7); memory(dst, base, NO_REG, 0, disp);
+        }
+
+        // mov dst64, [base + index * scale + disp]
+        void load64(Reg dst, Reg base, Reg index, uint8_t scale, int32_t disp) {
+            rex(true, dst, index, base, false); byte(0x8B); memory(dst, base, index, scale, disp);
+        }
+
+        // mov byte [base + index + disp], src8
+        void store8(Reg base, Reg index, int32_t disp, Reg src) {
+            rex(false, src, index, base, true); byte(0x88); memory(src, base, index, 0, disp);
+        }
+
+        // mov word [base + disp], src16
+        void store16(Reg base, int32_t disp, Reg src) {
+            byte(0x66); rex(false, src, NO_REG, base, false); byte(0x89); memory(src, base, NO_REG, 0, disp);
+        }
+
+        // mov word [base + disp], imm16
+        void store16(Reg base, int32_t disp, uint16_t imm) {
+            byte(0x66); rex(false, 0, NO_REG, base, false); byte(0xC7); memory(0, base, NO_REG, 0, disp); word(imm);
+        }
+
+        // mov [base + disp], src64
+        void store64(Reg base, int32_t disp, Reg src) {
+            rex(true, src, NO_REG, base, false); byte(0x89); memory(src, base, NO_REG, 0, disp);
+        }
+
+        // op dst8, src8
+        void alu8(Alu op, Reg dst, Reg src) { rex(false, src, NO_REG, dst, true); byte(op << 3u); direct(src, dst); }
+
+        // op dst8, imm8
+        void alu8(Alu op, Reg dst, uint8_t imm) { rex(false, 0, NO_REG, dst, true); byte(0x80); direct(op, dst); byte(imm); }
+
+        // op dst32, src32
+        void alu32(Alu op, Reg dst, Reg src) { rex(false, src, NO_REG, dst, false); byte((op << 3u) | 1u); direct(src, dst); }
+
+        // op dst32, imm32
+        void alu32(Alu op, Reg dst, uint32_t imm) { rex(false, 0, NO_REG, dst, false); byte(0x81); direct(op, dst); dword(imm); }
+
+        // shl/shr dst32, imm8
+        void shift(Shift op, Reg dst, uint8_t imm) { rex(false, 0, NO_REG, dst, false); byte(0xC1); direct(op, dst); byte(imm); }
+
+        // inc/dec dst8
+        void inc8(Reg dst) { rex(false, 0, NO_REG, dst, true); byte(0xFE); direct(0, dst); }
+        void dec8(Reg dst) { rex(false, 0, NO_REG, dst, true); byte(0xFE); direct(1, dst); }
+
+        // test reg8, imm8
+        void test8(Reg reg, uint8_t imm) { rex(false, 0, NO_REG, reg, true); byte(0xF6); direct(0, reg); byte(imm); }
+
+        // test a64, b64
+        void test64(Reg a, Reg b) { rex(true, b, NO_REG, a, false); byte(0x85); direct(b, a); }
+
+        // bt reg32, imm8
+        void bt(Reg reg, uint8_t bit) { rex(false, 0, NO_REG, reg, false); byte(0x0F); byte(0xBA); direct(4, reg); byte(bit); }
+
+        // lahf; movzx eax, ah
+        void loadFlags() { byte(0x9F); byte(0x0F); byte(0xB6); byte(0xC4); }
+
+        void push(Reg reg) { rex(false, 0, NO_REG, reg, false); byte(0x50 + (reg & 7u)); }
+        void pop(Reg reg) { rex(false, 0, NO_REG, reg, false); byte(0x58 + (reg & 7u)); }
+
+        // call rax
+        void callRax() { byte(0xFF); byte(0xD0); }
+        void ret() { byte(0xC3); }
+
+        // Jumps with a 32-bit displacement to be filled in by bind(). Return
+        // the position of the displacement.
+        size_t jcc(Condition condition) { byte(0x0F); byte(0x80 | condition); dword(0); return position() - 4; }
+        size_t jmp() { byte(0xE9); dword(0); return position() - 4; }
+
+        // Points the jump with its displacement at `at` to `target`
+        void bind(size_t at, size_t target) {
+            const auto displacement = static_cast<uint32_t>(static_cast<int32_t>(target - (at + 4)));
+            std::memcpy(code.data() + at, &displacement, sizeof(displacement));
+        }
+        void bind(size_t at) { bind(at, position()); }
+
+    private:
+        void rex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byteRegisters) {
+            const uint8_t prefix = 0x40u
+                    | (wide ? 0x08u : 0u)
+                    | ((reg & 8u) ? 0x04u : 0u)
+                    | ((index != NO_REG && (index & 8u)) ? 0x02u : 0u)
+                    | ((base & 8u) ? 0x01u : 0u);
+            // Without a prefix, byte registers 4-7 would be AH-BH rather than SPL-DIL
+            if (prefix != 0x40u || byteRegisters) {
+                byte(prefix);
+            }
+        }
+
+        void direct(uint8_t reg, uint8_t rm) { byte(0xC0u | ((reg & 7u) << 3u) | (rm & 7u)); }
+
+        void memory(uint8_t reg, Reg base, Reg index, uint8_t scale, int32_t disp) {
+            if (index == NO_REG && (base & 7u) != RSP) {
+                byte(0x80u | ((reg & 7u) << 3u) | (base & 7u));
+            } else {
+                byte(0x80u | ((reg & 7u) << 3u) | RSP);
+                byte((scale << 6u) | (((index == NO_REG ? RSP : index) & 7u) << 3u) | (base & 7u));
+            }
+            dword(static_cast<uint32_t>(disp));
+        }
+    };
+
+    constexpr int32_t offsetOf(size_t offset) { return static_cast<int32_t>(offset); }
+
+    constexpr int32_t READ = offsetOf(offsetof(JIT::Context, read));
+    constexpr int32_t WRITE = offsetOf(offsetof(JIT::Context, write));
+    constexpr int32_t CODE_PAGES = offsetOf(offsetof(JIT::Context, codePages));
+    constexpr int32_t FLAGS = offsetOf(offsetof(JIT::Context, flags));
+    constexpr int32_t REGISTERS = offsetOf(offsetof(JIT::Context, registers));
+    constexpr int32_t HIGH_RAM = offsetOf(offsetof(JIT::Context, highRam));
+    constexpr int32_t SPILL = offsetOf(offsetof(JIT::Context, spill));
+    constexpr int32_t PC = offsetOf(offsetof(JIT::Context, pc));
+
+    uint8_t readThrough(JIT::Context* context, uint16_t address) {
+        return context->mmu->readByte(address);
+    }
+
+    void writeThrough(JIT::Context* context, uint16_t address, uint8_t value) {
+        context->mmu->writeByte(address, value);
+    }
+
+    // Translates one block. Code is generated for one instruction at a time,
+    // with the guest registers where they are expected at every boundary, so
+    // the block can be left between any two instructions.
+    class BlockCompiler {
+    public:
+        BlockCompiler(MMU& mmu, bool writeThrough) : m_mmu{mmu}, m_writeThrough{writeThrough} {}
+
+        std::vector<uint8_t> compile(uint16_t pc, uint16_t& end);
+
+    private:
+        // Emits the instruction at m_address; returns false if it is not supported
+        bool instruction(uint8_t opcode);
+
+        // Leaves the block, continuing at `pc` with `cycles` cycles taken
+        void exit(uint16_t pc, uint32_t cycles);
+
+        void prologue();
+        void epilogue();
+
+        void call(void* function);
+
+        // Composes the register pair `pair` into `dst`, and the reverse
+        void composePair(Reg dst, uint8_t pair);
+        void splitPair(uint8_t pair, Reg src);
+
+        // Memory access through the guest address in EAX
+        void load(Reg dst);
+        void store(Reg src);
+
+        // Sets Z, H and C from the host flags, and N as given
+        void setFlags(bool subtract);
+
+        void alu(uint8_t operation, Reg value);
+        void alu(uint8_t operation, uint8_t value);
+        void aluFlags(uint8_t operation);
+
+        void increment(Reg target, bool decrement);
+        void increment16(uint8_t pair, bool decrement);
+        void addHL(uint8_t pair);
+
+        void jumpIf(uint8_t condition, uint16_t target, uint16_t fallThrough, uint32_t takenCycles, uint32_t cycles);
+
+        MMU& m_mmu;
+        bool m_writeThrough;
+
+        Assembler m_asm;
+        std::vector<size_t> m_exits;
+
+        // The instruction being compiled, the bytes following its opcode, and
+        // the cycles taken by the block before it
+        uint16_t m_address = 0;
+        std::array<uint8_t, 2> m_operands{};
+        uint32_t m_cycles = 0;
+        bool m_first = true;
+
+        // Set when the instruction wrote through the MMU
+        bool m_wroteThrough = false;
+    };
+
+    // Block limits: the cycles of the whole block must fit in the 8 bits
+    // returned by CPU::step()
+    constexpr uint32_t MAX_BLOCK_CYCLES = 255 - 24;
+    constexpr uint32_t MAX_BLOCK_LENGTH = 64;
+
+    uint16_t regionEnd(uint16_t pc) {
+        if (pc <= 0x3FFF) return 0x3FFF;
+        if (pc <= 0x7FFF) return 0x7FFF;
+        return 0xDFFF;
+    }
+
+    std::vector<uint8_t> BlockCompiler::compile(uint16_t pc, uint16_t& end) {
+        prologue();
+
+        const uint16_t last = regionEnd(pc);
+        m_address = pc;
+        uint32_t count = 0;
+
+        while (true) {
+            const uint8_t opcode = m_mmu.readByte(m_address);
+            const uint8_t length = CPU::lengthOf(opcode);
+
+            if (count == MAX_BLOCK_LENGTH || m_cycles > MAX_BLOCK_CYCLES ||
+                    length == 0 || static_cast<uint32_t>(m_address) + length - 1 > last) {
+                exit(m_address, m_cycles);
+                break;
+            }
+
+            for (uint8_t i = 1; i < length; ++i) {
+                m_operands[i - 1] = m_mmu.readByte(m_address + i);
+            }
+
+            m_wroteThrough = false;
+            if (!instruction(opcode)) {
+                if (m_first) {
+                    return {};
+                }
+                // Leave it to the interpreter
+                exit(m_address, m_cycles);
+                break;
+            }
+
+            const uint16_t next = m_address + length;
+            const uint32_t cycles = m_cycles + CPU::cyclesOf(opcode);
+
+            if (CPU::endsBlock(opcode)) {
+                end = next - 1;
+                break;
+            }
+
+            if (m_wroteThrough) {
+                // The write may have requested an interrupt, switched banks or
+                // overwritten this block; none of which the rest of it expects
+                end = next - 1;
+                exit(next, cycles);
+                break;
+            }
+
+            end = next - 1;
+            m_address = next;
+            m_cycles = cycles;
+            m_first = false;
+            ++count;
+        }
+
+        epilogue();
+        return std::move(m_asm.code);
+    }
+
+    bool BlockCompiler::instruction(uint8_t opcode) {
+        const uint8_t x = opcode >> 6u;
+        const uint8_t y = (opcode >> 3u) & 7u;
+        const uint8_t z = opcode & 7u;
+        const uint8_t p = y >> 1u;
+        const bool q = y & 1u;
+
+        const uint8_t n = m_operands[0];
+        const uint16_t nn = m_operands[0] | (m_operands[1] << 8u);
+
+        if (x == 0) {
+            switch (z) {
+                case 0:
+                    if (y == 0) {
+                        // NOP
+                        return true;
+                    }
+                    if (y >= 3) {
+                        // JR e / JR f, e
+                        const uint16_t next = m_address + 2;
+                        const uint16_t target = next + static_cast<int8_t>(n);
+                        if (y == 3) {
+                            exit(target, m_cycles + 12);
+                        } else {
+                            jumpIf(y - 4, target, next, 12, 8);
+                        }
+                        return true;
+                    }
+                    return false;
+                case 1:
+                    if (!q) {
+                        // LD rr, nn
+                        if (p == 3) {
+                            m_asm.mov(GUEST_SP, static_cast<uint32_t>(nn));
+                        } else {
+                            m_asm.mov(PAIR_HIGH[p], static_cast<uint32_t>(nn >> 8u));
+                            m_asm.mov(PAIR_LOW[p], static_cast<uint32_t>(nn & 0xFFu));
+                        }
+                    } else {
+                        // ADD HL, rr
+                        addHL(p);
+                    }
+                    return true;
+                case 2:
+                    // LD (BC), A / LD (DE), A / LDI (HL), A / LDD (HL), A, and the reverse
+                    composePair(RAX, p == 3 ? 2 : p);
+                    if (q) {
+                        load(GUEST_A);
+                    } else {
+                        m_asm.mov(R11, GUEST_A);
+                        store(R11);
+                    }
+                    if (p >= 2) {
+                        increment16(2, p == 3);
+                    }
+                    return true;
+                case 3:
+                    // INC rr / DEC rr
+                    increment16(p, q);
+                    return true;
+                case 4:
+                case 5:
+                    // INC r / DEC r
+                    if (y == 6) {
+                        return false;
+                    }
+                    increment(GUEST_REGISTERS[y], z == 5);
+                    return true;
+                case 6:
+                    // LD r, n / LD (HL), n
+                    if (y == 6) {
+                        composePair(RAX, 2);
+                        m_asm.mov(R11, static_cast<uint32_t>(n));
+                        store(R11);
+                    } else {
+                        m_asm.mov(GUEST_REGISTERS[y], static_cast<uint32_t>(n));
+                    }
+                    return true;
+                case 7:
+                    switch (y) {
+                        case 5:
+                            // CPL
+                            m_asm.alu8(XOR, GUEST_A, static_cast<uint8_t>(0xFF));
+                            m_asm.alu32(OR, GUEST_F, 0x60u);
+                            return true;
+                        case 6:
+                            // SCF
+                            m_asm.alu32(AND, GUEST_F, 0x80u);
+                            m_asm.alu32(OR, GUEST_F, 0x10u);
+                            return true;
+                        case 7:
+                            // CCF
+                            m_asm.alu32(XOR, GUEST_F, 0x10u);
+                            m_asm.alu32(AND, GUEST_F, 0x90u);
+                            return true;
+                        default:
+                            return false;
+                    }
+                default:
+                    return false;
+            }
+        }
+
+        if (x == 1) {
+            // LD r, r' / LD r, (HL) / LD (HL), r
+            if (y == 6 && z == 6) {
+                // HALT
+                return false;
+            }
+            if (z == 6) {
+                composePair(RAX, 2);
+                load(GUEST_REGISTERS[y]);
+            } else if (y == 6) {
+                composePair(RAX, 2);
+                m_asm.mov(R11, GUEST_REGISTERS[z]);
+                store(R11);
+            } else if (y != z) {
+                m_asm.mov(GUEST_REGISTERS[y], GUEST_REGISTERS[z]);
+            }
+            return true;
+        }
+
+        if (x == 2) {
+            // ALU A, r / ALU A, (HL)
+            if (z == 6) {
+                composePair(RAX, 2);
+                load(RCX);
+                alu(y, RCX);
+            } else {
+                alu(y, GUEST_REGISTERS[z]);
+            }
+            return true;
+        }
+
+        switch (opcode) {
+            case 0xC3:
+                // JP nn
+                exit(nn, m_cycles + 16);
+                return true;
+            case 0xC2:
+            case 0xCA:
+            case 0xD2:
+            case 0xDA:
+                // JP f, nn
+                jumpIf(y, nn, m_address + 3, 16, 12);
+                return true;
+            case 0xC6:
+            case 0xCE:
+            case 0xD6:
+            case 0xDE:
+            case 0xE6:
+            case 0xEE:
+            case 0xF6:
+            case 0xFE:
+                // ALU A, n
+                alu(y, n);
+                return true;
+            case 0xE0:
+            case 0xF0:
+                // LD (FF00+n), A / LD A, (FF00+n)
+                if (n >= 0x80 && n != 0xFF && !(opcode == 0xE0 && m_writeThrough)) {
+                    // High RAM never needs to go through the MMU
+                    m_asm.load64(RDX, RBX, NO_REG, 0, HIGH_RAM);
+                    if (opcode == 0xE0) {
+                        m_asm.store8(RDX, NO_REG, n - 0x80, GUEST_A);
+                    } else {
+                        m_asm.load8(GUEST_A, RDX, NO_REG, 0, n - 0x80);
+                    }
+                    return true;
+                }
+                m_asm.mov(RAX, 0xFF00u + n);
+                break;
+            case 0xE2:
+            case 0xF2:
+                // LD (FF00+C), A / LD A, (FF00+C)
+                m_asm.mov(RAX, GUEST_REGISTERS[1]);
+                m_asm.alu32(OR, RAX, 0xFF00u);
+                break;
+            case 0xEA:
+            case 0xFA:
+                // LD (nn), A / LD A, (nn)
+                m_asm.mov(RAX, static_cast<uint32_t>(nn));
+                break;
+            default:
+                return false;
+        }
+
+        // Loads and stores of A through the address in EAX
+        if (opcode & 0x10u) {
+            load(GUEST_A);
+        } else {
+            m_asm.mov(R11, GUEST_A);
+            store(R11);
+        }
+        return true;
+    }
+
+    void BlockCompiler::exit(uint16_t pc, uint32_t cycles) {
+        m_asm.store16(RBX, PC, pc);
+        m_asm.mov(RAX, cycles);
+        m_exits.push_back(m_asm.jmp());
+    }
+
+    void BlockCompiler::prologue() {
+        // SysV: RBX and R12-R15 are callee-saved. Five pushes also leave the
+        // stack 16-byte aligned for calls into the MMU.
+        m_asm.push(RBX);
+        m_asm.push(R12);
+        m_asm.push(R13);
+        m_asm.push(R14);
+        m_asm.push(R15);
+        m_asm.mov64(RBX, RDI);
+
+        m_asm.load64(RAX, RBX, NO_REG, 0, REGISTERS);
+        m_asm.load8(GUEST_A, RAX, NO_REG, 0, offsetOf(offsetof(Registers, a)));
+        m_asm.load8(GUEST_F, RAX, NO_REG, 0, offsetOf(offsetof(Registers, f)));
+        m_asm.load8(GUEST_REGISTERS[0], RAX, NO_REG, 0, offsetOf(offsetof(Registers, b)));
+        m_asm.load8(GUEST_REGISTERS[1], RAX, NO_REG, 0, offsetOf(offsetof(Registers, c)));
+        m_asm.load8(GUEST_REGISTERS[2], RAX, NO_REG, 0, offsetOf(offsetof(Registers, d)));
+        m_asm.load8(GUEST_REGISTERS[3], RAX, NO_REG, 0, offsetOf(offsetof(Registers, e)));
+        m_asm.load8(GUEST_REGISTERS[4], RAX, NO_REG, 0, offsetOf(offsetof(Registers, h)));
+        m_asm.load8(GUEST_REGISTERS[5], RAX, NO_REG, 0, offsetOf(offsetof(Registers, l)));
+        m_asm.load16(GUEST_SP, RAX, offsetOf(offsetof(Registers, sp)));
+    }
+
+    void BlockCompiler::epilogue() {
+        for (size_t exit : m_exits) {
+            m_asm.bind(exit);
+        }
+
+        // EAX holds the cycles taken
+        m_asm.load64(RCX, RBX, NO_REG, 0, REGISTERS);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, a)), GUEST_A);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, f)), GUEST_F);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, b)), GUEST_REGISTERS[0]);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, c)), GUEST_REGISTERS[1]);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, d)), GUEST_REGISTERS[2]);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, e)), GUEST_REGISTERS[3]);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, h)), GUEST_REGISTERS[4]);
+        m_asm.store8(RCX, NO_REG, offsetOf(offsetof(Registers, l)), GUEST_REGISTERS[5]);
+        m_asm.store16(RCX, offsetOf(offsetof(Registers, sp)), GUEST_SP);
+
+        m_asm.pop(R15);
+        m_asm.pop(R14);
+        m_asm.pop(R13);
+        m_asm.pop(R12);
+        m_asm.pop(RBX);
+        m_asm.ret();
+    }
+
+    void BlockCompiler::call(void* function) {
+        // Arguments: RDI = context, ESI = address (from EAX), EDX = value (from R11D)
+        for (size_t i = 0; i < SPILLED.size(); ++i) {
+            m_asm.store64(RBX, SPILL + static_cast<int32_t>(i * 8), SPILLED[i]);
+        }
+        m_asm.mov(RSI, RAX);
+        m_asm.mov(RDX, R11);
+        m_asm.mov64(RDI, RBX);
+        m_asm.movabs(RAX, reinterpret_cast<uint64_t>(function));
+        m_asm.callRax();
+        for (size_t i = 0; i < SPILLED.size(); ++i) {
+            m_asm.load64(SPILLED[i], RBX, NO_REG, 0, SPILL + static_cast<int32_t>(i * 8));
+        }
+    }
+
+    void BlockCompiler::composePair(Reg dst, uint8_t pair) {
+        if (pair == 3) {
+            m_asm.mov(dst, GUEST_SP);
+            return;
+        }
+        m_asm.mov(dst, PAIR_HIGH[pair]);
+        m_asm.shift(SHL, dst, 8);
+        m_asm.alu32(OR, dst, PAIR_LOW[pair]);
+    }
+
+    void BlockCompiler::splitPair(uint8_t pair, Reg src) {
+        if (pair == 3) {
+            m_asm.mov(GUEST_SP, src);
+            return;
+        }
+        m_asm.movzx8(PAIR_LOW[pair], src);
+        m_asm.mov(PAIR_HIGH[pair], src);
+        m_asm.shift(SHR, PAIR_HIGH[pair], 8);
+    }
+
+    void BlockCompiler::load(Reg dst) {
+        m_asm.mov(RCX, RAX);
+        m_asm.shift(SHR, RCX, 12);
+        m_asm.load64(RDX, RBX, RCX, 3, READ);
+        m_asm.test64(RDX, RDX);
+        const size_t slow = m_asm.jcc(JZ);
+        m_asm.alu32(AND, RAX, 0xFFFu);
+        m_asm.load8(dst, RDX, RAX, 0, 0);
+        const size_t done = m_asm.jmp();
+
+        m_asm.bind(slow);
+        if (m_first) {
+            // The devices are up to date at the start of the block
+            call(reinterpret_cast<void*>(&readThrough));
+            m_asm.movzx8(dst, RAX);
+        } else {
+            // Let the interpreter do it once the devices have caught up
+            exit(m_address, m_cycles);
+        }
+        m_asm.bind(done);
+    }
+
+    void BlockCompiler::store(Reg src) {
+        // Code that has been compiled must hear about writes
+        m_asm.mov(RCX, RAX);
+        m_asm.shift(SHR, RCX, 8);
+        m_asm.load8(RDX, RBX, RCX, 0, CODE_PAGES);
+        m_asm.test64(RDX, RDX);
+        const size_t watched = m_asm.jcc(JNZ);
+
+        m_asm.mov(RCX, RAX);
+        m_asm.shift(SHR, RCX, 12);
+        m_asm.load64(RDX, RBX, RCX, 3, WRITE);
+        m_asm.test64(RDX, RDX);
+        const size_t slow = m_asm.jcc(JZ);
+        m_asm.alu32(AND, RAX, 0xFFFu);
+        m_asm.store8(RDX, RAX, 0, src);
+        const size_t done = m_asm.jmp();
+
+        m_asm.bind(watched);
+        m_asm.bind(slow);
+        if (m_first) {
+            call(reinterpret_cast<void*>(&writeThrough));
+            m_wroteThrough = true;
+        } else {
+            exit(m_address, m_cycles);
+        }
+        m_asm.bind(done);
+    }
+
+    void BlockCompiler::setFlags(bool subtract) {
+        m_asm.loadFlags();
+        m_asm.load8(GUEST_F, RBX, RAX, 0, FLAGS);
+        if (subtract) {
+            m_asm.alu32(OR, GUEST_F, 0x40u);
+        }
+    }
+
+    void BlockCompiler::alu(uint8_t operation, Reg value) {
+        const Alu op = GUEST_ALU[operation];
+        if (op == ADC || op == SBB) {
+            // Host carry = guest carry
+            m_asm.bt(GUEST_F, 4);
+        }
+        m_asm.alu8(op, GUEST_A, value);
+        aluFlags(operation);
+    }
+
+    void BlockCompiler::alu(uint8_t operation, uint8_t value) {
+        const Alu op = GUEST_ALU[operation];
+        if (op == ADC || op == SBB) {
+            m_asm.bt(GUEST_F, 4);
+        }
+        m_asm.alu8(op, GUEST_A, value);
+        aluFlags(operation);
+    }
+
+    void BlockCompiler::aluFlags(uint8_t operation) {
+        const Alu op = GUEST_ALU[operation];
+        setFlags(op == SUB || op == SBB || op == CMP);
+
+        if (op == AND) {
+            // Z, with H set and C reset
+            m_asm.alu32(AND, GUEST_F, 0x80u);
+            m_asm.alu32(OR, GUEST_F, 0x20u);
+        } else if (op == OR || op == XOR) {
+            m_asm.alu32(AND, GUEST_F, 0x80u);
+        }
+    }
+
+    void BlockCompiler::increment(Reg target, bool decrement) {
+        if (decrement) {
+            m_asm.dec8(target);
+        } else {
+            m_asm.inc8(target);
+        }
+
+        // Z and H as computed; C is left alone
+        m_asm.loadFlags();
+        m_asm.load8(RCX, RBX, RAX, 0, FLAGS);
+        m_asm.alu32(AND, RCX, 0xA0u);
+        m_asm.alu32(AND, GUEST_F, 0x10u);
+        m_asm.alu32(OR, GUEST_F, RCX);
+        if (decrement) {
+            m_asm.alu32(OR, GUEST_F, 0x40u);
+        }
+    }
+
+    void BlockCompiler::increment16(uint8_t pair, bool decrement) {
+        composePair(RAX, pair);
+        m_asm.alu32(decrement ? SUB : ADD, RAX, 1u);
+        m_asm.alu32(AND, RAX, 0xFFFFu);
+        splitPair(pair, RAX);
+    }
+
+    void BlockCompiler::addHL(uint8_t pair) {
+        composePair(RAX, 2);
+        composePair(RCX, pair);
+
+        // EDX = HL ^ rr ^ (HL + rr): bit 12 is the half carry and bit 16 the carry
+        m_asm.mov(RDX, RAX);
+        m_asm.alu32(XOR, RDX, RCX);
+        m_asm.alu32(ADD, RAX, RCX);
+        m_asm.alu32(XOR, RDX, RAX);
+
+        m_asm.alu32(AND, GUEST_F, 0x80u);
+        m_asm.mov(RCX, RDX);
+        m_asm.shift(SHR, RCX, 7);
+        m_asm.alu32(AND, RCX, 0x20u);
+        m_asm.alu32(OR, GUEST_F, RCX);
+        m_asm.mov(RCX, RDX);
+        m_asm.shift(SHR, RCX, 12);
+        m_asm.alu32(AND, RCX, 0x10u);
+        m_asm.alu32(OR, GUEST_F, RCX);
+
+        m_asm.alu32(AND, RAX, 0xFFFFu);
+        splitPair(2, RAX);
+    }
+
+    void BlockCompiler::jumpIf(uint8_t condition, uint16_t target, uint16_t fallThrough,
+                               uint32_t takenCycles, uint32_t cycles) {
+        // NZ, Z, NC, C
+        m_asm.test8(GUEST_F, (condition & 2u) ? 0x10u : 0x80u);
+        const size_t taken = m_asm.jcc((condition & 1u) ? JNZ : JZ);
+        exit(fallThrough, m_cycles + cycles);
+        m_asm.bind(taken);
+        exit(target, m_cycles + takenCycles);
+    }
+}
+
+JIT::JIT(CPU& cpu) : m_cpu{cpu} {
+    void* code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code != MAP_FAILED) {
+        m_code = static_cast<uint8_t*>(code);
+    }
+
+    // LAHF: SF ZF 0 AF 0 PF 1 CF
+    for (uint16_t ah = 0; ah < 256; ++ah) {
+        m_context.flags[ah] = ((ah & 0x40u) ? 0x80u : 0u) | ((ah & 0x10u) ? 0x20u : 0u) | ((ah & 0x01u) ? 0x10u : 0u);
+    }
+
+    m_context.registers = &cpu.m_registers;
+    m_context.mmu = &cpu.m_mmu;
+    m_context.highRam = cpu.m_mmu.internalMemory().highRam();
+
+    clear();
+}
+
+JIT::~JIT() {
+    if (m_code) {
+        munmap(m_code, CODE_SIZE);
+    }
+}
+
+uint8_t JIT::execute() {
+    const Cartridge* cartridge = m_cpu.m_cartridge;
+    if (!m_code || !cartridge) {
+        return 0;
+    }
+
+    // Only ROM and work RAM are compiled
+    const uint16_t pc = m_cpu.m_pc;
+    uint16_t bank = 0;
+    if (pc >= 0x4000 && pc <= 0x7FFF) {
+        bank = cartridge->romBank();
+    } else if (pc >= 0x8000 && (pc < 0xC000 || pc > 0xDFFF)) {
+        return 0;
+    }
+
+    const uint32_t key = makeKey(bank, pc);
+    Entry* entry = &m_entries[indexOf(key)];
+    if (entry->key != key) {
+        *entry = Entry{key};
+    }
+
+    if (!entry->code) {
+        if (entry->failed || ++entry->hits < HOT_THRESHOLD) {
+            return 0;
+        }
+
+        uint16_t end = pc;
+        NativeBlock code = compile(pc, end);
+
+        // Compiling may have flushed everything, this entry included
+        entry = &m_entries[indexOf(key)];
+        entry->key = key;
+        if (!code) {
+            entry->failed = true;
+            return 0;
+        }
+        entry->code = code;
+
+        // Code in RAM can be overwritten, so keep an eye on it
+        if (pc >= 0xC000) {
+            for (uint32_t page = pc >> 8u; page <= (end >> 8u); ++page) {
+                m_pageKeys[page].push_back(key);
+                if (!m_context.codePages[page]) {
+                    m_context.codePages[page] = 1;
+                    watchPage(page, true);
+                }
+            }
+        }
+    }
+
+    mapRomBank();
+
+    const uint8_t cycles = entry->code(&m_context);
+    m_cpu.m_pc = m_context.pc;
+    return cycles;
+}
+
+void JIT::clear() {
+    m_entries.fill(Entry{});
+    for (std::vector<uint32_t>& keys : m_pageKeys) {
+        keys.clear();
+    }
+    for (uint32_t page = 0; page < m_context.codePages.size(); ++page) {
+        if (m_context.codePages[page]) {
+            watchPage(page, false);
+        }
+    }
+    m_context.codePages.fill(0);
+    m_codeUsed = 0;
+
+    // The block cache watches writes to RAM it has decoded, so they have to go
+    // through the MMU while it is in use
+    m_writeThrough = m_cpu.m_dispatchMode == DispatchMode::BLOCK_CACHE;
+
+    InternalMemory& internal = m_cpu.m_mmu.internalMemory();
+    m_context.read.fill(nullptr);
+    m_context.write.fill(nullptr);
+    m_context.read[0xC] = internal.workRam(0);
+    m_context.read[0xD] = internal.workRam(1);
+    if (!m_writeThrough) {
+        m_context.write[0xC] = internal.workRam(0);
+        m_context.write[0xD] = internal.workRam(1);
+    }
+
+    m_mappedBank = 0xFFFF;
+}
+
+JIT::NativeBlock JIT::compile(uint16_t pc, uint16_t& end) {
+    BlockCompiler compiler{m_cpu.m_mmu, m_writeThrough};
+    const std::vector<uint8_t> code = compiler.compile(pc, end);
+    if (code.empty() || code.size() > CODE_SIZE) {
+        return nullptr;
+    }
+
+    if (m_codeUsed + code.size() > CODE_SIZE) {
+        clear();
+    }
+
+    uint8_t* block = m_code + m_codeUsed;
+    std::memcpy(block, code.data(), code.size());
+    m_codeUsed += code.size();
+    return reinterpret_cast<NativeBlock>(block);
+}
+
+void JIT::invalidatePage(uint8_t page) {
+    for (uint32_t key : m_pageKeys[page]) {
+        Entry& entry = m_entries[indexOf(key)];
+        if (entry.key == key) {
+            entry = Entry{};
+        }
+    }
+    m_pageKeys[page].clear();
+    m_context.codePages[page] = 0;
+    watchPage(page, false);
+}
+
+void JIT::watchPage(uint8_t page, bool watched) {
+    MMU& mmu = m_cpu.m_mmu;
+    mmu.watchWrites(page, watched);
+
+    // E000-FDFF echoes C000-DDFF
+    if (page >= 0xC0 && page <= 0xDD) {
+        mmu.watchWrites(page + 0x20, watched);
+    } else if (page >= 0xE0 && page <= 0xFD) {
+        mmu.watchWrites(page - 0x20, watched);
+    }
+}
+
+void JIT::mapRomBank() {
+    const Cartridge* cartridge = m_cpu.m_cartridge;
+    const uint16_t bank = cartridge->romBank();
+    if (bank == m_mappedBank) {
+        return;
+    }
+
+    const uint8_t* rom0 = cartridge->romBankData(0);
+    const uint8_t* romN = cartridge->romBankData(bank);
+    for (uint8_t region = 0; region < 4; ++region) {
+        m_context.read[region] = rom0 ? rom0 + region * 0x1000 : nullptr;
+        m_context.read[region + 4] = romN ? romN + region * 0x1000 : nullptr;
+    }
+    m_mappedBank = bank;
+}
@@ -1,5 +1,8 @@
 #include <bigboy/Joypad.h>
 
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
+
 #include <iostream>
 
 bool Joypad::update() {
@@ -103,27 +106,33 @@ uint8_t Joypad::readByte(const uint16_t address) const {
         return m_joyp;
     }
 
-    std::cerr << "warning: memory device Joypad does not support reading the address " <<
-            address << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Joypad");
     return 0xFF; // Bogus value
 }
 
 void Joypad::writeByte(const uint16_t address, const uint8_t value) {
     if (address == 0xFF00) {
-        // Bits 4 & 5 are writable
-        constexpr uint8_t mask = 0b00110000;
-
-        // Clear & set
-        m_joyp &= ~mask;
-        m_joyp |= (value & mask);
-        updateRegister();
+        writeSelect(value);
     } else {
-        std::cerr << "warning: memory device Joypad does not support writing to the address " <<
-                  address << '\n';
+        Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Joypad");
         // Do nothing
     }
 }
 
+void Joypad::attach(MMU& mmu) {
+    mmu.mapIoRegister<&Joypad::writeSelect>(0xFF00, m_joyp, *this, 0xC0);
+}
+
+void Joypad::writeSelect(uint8_t value) {
+    // Bits 4 & 5 are writable
+    constexpr uint8_t mask = 0b00110000;
+
+    // Clear & set
+    m_joyp &= ~mask;
+    m_joyp |= (value & mask);
+    updateRegister();
+}
+
 void Joypad::reset() {
     m_joyp = 0;
     m_keys = {};
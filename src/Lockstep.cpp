@@ -0,0 +1,432 @@
+#include <bigboy/Lockstep.h>
+
+#include <algorithm>
+
+namespace {
+    constexpr uint8_t ZERO = 0x80;
+    constexpr uint8_t SUBTRACT = 0x40;
+    constexpr uint8_t HALF_CARRY = 0x20;
+    constexpr uint8_t CARRY = 0x10;
+
+    // Longest run of instructions executed for a group before its lanes catch
+    // up with their devices, so that the cycles fit a step's (see
+    // Emulator::skipIdle())
+    constexpr uint32_t MAX_RUN_CYCLES = 240;
+
+    // The register encoded in bits 0-2 or 3-5 of an opcode; 6 is (HL)
+    constexpr RegisterOperand REGISTERS[8] = {
+            RegisterOperand::B, RegisterOperand::C, RegisterOperand::D, RegisterOperand::E,
+            RegisterOperand::H, RegisterOperand::L, RegisterOperand::A, RegisterOperand::A
+    };
+
+    uint8_t zero(uint8_t value) {
+        return value == 0 ? ZERO : 0;
+    }
+
+    // Is the whole of an instruction of `length` bytes at `pc` in the same
+    // ROM region? Every lane has the same ROM, so it reads the same for all.
+    bool inRom(uint16_t pc, uint8_t length) {
+        const uint16_t end = pc + length - 1;
+        return end <= 0x7FFF && end >= pc && (pc <= 0x3FFF) == (end <= 0x3FFF);
+    }
+
+    // The 8 bit ALU operations on A (ADD, ADC, SUB, SBC, AND, XOR, OR, CP
+    // by bits 3-5 of the opcode), each a loop over the lanes with `value(i)`
+    // as lane i's operand. The flags are worked out as CPU::add() and friends
+    // do.
+    template <typename Value>
+    void alu(uint8_t operation, uint8_t* a, uint8_t* f, size_t count, Value value) {
+        switch (operation) {
+            case 0:
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t v = value(i);
+                    const unsigned result = a[i] + v;
+                    f[i] = zero(result & 0xFFu) | ((a[i] ^ v ^ result) & 0x10u) << 1u | (result >> 8u) << 4u |
+                           (f[i] & 0x0Fu);
+                    a[i] = result;
+                }
+                return;
+            case 1:
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t v = value(i);
+                    const unsigned carry = (f[i] >> 4u) & 1u;
+                    const unsigned result = a[i] + v + carry;
+                    f[i] = zero(result & 0xFFu) | ((a[i] ^ v ^ result) & 0x10u) << 1u | (result >> 8u) << 4u |
+                           (f[i] & 0x0Fu);
+                    a[i] = result;
+                }
+                return;
+            case 2:
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t v = value(i);
+                    const uint8_t result = a[i] - v;
+                    f[i] = zero(result) | SUBTRACT | ((a[i] & 0x0Fu) < (v & 0x0Fu) ? HALF_CARRY : 0) |
+                           (a[i] < v ? CARRY : 0) | (f[i] & 0x0Fu);
+                    a[i] = result;
+                }
+                return;
+            case 3:
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t v = value(i);
+                    const unsigned carry = (f[i] >> 4u) & 1u;
+                    const unsigned result = a[i] - v - carry;
+                    f[i] = zero(result & 0xFFu) | SUBTRACT | ((a[i] ^ v ^ result) & 0x10u) << 1u |
+                           ((result >> 8u) & 1u) << 4u | (f[i] & 0x0Fu);
+                    a[i] = result;
+                }
+                return;
+            case 4:
+                for (size_t i = 0; i < count; ++i) {
+                    a[i] &= value(i);
+                    f[i] = zero(a[i]) | HALF_CARRY | (f[i] & 0x0Fu);
+                }
+                return;
+            case 5:
+                for (size_t i = 0; i < count; ++i) {
+                    a[i] ^= value(i);
+                    f[i] = zero(a[i]) | (f[i] & 0x0Fu);
+                }
+                return;
+            case 6:
+                for (size_t i = 0; i < count; ++i) {
+                    a[i] |= value(i);
+                    f[i] = zero(a[i]) | (f[i] & 0x0Fu);
+                }
+                return;
+            default:
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t v = value(i);
+                    f[i] = zero(a[i] - v) | SUBTRACT | ((a[i] & 0x0Fu) < (v & 0x0Fu) ? HALF_CARRY : 0) |
+                           (a[i] < v ? CARRY : 0) | (f[i] & 0x0Fu);
+                }
+                return;
+        }
+    }
+}
+
+void Lockstep::LaneRegisters::resize(size_t lanes) {
+    for (std::vector<uint8_t>* registers : {&a, &f, &b, &c, &d, &e, &h, &l}) {
+        registers->resize(lanes);
+    }
+    sp.resize(lanes);
+}
+
+uint8_t* Lockstep::LaneRegisters::get(RegisterOperand target) {
+    switch (target) {
+        case RegisterOperand::B: return b.data();
+        case RegisterOperand::C: return c.data();
+        case RegisterOperand::D: return d.data();
+        case RegisterOperand::E: return e.data();
+        case RegisterOperand::H: return h.data();
+        case RegisterOperand::L: return l.data();
+        case RegisterOperand::A: return a.data();
+    }
+    return nullptr;
+}
+
+Lockstep::Lockstep(size_t lanes) {
+    for (size_t i = 0; i < lanes; ++i) {
+        m_lanes.push_back(std::make_unique<Emulator>());
+    }
+    m_group.reserve(lanes);
+    m_registers.resize(lanes);
+}
+
+bool Lockstep::loadRomFile(const std::string& path) {
+    for (std::unique_ptr<Emulator>& lane : m_lanes) {
+        if (!lane->loadRomFile(path)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Lockstep::update() {
+    while (true) {
+        // Whichever lane is furthest behind goes next, so that lanes on the
+        // same path meet at the same instructions
+        Emulator* leader = nullptr;
+        for (std::unique_ptr<Emulator>& lane : m_lanes) {
+            if (lane->m_clock < 70224 && (!leader || lane->m_clock < leader->m_clock)) {
+                leader = lane.get();
+            }
+        }
+        if (!leader) {
+            break;
+        }
+
+        step(*leader);
+    }
+
+    for (std::unique_ptr<Emulator>& lane : m_lanes) {
+        lane->m_clock -= 70224;
+    }
+}
+
+const std::array<Colour, 160*144>& Lockstep::frame(size_t lane) const {
+    return m_lanes[lane]->m_gpu.getCurrentFrame();
+}
+
+bool Lockstep::vectorizable(uint8_t opcode) {
+    const uint8_t x = opcode >> 6u;
+    const uint8_t y = (opcode >> 3u) & 7u;
+    const uint8_t z = opcode & 7u;
+
+    switch (x) {
+        case 0:
+            switch (z) {
+                case 0: return y == 0;                  // NOP
+                case 1: return true;                    // LD rr,nn and ADD HL,rr
+                case 3: return true;                    // INC rr, DEC rr
+                case 4: case 5: case 6: return y != 6;  // INC r, DEC r, LD r,n
+                case 7: return y <= 3 || y >= 5;        // Rotates of A, CPL, SCF, CCF (not DAA)
+                default: return false;
+            }
+        case 1: return y != 6 && z != 6;                // LD r,r
+        case 2: return z != 6;                          // ALU A,r
+        default: return z == 6;                         // ALU A,n
+    }
+}
+
+bool Lockstep::canGroup(const Emulator& lane) {
+    const CPU& cpu = lane.m_cpu;
+    if (cpu.m_halted || cpu.m_stopped || (cpu.m_ime && cpu.m_interrupts.pending())) {
+        return false;
+    }
+#ifdef BIGBOY_INSTRUMENTED
+    // The profiler and tracer have to see every instruction
+    if (cpu.instrumented()) {
+        return false;
+    }
+#endif
+    return lane.cyclesUntilEvent() > 0;
+}
+
+void Lockstep::step(Emulator& leader) {
+    const CPU& cpu = leader.m_cpu;
+    const uint16_t pc = cpu.m_pc;
+
+    m_group.clear();
+    const uint8_t opcode = inRom(pc, 1) ? leader.m_mmu.readByte(pc) : 0;
+    if (inRom(pc, 1) && vectorizable(opcode) && inRom(pc, CPU::lengthOf(opcode)) && canGroup(leader)) {
+        const uint16_t bank = (pc >= 0x4000 && cpu.m_cartridge) ? cpu.m_cartridge->romBank() : 0;
+        for (std::unique_ptr<Emulator>& lane : m_lanes) {
+            const CPU& other = lane->m_cpu;
+            if (other.m_pc == pc && lane->m_clock < 70224 && canGroup(*lane) &&
+                    (pc < 0x4000 || !other.m_cartridge || other.m_cartridge->romBank() == bank)) {
+                m_group.push_back(lane.get());
+            }
+        }
+    }
+
+    // Lanes that are on their own go through their CPU as usual
+    if (m_group.size() < 2) {
+        leader.step();
+        ++m_stats.scalarSteps;
+        return;
+    }
+
+    runGroup(pc);
+}
+
+void Lockstep::runGroup(uint16_t pc) {
+    const size_t count = m_group.size();
+    const MMU& mmu = m_group.front()->m_mmu;
+
+    uint32_t deadline = 0xFFFFFFFF;
+    for (size_t i = 0; i < count; ++i) {
+        Emulator& lane = *m_group[i];
+        deadline = std::min(deadline, lane.cyclesUntilEvent());
+
+        Registers& registers = lane.m_cpu.m_registers;
+        m_registers.a[i] = registers.a;
+        m_registers.f[i] = registers.f;
+        m_registers.b[i] = registers.b;
+        m_registers.c[i] = registers.c;
+        m_registers.d[i] = registers.d;
+        m_registers.e[i] = registers.e;
+        m_registers.h[i] = registers.h;
+        m_registers.l[i] = registers.l;
+        m_registers.sp[i] = registers.sp;
+    }
+
+    // As in CPU::runUntil(), the instruction that reaches the deadline is the
+    // last; none of these can move it
+    uint32_t cycles = 0;
+    while (cycles < deadline && cycles < MAX_RUN_CYCLES) {
+        const uint8_t opcode = mmu.readByte(pc);
+        const uint8_t length = CPU::lengthOf(opcode);
+        if (!vectorizable(opcode) || !inRom(pc, length)) {
+            break;
+        }
+
+        uint16_t operand = 0;
+        if (length >= 2) {
+            operand = mmu.readByte(pc + 1);
+        }
+        if (length == 3) {
+            operand |= mmu.readByte(pc + 2) << 8u;
+        }
+
+        cycles += execute(opcode, operand, count);
+        pc += length;
+
+        ++m_stats.vectorSteps;
+        m_stats.vectorLaneSteps += count;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        Emulator& lane = *m_group[i];
+
+        Registers& registers = lane.m_cpu.m_registers;
+        registers.a = m_registers.a[i];
+        registers.f = m_registers.f[i];
+        registers.b = m_registers.b[i];
+        registers.c = m_registers.c[i];
+        registers.d = m_registers.d[i];
+        registers.e = m_registers.e[i];
+        registers.h = m_registers.h[i];
+        registers.l = m_registers.l[i];
+        registers.sp = m_registers.sp[i];
+        lane.m_cpu.m_pc = pc;
+
+        lane.tick(cycles);
+        lane.skipIdle(cycles);
+    }
+}
+
+uint8_t Lockstep::execute(uint8_t opcode, uint16_t operand, size_t count) {
+    const uint8_t x = opcode >> 6u;
+    const uint8_t y = (opcode >> 3u) & 7u;
+    const uint8_t z = opcode & 7u;
+
+    uint8_t* a = m_registers.a.data();
+    uint8_t* f = m_registers.f.data();
+
+    // The register pair encoded in bits 4-5, as its high and low halves
+    // (nullptr for SP)
+    uint8_t* high = nullptr;
+    uint8_t* low = nullptr;
+    switch (y >> 1u) {
+        case 0: high = m_registers.b.data(); low = m_registers.c.data(); break;
+        case 1: high = m_registers.d.data(); low = m_registers.e.data(); break;
+        case 2: high = m_registers.h.data(); low = m_registers.l.data(); break;
+        default: break;
+    }
+    uint16_t* sp = m_registers.sp.data();
+
+    if (x == 1) {
+        uint8_t* target = m_registers.get(REGISTERS[y]);
+        const uint8_t* value = m_registers.get(REGISTERS[z]);
+        if (target != value) {
+            std::copy(value, value + count, target);
+        }
+    } else if (x == 2) {
+        const uint8_t* value = m_registers.get(REGISTERS[z]);
+        alu(y, a, f, count, [value](size_t i) { return value[i]; });
+    } else if (x == 3) {
+        const auto n = static_cast<uint8_t>(operand);
+        alu(y, a, f, count, [n](size_t) { return n; });
+    } else if (z == 1 && !(y & 1u)) {
+        // LD rr,nn
+        if (high) {
+            std::fill(high, high + count, static_cast<uint8_t>(operand >> 8u));
+            std::fill(low, low + count, static_cast<uint8_t>(operand));
+        } else {
+            std::fill(sp, sp + count, operand);
+        }
+    } else if (z == 1) {
+        // ADD HL,rr
+        uint8_t* h = m_registers.h.data();
+        uint8_t* l = m_registers.l.data();
+        for (size_t i = 0; i < count; ++i) {
+            const uint16_t hl = (h[i] << 8u) | l[i];
+            const uint16_t value = high ? (high[i] << 8u) | low[i] : sp[i];
+            const uint16_t result = hl + value;
+            f[i] = (f[i] & (ZERO | 0x0Fu)) | (((result ^ hl ^ value) & 0x1000u) ? HALF_CARRY : 0) |
+                   (result < hl ? CARRY : 0);
+            h[i] = result >> 8u;
+            l[i] = result;
+        }
+    } else if (z == 3) {
+        // INC rr, DEC rr
+        const uint16_t delta = (y & 1u) ? 0xFFFF : 1;
+        if (high) {
+            for (size_t i = 0; i < count; ++i) {
+                const uint16_t result = ((high[i] << 8u) | low[i]) + delta;
+                high[i] = result >> 8u;
+                low[i] = result;
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                sp[i] += delta;
+            }
+        }
+    } else if (z == 4) {
+        uint8_t* target = m_registers.get(REGISTERS[y]);
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t result = target[i] + 1;
+            f[i] = zero(result) | ((target[i] & 0x0Fu) == 0x0F ? HALF_CARRY : 0) | (f[i] & (CARRY | 0x0Fu));
+            target[i] = result;
+        }
+    } else if (z == 5) {
+        uint8_t* target = m_registers.get(REGISTERS[y]);
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t result = target[i] - 1;
+            f[i] = zero(result) | SUBTRACT | ((result ^ 0x01u ^ target[i]) & 0x10u) << 1u | (f[i] & (CARRY | 0x0Fu));
+            target[i] = result;
+        }
+    } else if (z == 6) {
+        uint8_t* target = m_registers.get(REGISTERS[y]);
+        std::fill(target, target + count, static_cast<uint8_t>(operand));
+    } else if (z == 7) {
+        switch (y) {
+            case 0: // RLCA
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t carry = a[i] >> 7u;
+                    a[i] = (a[i] << 1u) | carry;
+                    f[i] = carry << 4u | (f[i] & 0x0Fu);
+                }
+                break;
+            case 1: // RRCA
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t carry = a[i] & 1u;
+                    a[i] = (a[i] >> 1u) | carry << 7u;
+                    f[i] = carry << 4u | (f[i] & 0x0Fu);
+                }
+                break;
+            case 2: // RLA
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t carry = a[i] >> 7u;
+                    a[i] = (a[i] << 1u) | ((f[i] >> 4u) & 1u);
+                    f[i] = carry << 4u | (f[i] & 0x0Fu);
+                }
+                break;
+            case 3: // RRA
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t carry = a[i] & 1u;
+                    a[i] = (a[i] >> 1u) | ((f[i] >> 4u) & 1u) << 7u;
+                    f[i] = carry << 4u | (f[i] & 0x0Fu);
+                }
+                break;
+            case 5: // CPL
+                for (size_t i = 0; i < count; ++i) {
+                    a[i] = ~a[i];
+                    f[i] |= SUBTRACT | HALF_CARRY;
+                }
+                break;
+            case 6: // SCF
+                for (size_t i = 0; i < count; ++i) {
+                    f[i] = (f[i] & (ZERO | 0x0Fu)) | CARRY;
+                }
+                break;
+            default: // CCF
+                for (size_t i = 0; i < count; ++i) {
+                    f[i] = (f[i] & (ZERO | CARRY | 0x0Fu)) ^ CARRY;
+                }
+                break;
+        }
+    }
+
+    return CPU::cyclesOf(opcode);
+}
@@ -1,10 +1,17 @@
 #include <bigboy/MMU.h>
 
+#include <bigboy/BlockCache.h>
+#include <bigboy/CPU.h>
+#include <bigboy/Diagnostics.h>
+#ifdef BIGBOY_JIT
+#include <bigboy/JIT.h>
+#endif
+
 #include <algorithm>
-#include <iostream>
+#include <cstring>
 
 MMU::MMU() {
-    registerDevice(m_internal);
+    reset();
 }
 
 MMU::MMU(std::initializer_list<std::reference_wrapper<MemoryDevice>> devices) : MMU{} {
@@ -13,21 +20,52 @@ MMU::MMU(std::initializer_list<std::reference_wrapper<MemoryDevice>> devices) :
     }
 }
 
-uint8_t MMU::readByte(uint16_t address) const {
+uint8_t MMU::readDevice(uint16_t address) const {
+    if ((address & 0xFF80u) == 0xFF00u) {
+        if (m_cpu) {
+            m_cpu->onIoAccess(false);
+        }
+        const IoRegister& io = m_ioRegisters[address & 0x7Fu];
+        return io.read(io.readContext, address) | io.unusedBits;
+    }
+
     if (const MemoryDevice* device = getDevice(address)) {
         return device->readByte(address);
     }
 
-    std::cerr << "warning: no memory device registered for address: " << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNMAPPED_READ, address, "MMU");
     return 0xFF; // Return bogus
 }
 
-void MMU::writeByte(uint16_t address, uint8_t value) {
+void MMU::writeDevice(uint16_t address, uint8_t value) {
+    if ((address & 0xFF80u) == 0xFF00u) {
+        if (m_cpu) {
+            m_cpu->onIoAccess(true);
+        }
+        const IoRegister& io = m_ioRegisters[address & 0x7Fu];
+        return io.write(io.writeContext, address, value);
+    }
+
+    // Only addresses without a mapping for writes get here, such as the ROM,
+    // and RAM that holds decoded or compiled code
+    if (m_blockCache && address <= 0x7FFF) {
+        m_blockCache->onRomWrite();
+    }
+#ifdef BIGBOY_JIT
+    if (m_jit) {
+        m_jit->onWrite(address);
+    }
+#endif
+
+    if (m_cpu && address <= 0x7FFF) {
+        m_cpu->invalidateFetchWindow();
+    }
+
     if (MemoryDevice* device = getDevice(address)) {
         return device->writeByte(address, value);
     }
 
-    std::cerr << "warning: no memory device registered for address: " << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNMAPPED_WRITE, address, "MMU");
     // Do nothing.
 }
 
@@ -42,37 +80,146 @@ void MMU::writeWord(uint16_t address, uint16_t value) {
     writeByte(address + 1, ((value >> 8u) & 0xFF));
 }
 
+void MMU::readBlock(uint16_t address, uint8_t* out, size_t size) const {
+    while (size > 0) {
+        const size_t chunk = std::min<size_t>(size, 0x100u - (address & 0xFFu));
+        const Page& page = m_pages[address >> 8u];
+        if (page.read) {
+            std::memcpy(out, page.read + (address & 0xFFu), chunk);
+        } else {
+            for (size_t i = 0; i < chunk; ++i) {
+                out[i] = readDevice(address + i);
+            }
+        }
+
+        address += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+void MMU::writeBlock(uint16_t address, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const size_t chunk = std::min<size_t>(size, 0x100u - (address & 0xFFu));
+        const Page& page = m_pages[address >> 8u];
+        if (page.write) {
+            std::memcpy(page.write + (address & 0xFFu), data, chunk);
+        } else {
+            for (size_t i = 0; i < chunk; ++i) {
+                writeDevice(address + i, data[i]);
+            }
+        }
+
+        address += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
 void MMU::registerDevice(MemoryDevice &device) {
     for (const AddressSpace& addressSpace : device.addressSpaces()) {
         reserveAddressSpace(device, addressSpace);
     }
+    device.attach(*this);
 }
 
-void MMU::reserveAddressSpace(MemoryDevice &device, AddressSpace addressSpace) {
-    uint16_t i = addressSpace.start;
-    do {
-        m_devices[i] = &device;
-    } while (i++ < addressSpace.end);
+void MMU::setBlockCache(BlockCache* blockCache) {
+    m_blockCache = blockCache;
+    m_internal.setBlockCache(blockCache);
+    if (blockCache) {
+        blockCache->setMemory(&m_internal);
+    }
 }
 
-void MMU::reset() {
-    //m_devices.fill(nullptr);
-    m_internal.reset();
-    registerDevice(m_internal);
+void MMU::setCPU(CPU* cpu) {
+    m_cpu = cpu;
 }
 
-MemoryDevice* MMU::getDevice(uint16_t address) {
-    if (MemoryDevice* device = m_devices[address]) {
-        return device;
+#ifdef BIGBOY_JIT
+void MMU::setJIT(JIT* jit) {
+    m_jit = jit;
+}
+#endif
+
+void MMU::mapMemory(uint16_t start, uint16_t end, const uint8_t* read, uint8_t* write) {
+    // The GPU maps VRAM in and out twice a line, so this is kept tight
+    const uint32_t first = start >> 8u;
+    const uint32_t last = end >> 8u;
+    for (uint32_t page = first; page <= last; ++page) {
+        const size_t offset = (page - first) << 8u;
+        Page& entry = m_pages[page];
+        uint8_t* mappedWrite = write ? write + offset : nullptr;
+        entry.read = read ? read + offset : nullptr;
+        entry.write = m_watchedWrites[page] ? nullptr : mappedWrite;
+        m_mappedWrites[page] = mappedWrite;
     }
+}
+
+void MMU::mapIoRegister(uint16_t address, IoRead read, const void* readContext,
+                        IoWrite write, void* writeContext, uint8_t unusedBits) {
+    m_ioRegisters[address & 0x7Fu] = IoRegister{read, readContext, write, writeContext, unusedBits};
+}
+
+uint8_t MMU::readMemoryDevice(const void* device, uint16_t address) {
+    return static_cast<const MemoryDevice*>(device)->readByte(address);
+}
 
-    return nullptr;
+void MMU::writeMemoryDevice(void* device, uint16_t address, uint8_t value) {
+    static_cast<MemoryDevice*>(device)->writeByte(address, value);
+}
+
+void MMU::watchWrites(uint8_t page, bool watched) {
+    m_watchedWrites[page] = watched;
+    m_pages[page].write = watched ? nullptr : m_mappedWrites[page];
+}
+
+void MMU::reserveAddressSpace(MemoryDevice &device, AddressSpace addressSpace) {
+    for (uint32_t page = addressSpace.start >> 8u; page <= (addressSpace.end >> 8u); ++page) {
+        const uint32_t start = std::max<uint32_t>(page << 8u, addressSpace.start);
+        const uint32_t end = std::min<uint32_t>((page << 8u) | 0xFFu, addressSpace.end);
+
+        std::unique_ptr<std::array<MemoryDevice*, 256>>& split = m_splitPages[page];
+        if (start == (page << 8u) && end == ((page << 8u) | 0xFFu)) {
+            m_pages[page].device = &device;
+            split.reset();
+        } else {
+            if (!split) {
+                split = std::make_unique<std::array<MemoryDevice*, 256>>();
+                split->fill(m_pages[page].device);
+                m_pages[page].device = nullptr;
+            }
+            std::fill(split->begin() + (start & 0xFFu), split->begin() + (end & 0xFFu) + 1, &device);
+        }
+
+        // Whatever was mapped here belonged to the previous owner
+        mapMemory(page << 8u, page << 8u, nullptr, nullptr);
+    }
+
+    // The I/O registers go to the device, until it maps them itself
+    for (uint32_t address = std::max<uint32_t>(addressSpace.start, 0xFF00);
+            address <= std::min<uint32_t>(addressSpace.end, 0xFF7F); ++address) {
+        mapIoRegister(address, &readMemoryDevice, &device, &writeMemoryDevice, &device, 0x00);
+    }
+}
+
+void MMU::reset() {
+    m_pages.fill(Page{});
+    for (auto& split : m_splitPages) {
+        split.reset();
+    }
+    m_mappedWrites.fill(nullptr);
+    m_watchedWrites.fill(false);
+    m_ioRegisters.fill(IoRegister{&readOpenBus, nullptr, &writeNothing, nullptr, 0x00});
+
+    m_internal.reset();
+    registerDevice(m_internal);
 }
 
-const MemoryDevice* MMU::getDevice(uint16_t address) const {
-    if (const MemoryDevice* device = m_devices[address]) {
-        return device;
+MemoryDevice* MMU::getDevice(uint16_t address) const {
+    const uint8_t page = address >> 8u;
+    if (const auto& split = m_splitPages[page]) {
+        return (*split)[address & 0xFFu];
     }
 
-    return nullptr;
+    return m_pages[page].device;
 }
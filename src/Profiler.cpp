@@ -0,0 +1,344 @@
+#include <bigboy/Profiler.h>
+
+#include <bigboy/CPU.h>
+#include <bigboy/OpCode.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+Profiler::Profiler() {
+    reset();
+}
+
+void Profiler::setRomBank(uint16_t bank) {
+    if (bank >= m_romBanks.size()) {
+        m_romBanks.resize(bank + 1);
+        m_romBankOpcodes.resize(bank + 1);
+    }
+    if (m_romBanks[bank].empty()) {
+        m_romBanks[bank].resize(0x4000);
+        m_romBankOpcodes[bank].resize(0x4000);
+    }
+
+    m_romBank = bank;
+    m_regions[2] = m_romBanks[bank].data();
+    m_regions[3] = m_romBanks[bank].data() + 0x2000;
+    m_romOpcodes[2] = m_romBankOpcodes[bank].data();
+    m_romOpcodes[3] = m_romBankOpcodes[bank].data() + 0x2000;
+}
+
+void Profiler::onSkip(uint16_t pc, uint32_t cycles) {
+    m_regions[pc >> 13u][pc & 0x1FFFu].cycles += cycles;
+    if (pc <= 0x7FFF) {
+        m_skippedRomCycles[makeKey(pc <= 0x3FFF ? 0 : m_romBank, pc)] += cycles;
+    }
+    m_pendingCycles += cycles;
+}
+
+void Profiler::onCall(uint16_t bank, uint16_t address, uint16_t sp) {
+    if (m_enteringInterrupt) {
+        // The interrupt's own frame stands for its vector
+        m_enteringInterrupt = false;
+        return;
+    }
+
+    const int8_t interrupt = m_stack.empty() ? -1 : m_stack.back().interrupt;
+    pushFrame(makeKey(bank, address), sp, interrupt);
+}
+
+void Profiler::onReturn(uint16_t sp) {
+    m_returned = true;
+    m_returnSp = sp;
+    m_settleSp = -1;
+}
+
+void Profiler::onInterrupt(Interrupt interrupt, uint16_t sp) {
+    ++m_handlerEntries[static_cast<uint8_t>(interrupt)];
+
+    pushFrame(makeKey(SPECIAL_BANK, static_cast<uint8_t>(interrupt)), sp, static_cast<int8_t>(interrupt));
+    m_enteringInterrupt = true;
+
+    // Interrupts are serviced between steps, so the next step is the
+    // handler's
+    m_current = m_stack.back().node;
+    m_currentInterrupt = m_stack.back().interrupt;
+}
+
+void Profiler::pushFrame(uint32_t key, uint16_t sp, int8_t interrupt) {
+    if (m_stack.size() >= MAX_DEPTH) {
+        return;
+    }
+
+    // Whatever ran before the call counts as it did without it
+    flush();
+    m_settleSp = -1;
+
+    const uint32_t parent = m_stack.empty() ? 0 : m_stack.back().node;
+    const uint64_t childKey = (static_cast<uint64_t>(parent) << 32u) | key;
+    auto child = m_children.find(childKey);
+    if (child == m_children.end()) {
+        child = m_children.emplace(childKey, static_cast<uint32_t>(m_nodes.size())).first;
+        m_nodes.push_back(Node{parent, key, &m_routines[key], 0});
+    }
+
+    // A routine is entered as the instruction calling it starts, so its
+    // inclusive cycles take in the call as well as the return
+    Routine& routine = *m_nodes[child->second].routine;
+    ++routine.calls;
+    if (routine.active++ == 0) {
+        routine.entered = m_cycles;
+    }
+
+    m_stack.push_back(Frame{child->second, sp, interrupt});
+}
+
+void Profiler::popFrame() {
+    Routine& routine = *m_nodes[m_stack.back().node].routine;
+    if (--routine.active == 0) {
+        routine.inclusiveCycles += m_cycles - routine.entered;
+    }
+    m_stack.pop_back();
+}
+
+void Profiler::flush() {
+    m_cycles += m_pendingCycles;
+    Node& node = m_nodes[m_current];
+    node.cycles += m_pendingCycles;
+    node.routine->exclusiveCycles += m_pendingCycles;
+    if (m_currentInterrupt >= 0) {
+        m_handlers[m_currentInterrupt].cycles += m_pendingCycles;
+        m_handlers[m_currentInterrupt].instructions += m_pendingSteps;
+    }
+    m_pendingCycles = 0;
+    m_pendingSteps = 0;
+}
+
+void Profiler::settle(uint16_t sp) {
+    flush();
+
+    // The step that returns still belongs to the routine. Any other frame
+    // whose return address is now above the stack has been left some other
+    // way: SP was reloaded, or the return address was popped to jump with.
+    while (!m_stack.empty() && sp > m_stack.back().sp) {
+        if (!m_returned || m_stack.back().sp != m_returnSp) {
+            ++m_resyncs;
+        }
+        popFrame();
+    }
+    m_returned = false;
+
+    m_current = m_stack.empty() ? 0 : m_stack.back().node;
+    m_currentInterrupt = m_stack.empty() ? -1 : m_stack.back().interrupt;
+    m_settleSp = m_stack.empty() ? 0xFFFF : m_stack.back().sp;
+}
+
+void Profiler::reset() {
+    m_rom0.assign(0x4000, Counts{});
+    m_romBanks.clear();
+    m_ram.assign(0x8000, Counts{});
+    m_rom0Opcodes.assign(0x4000, 0);
+    m_romBankOpcodes.clear();
+
+    for (size_t region = 0; region < 2; ++region) {
+        m_regions[region] = m_rom0.data() + region * 0x2000;
+        m_romOpcodes[region] = m_rom0Opcodes.data() + region * 0x2000;
+    }
+    for (size_t region = 4; region < 8; ++region) {
+        m_regions[region] = m_ram.data() + (region - 4) * 0x2000;
+    }
+    setRomBank(m_romBank);
+    m_skippedRomCycles.clear();
+
+    m_opcodes.fill(Counts{});
+
+    m_handlers.fill(Counts{});
+    m_handlerEntries.fill(0);
+
+    m_routines.clear();
+    m_nodes.clear();
+    m_children.clear();
+    m_nodes.push_back(Node{0, MAIN_KEY, &m_routines[MAIN_KEY], 0});
+
+    m_stack.clear();
+    m_current = 0;
+    m_currentInterrupt = -1;
+    m_settleSp = 0xFFFF;
+    m_pendingCycles = 0;
+    m_pendingSteps = 0;
+    m_cycles = 0;
+    m_returned = false;
+    m_enteringInterrupt = false;
+    m_resyncs = 0;
+}
+
+template <typename Visitor>
+void Profiler::forEachAddress(Visitor visit) const {
+    auto visitAll = [&](uint16_t bank, uint16_t start, const std::vector<Counts>& counts, const uint16_t* opcodes) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i].cycles > 0) {
+                visit(bank, static_cast<uint16_t>(start + i), counts[i], opcodes ? opcodes[i] : -1);
+            }
+        }
+    };
+
+    visitAll(0, 0x0000, m_rom0, m_rom0Opcodes.data());
+    for (size_t bank = 0; bank < m_romBanks.size(); ++bank) {
+        visitAll(bank, 0x4000, m_romBanks[bank], m_romBankOpcodes[bank].data());
+    }
+    visitAll(0, 0x8000, m_ram, nullptr);
+}
+
+void Profiler::writeReport(std::ostream& out, size_t maxAddresses) const {
+    struct Row {
+        std::string name;
+        const Counts* counts;
+    };
+
+    uint64_t totalCycles = 0;
+    uint64_t totalInstructions = 0;
+    // Opcodes in ROM are counted from the addresses they ran at, less any
+    // cycles skipped there
+    std::array<Counts, 0x200> opcodeCounts = m_opcodes;
+    std::vector<Row> addresses;
+    forEachAddress([&](uint16_t bank, uint16_t pc, const Counts& counts, int32_t opcode) {
+        totalCycles += counts.cycles;
+        totalInstructions += counts.instructions;
+        addresses.push_back(Row{nameOf(bank, pc), &counts});
+
+        if (opcode >= 0 && counts.instructions > 0) {
+            const auto skipped = m_skippedRomCycles.find(makeKey(bank, pc));
+            opcodeCounts[opcode].instructions += counts.instructions;
+            opcodeCounts[opcode].cycles += counts.cycles - (skipped != m_skippedRomCycles.end() ? skipped->second : 0);
+        }
+    });
+
+    std::vector<Row> opcodes;
+    for (uint16_t opcode = 0; opcode < 256; ++opcode) {
+        if (opcodeCounts[opcode].instructions > 0) {
+            const bool valid = CPU::lengthOf(opcode) != 0 && opcode != static_cast<uint8_t>(OpCode::CB);
+            opcodes.push_back(Row{valid ? opCodeToString(static_cast<OpCode>(opcode)) : "??", &opcodeCounts[opcode]});
+        }
+        if (opcodeCounts[0x100 | opcode].instructions > 0) {
+            char name[8];
+            std::snprintf(name, sizeof(name), "CB %02X", opcode);
+            opcodes.push_back(Row{name, &opcodeCounts[0x100 | opcode]});
+        }
+    }
+
+    auto byCycles = [](const Row& a, const Row& b) { return a.counts->cycles > b.counts->cycles; };
+    std::sort(addresses.begin(), addresses.end(), byCycles);
+    std::sort(opcodes.begin(), opcodes.end(), byCycles);
+
+    auto percent = [&](uint64_t cycles) { return totalCycles ? 100.0 * cycles / totalCycles : 0.0; };
+    auto writeRow = [&](const std::string& name, const Counts& counts) {
+        out << std::setw(12) << std::left << name << std::right
+            << std::setw(14) << counts.cycles
+            << std::setw(8) << std::fixed << std::setprecision(2) << percent(counts.cycles) << '%'
+            << std::setw(14) << counts.instructions << '\n';
+    };
+
+    out << "-- PROFILE\n";
+    out << "-- " << totalInstructions << " instructions, " << totalCycles << " cycles\n\n";
+
+    out << "-- hottest addresses\n";
+    out << std::setw(12) << std::left << "address" << std::right
+        << std::setw(14) << "cycles" << std::setw(9) << "%" << std::setw(14) << "instructions" << '\n';
+    for (size_t i = 0; i < std::min(maxAddresses, addresses.size()); ++i) {
+        writeRow(addresses[i].name, *addresses[i].counts);
+    }
+
+    struct RoutineRow {
+        std::string name;
+        const Routine* routine;
+        uint64_t inclusiveCycles;
+    };
+
+    std::vector<RoutineRow> routines;
+    for (const auto& [key, routine] : m_routines) {
+        if (key == MAIN_KEY) continue;
+
+        // Routines still on the stack have been running since they entered
+        const uint64_t running = routine.active > 0 ? m_cycles - routine.entered : 0;
+        routines.push_back(RoutineRow{nameOfRoutine(key), &routine, routine.inclusiveCycles + running});
+    }
+    std::sort(routines.begin(), routines.end(), [](const RoutineRow& a, const RoutineRow& b) {
+        return a.inclusiveCycles > b.inclusiveCycles;
+    });
+
+    out << "\n-- routines\n";
+    out << "-- " << m_resyncs << " frames dropped to resynchronise with SP\n";
+    out << std::setw(12) << std::left << "routine" << std::right
+        << std::setw(14) << "inclusive" << std::setw(9) << "%"
+        << std::setw(14) << "exclusive" << std::setw(9) << "%" << std::setw(10) << "calls" << '\n';
+    for (size_t i = 0; i < std::min(maxAddresses, routines.size()); ++i) {
+        const RoutineRow& row = routines[i];
+        out << std::setw(12) << std::left << row.name << std::right
+            << std::setw(14) << row.inclusiveCycles
+            << std::setw(8) << std::fixed << std::setprecision(2) << percent(row.inclusiveCycles) << '%'
+            << std::setw(14) << row.routine->exclusiveCycles
+            << std::setw(8) << std::fixed << std::setprecision(2) << percent(row.routine->exclusiveCycles) << '%'
+            << std::setw(10) << row.routine->calls << '\n';
+    }
+
+    out << "\n-- opcodes\n";
+    for (const Row& row : opcodes) {
+        writeRow(row.name, *row.counts);
+    }
+
+    out << "\n-- interrupt handlers\n";
+    for (uint8_t interrupt = 0; interrupt < INTERRUPT_COUNT; ++interrupt) {
+        writeRow(nameOf(static_cast<Interrupt>(interrupt)), m_handlers[interrupt]);
+        out << "    entered " << m_handlerEntries[interrupt] << " times\n";
+    }
+}
+
+void Profiler::writeFoldedStacks(std::ostream& out) const {
+    std::vector<uint32_t> path;
+    for (uint32_t index = 0; index < m_nodes.size(); ++index) {
+        if (m_nodes[index].cycles == 0) continue;
+
+        path.clear();
+        for (uint32_t node = index; node != 0; node = m_nodes[node].parent) {
+            path.push_back(node);
+        }
+
+        out << "main";
+        for (auto node = path.rbegin(); node != path.rend(); ++node) {
+            out << ';' << nameOfRoutine(m_nodes[*node].key);
+        }
+        out << ' ' << m_nodes[index].cycles << '\n';
+    }
+}
+
+std::string Profiler::nameOf(uint16_t bank, uint16_t pc) {
+    char name[16];
+    if (pc <= 0x7FFF) {
+        std::snprintf(name, sizeof(name), "ROM%u:%04X", static_cast<unsigned>(pc <= 0x3FFF ? 0 : bank), pc);
+    } else {
+        const char* region = (pc <= 0x9FFF) ? "VRAM" : (pc <= 0xBFFF) ? "SRAM" : (pc <= 0xFDFF) ? "WRAM" :
+                             (pc <= 0xFEFF) ? "OAM" : (pc <= 0xFF7F) ? "IO" : "HRAM";
+        std::snprintf(name, sizeof(name), "%s:%04X", region, pc);
+    }
+    return name;
+}
+
+const char* Profiler::nameOf(Interrupt interrupt) {
+    switch (interrupt) {
+        case Interrupt::VBLANK:   return "VBLANK";
+        case Interrupt::LCD_STAT: return "LCD_STAT";
+        case Interrupt::TIMER:    return "TIMER";
+        case Interrupt::SERIAL:   return "SERIAL";
+        case Interrupt::JOYPAD:   return "JOYPAD";
+    }
+    return "?";
+}
+
+std::string Profiler::nameOfRoutine(uint32_t key) {
+    const uint16_t bank = key >> 16u;
+    const uint16_t address = key & 0xFFFFu;
+    if (bank != SPECIAL_BANK) {
+        return nameOf(bank, address);
+    }
+    return key == MAIN_KEY ? "main" : nameOf(static_cast<Interrupt>(address));
+}
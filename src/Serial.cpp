@@ -1,5 +1,8 @@
 #include <bigboy/Serial.h>
 
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
+
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -15,7 +18,7 @@ uint8_t Serial::readByte(uint16_t address) const {
         case 0xFF02:
             return m_control;
         default:
-            std::cerr << "warning: memory device Serial does not support reading the address " << address << '\n';
+            Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Serial");
             return 0xFF;
     }
 }
@@ -26,13 +29,22 @@ void Serial::writeByte(uint16_t address, uint8_t value) {
             m_data = value;
             break;
         case 0xFF02:
-            m_control = value;
-            // Debug logging
-            if (value == 0x81) {
-                std::cout << static_cast<unsigned char>(m_data);
-            }
+            writeControl(value);
             break;
         default:
-            std::cerr << "warning: memory device Serial does not support writing to the address " << address << '\n';
+            Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Serial");
+    }
+}
+
+void Serial::attach(MMU& mmu) {
+    mmu.mapIoRegister(0xFF01, m_data);
+    mmu.mapIoRegister<&Serial::writeControl>(0xFF02, m_control, *this, 0x7E);
+}
+
+void Serial::writeControl(uint8_t value) {
+    m_control = value;
+    // Debug logging
+    if (value == 0x81) {
+        std::cout << static_cast<unsigned char>(m_data);
     }
 }
@@ -1,12 +1,14 @@
 #include <bigboy/Timer.h>
 
-#include <iostream>
+#include <bigboy/Diagnostics.h>
+#include <bigboy/MMU.h>
 
-bool Timer::update(uint8_t cycles) {
-    // Check if the divider register needs to be incremented
+bool Timer::update(uint32_t cycles) {
+    // Check if the divider register needs to be incremented. The CPU may
+    // report the cycles of several instructions at once, so catch up fully.
     m_divClock += cycles;
 
-    if (m_divClock >= DIVIDER_FREQUENCY) {
+    while (m_divClock >= DIVIDER_FREQUENCY) {
         m_divClock -= DIVIDER_FREQUENCY;
         ++m_div;
     }
@@ -16,18 +18,27 @@ bool Timer::update(uint8_t cycles) {
 
     m_timaClock += cycles;
 
-    if (m_timaClock >= getTimerFrequency()) {
+    bool request = false;
+    while (m_timaClock >= getTimerFrequency()) {
         m_timaClock -= getTimerFrequency();
         if (m_tima == UINT8_MAX) {
             m_tima = m_tma;
             // Request an interrupt!
-            return true;
+            request = true;
         } else {
             ++m_tima;
         }
     }
 
-    return false;
+    return request;
+}
+
+uint32_t Timer::cyclesUntilInterrupt() const {
+    if (!timerEnabled()) return UINT32_MAX;
+
+    // TIMA overflows on its (256 - TIMA)th increment from now
+    const uint32_t cycles = (UINT8_MAX + 1u - m_tima) * getTimerFrequency();
+    return cycles > m_timaClock ? cycles - m_timaClock : 0;
 }
 
 std::vector<AddressSpace> Timer::addressSpaces() const {
@@ -42,14 +53,14 @@ uint8_t Timer::readByte(uint16_t address) const {
         case 0xFF07: return m_tac;
     }
 
-    std::cerr << "warning: memory device Timer does not support reading the address " << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_READ, address, "Timer");
     return 0xFF;
 }
 
 void Timer::writeByte(uint16_t address, uint8_t value) {
     switch (address) {
         case 0xFF04:
-            m_div = 0;
+            writeDivider(value);
             return;
         case 0xFF05:
             m_tima = value;
@@ -62,7 +73,19 @@ void Timer::writeByte(uint16_t address, uint8_t value) {
             return;
     }
 
-    std::cerr << "warning: memory device Timer does not support writing to the address " << address << '\n';
+    Diagnostics::get().report(Diagnostic::UNSUPPORTED_WRITE, address, "Timer");
+}
+
+void Timer::attach(MMU& mmu) {
+    mmu.mapIoRegister<&Timer::writeDivider>(0xFF04, m_div, *this);
+    mmu.mapIoRegister(0xFF05, m_tima);
+    mmu.mapIoRegister(0xFF06, m_tma);
+    mmu.mapIoRegister(0xFF07, m_tac, 0xF8);
+}
+
+void Timer::writeDivider(uint8_t) {
+    // Writing resets it
+    m_div = 0;
 }
 
 void Timer::reset() {
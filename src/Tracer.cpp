@@ -0,0 +1,189 @@
+#include <bigboy/Tracer.h>
+
+#include <bigboy/CPU.h>
+#include <bigboy/OpCode.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+
+namespace {
+    // The tracer to dump on a crash, if any
+    Tracer* s_crashTracer = nullptr;
+
+    constexpr int CRASH_SIGNALS[] = {
+            SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifdef SIGBUS
+            SIGBUS,
+#endif
+    };
+
+    uint64_t roundUpToPowerOfTwo(size_t value) {
+        uint64_t result = 1;
+        while (result < value) {
+            result <<= 1u;
+        }
+        return result;
+    }
+}
+
+Tracer::Tracer(size_t capacity) {
+    const uint64_t size = roundUpToPowerOfTwo(capacity > 0 ? capacity : 1);
+    m_records = std::make_unique<TraceRecord[]>(size);
+    m_mask = size - 1;
+}
+
+Tracer::~Tracer() {
+    stopStreaming();
+
+    if (s_crashTracer == this) {
+        s_crashTracer = nullptr;
+    }
+}
+
+bool Tracer::startStreaming(const std::string& path) {
+    stopStreaming();
+
+    auto out = std::make_unique<std::ofstream>(path);
+    if (!out->good()) {
+        return false;
+    }
+
+    // Only what is recorded from now on
+    m_tail.store(m_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_streaming = true;
+    m_writer = std::thread{[this, out = std::move(out)]() { runWriter(*out); }};
+    return true;
+}
+
+void Tracer::stopStreaming() {
+    if (!m_streaming) {
+        return;
+    }
+
+    m_stopWriter.store(true, std::memory_order_release);
+    m_writer.join();
+    m_stopWriter.store(false, std::memory_order_relaxed);
+    m_streaming = false;
+}
+
+bool Tracer::dump(const std::string& path) const {
+    std::ofstream out{path};
+    if (!out.good()) {
+        return false;
+    }
+
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    const uint64_t capacity = m_mask + 1;
+    write(out, (head > capacity) ? head - capacity : 0, head);
+    return out.good();
+}
+
+void Tracer::dumpOnCrash(const std::string& path) {
+    m_crashPath = path;
+    s_crashTracer = this;
+
+    for (int signal : CRASH_SIGNALS) {
+        std::signal(signal, &Tracer::onCrashSignal);
+    }
+    std::set_terminate(&Tracer::onTerminate);
+}
+
+void Tracer::onFatal() const {
+    if (!m_crashPath.empty()) {
+        dump(m_crashPath);
+    }
+}
+
+void Tracer::format(std::ostream& out, const TraceRecord& record) {
+    char location[16];
+    if (record.pc <= 0x7FFF) {
+        std::snprintf(location, sizeof(location), "ROM%u:%04X", static_cast<unsigned>(record.bank), record.pc);
+    } else {
+        const uint16_t pc = record.pc;
+        const char* region = (pc <= 0x9FFF) ? "VRAM" : (pc <= 0xBFFF) ? "SRAM" : (pc <= 0xFDFF) ? "WRAM" :
+                             (pc <= 0xFEFF) ? "OAM" : (pc <= 0xFF7F) ? "IO" : "HRAM";
+        std::snprintf(location, sizeof(location), "%s:%04X", region, pc);
+    }
+
+    const uint8_t opcode = record.bytes[0];
+    const bool prefixed = opcode == static_cast<uint8_t>(OpCode::CB);
+    const uint8_t length = prefixed ? 2 : CPU::lengthOf(opcode);
+
+    char bytes[10] = "";
+    for (uint8_t i = 0; i < length; ++i) {
+        std::snprintf(bytes + i * 3, sizeof(bytes) - i * 3, "%02X ", record.bytes[i]);
+    }
+
+    char name[24];
+    if (prefixed) {
+        std::snprintf(name, sizeof(name), "CB %02X", record.bytes[1]);
+    } else if (length == 0) {
+        std::snprintf(name, sizeof(name), "??");
+    } else {
+        std::snprintf(name, sizeof(name), "%s", opCodeToString(static_cast<OpCode>(opcode)).c_str());
+    }
+
+    char line[160];
+    std::snprintf(line, sizeof(line),
+            "%012llu %-10s %-9s %-14s AF=%02X%02X BC=%02X%02X DE=%02X%02X HL=%02X%02X SP=%04X%s%s\n",
+            static_cast<unsigned long long>(record.cycle), location, bytes, name,
+            record.a, record.f, record.b, record.c, record.d, record.e, record.h, record.l, record.sp,
+            (record.state & TRACE_IME) ? " IME" : "",
+            (record.state & TRACE_HALTED) ? " HALTED" : "");
+    out << line;
+}
+
+void Tracer::waitForWriter(uint64_t head) {
+    while (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+        std::this_thread::yield();
+    }
+}
+
+void Tracer::write(std::ostream& out, uint64_t from, uint64_t to) const {
+    for (uint64_t i = from; i < to; ++i) {
+        format(out, m_records[i & m_mask]);
+    }
+}
+
+void Tracer::runWriter(std::ostream& out) {
+    while (true) {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        const uint64_t head = m_head.load(std::memory_order_acquire);
+
+        if (head == tail) {
+            // Everything recorded before being told to stop has been written
+            if (m_stopWriter.load(std::memory_order_acquire) && head == m_head.load(std::memory_order_acquire)) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            continue;
+        }
+
+        write(out, tail, head);
+        m_tail.store(head, std::memory_order_release);
+    }
+
+    out.flush();
+}
+
+void Tracer::onCrashSignal(int signal) {
+    if (Tracer* tracer = s_crashTracer) {
+        s_crashTracer = nullptr;
+        tracer->dump(tracer->m_crashPath);
+    }
+
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void Tracer::onTerminate() {
+    if (Tracer* tracer = s_crashTracer) {
+        s_crashTracer = nullptr;
+        tracer->dump(tracer->m_crashPath);
+    }
+
+    std::abort();
+}